@@ -0,0 +1,451 @@
+// ============================================================================
+//
+//       Filename:  bench.cpp
+//
+//    Description:  Micro-benchmarks for the animation kernels of task2.cpp.
+//
+// ============================================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "task2.h"
+#include "Model.h"
+#include "IQMImporter.h"
+#include "CompiledSpline.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+  string models_dir;
+  string json_file;
+  unsigned samples;
+  unsigned warmup;
+  // Minimum duration of one sample; short kernels are batched up to it so
+  // that the clock resolution does not dominate.
+  double min_sample_ns;
+};
+
+struct Result
+{
+  string model;
+  string kernel;
+  string unit;
+  size_t unit_count;
+  unsigned batch;
+  // Nanoseconds per unit, sorted.
+  std::vector<double> samples;
+};
+
+struct BenchModel
+{
+  string name;
+  string base_file;
+  std::vector<string> animation_files;
+};
+
+std::vector<string> listModelFiles(const string& dir)
+{
+  std::vector<string> files;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((dir + "/*.iqm").c_str(), &data);
+  if (find != INVALID_HANDLE_VALUE)
+  {
+    do
+      files.push_back(data.cFileName);
+    while (FindNextFileA(find, &data));
+    FindClose(find);
+  }
+#else
+  DIR* handle = opendir(dir.c_str());
+  if (handle)
+  {
+    while (dirent* entry = readdir(handle))
+    {
+      string name = entry->d_name;
+      if (name.size() > 4 && name.compare(name.size() - 4, 4, ".iqm") == 0)
+        files.push_back(name);
+    }
+    closedir(handle);
+  }
+#endif
+  std::sort(files.begin(), files.end());
+  return files;
+}
+
+// Groups <name>_base.iqm with the <name>_*.iqm animations next to it.
+std::vector<BenchModel> findModels(const string& dir)
+{
+  std::vector<string> files = listModelFiles(dir);
+  std::vector<BenchModel> models;
+  for (const string& file : files)
+  {
+    const string suffix = "_base.iqm";
+    if (file.size() <= suffix.size() ||
+        file.compare(file.size() - suffix.size(), suffix.size(), suffix) != 0)
+      continue;
+
+    BenchModel model;
+    model.name = file.substr(0, file.size() - suffix.size());
+    model.base_file = dir + "/" + file;
+    for (const string& other : files)
+    {
+      if (other != file && other.compare(0, model.name.size() + 1,
+                               model.name + "_") == 0)
+        model.animation_files.push_back(dir + "/" + other);
+    }
+    if (!model.animation_files.empty())
+      models.push_back(model);
+  }
+  return models;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+double mean(const std::vector<double>& values)
+{
+  double sum = 0.0;
+  for (double value : values)
+    sum += value;
+  return sum / values.size();
+}
+
+// Times kernel(iteration) over options.samples batches after the warmup and
+// stores the time per unit of work.
+template<typename Kernel>
+Result measure(const Options& options,
+    const string& model,
+    const string& kernel_name,
+    const string& unit,
+    size_t unit_count,
+    const Kernel& kernel)
+{
+  Result result;
+  result.model = model;
+  result.kernel = kernel_name;
+  result.unit = unit;
+  result.unit_count = unit_count;
+
+  unsigned iteration = 0;
+  for (unsigned i = 0; i < options.warmup; i++)
+    kernel(iteration++);
+
+  // Calibrate the batch size on the warm kernel.
+  result.batch = 1;
+  for (;;)
+  {
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < result.batch; i++)
+      kernel(iteration++);
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    if (ns >= options.min_sample_ns || result.batch >= (1u << 20))
+      break;
+    result.batch *= 2;
+  }
+
+  result.samples.reserve(options.samples);
+  for (unsigned sample = 0; sample < options.samples; sample++)
+  {
+    Clock::time_point start = Clock::now();
+    for (unsigned i = 0; i < result.batch; i++)
+      kernel(iteration++);
+    double ns =
+        std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    result.samples.push_back(
+        ns / result.batch / std::max<size_t>(unit_count, 1));
+  }
+  std::sort(result.samples.begin(), result.samples.end());
+  return result;
+}
+
+// Spreads the iterations over the clip so that every keyframe pair is hit.
+float sampleTime(unsigned iteration, float duration)
+{
+  const unsigned STEPS = 97;
+  return duration * (iteration % STEPS) / (STEPS - 1);
+}
+
+void benchModel(const Options& options,
+    const BenchModel& bench_model,
+    std::vector<Result>& results)
+{
+  // The second clip modulates the first one like in the *_modulation
+  // configs; single-clip models modulate themselves.
+  std::vector<string> animation_files;
+  animation_files.push_back(bench_model.animation_files[0]);
+  animation_files.push_back(bench_model.animation_files.size() > 1
+                                ? bench_model.animation_files[1]
+                                : bench_model.animation_files[0]);
+  std::vector<float> repeat_times(2, std::numeric_limits<float>::infinity());
+  std::vector<bool> make_relative;
+  make_relative.push_back(false);
+  make_relative.push_back(true);
+
+  IQMImporter importer;
+  Model* model = importer.loadModel(
+      bench_model.base_file, animation_files, repeat_times, make_relative);
+  if (!model || model->getActionCount() < 2 || model->getJointCount() == 0)
+  {
+    cerr << "Skipping " << bench_model.name << ": could not load it." << endl;
+    delete model;
+    return;
+  }
+
+  const std::vector<Joint>& joints = model->getJoints();
+  const Animation& action = model->getAnimation(0);
+  const Animation& modulation = model->getAnimation(1);
+  const float duration = action.getKeyframes().back().getTime();
+  const float modulation_duration = modulation.getKeyframes().back().getTime();
+  std::vector<glm::mat4> joint_transformations(joints.size());
+
+  results.push_back(measure(options, bench_model.name, "interpolateJoints",
+      "joint", joints.size(), [&](unsigned iteration) {
+        interpolateJoints(sampleTime(iteration, duration), joints,
+            action.getKeyframes(), joint_transformations);
+      }));
+
+  results.push_back(measure(options, bench_model.name,
+      "interpolateJointsForAnimationModulation", "joint", joints.size(),
+      [&](unsigned iteration) {
+        interpolateJointsForAnimationModulation(
+            sampleTime(iteration, duration),
+            sampleTime(iteration, modulation_duration), joints,
+            action.getKeyframes(), modulation.getKeyframes(),
+            joint_transformations);
+      }));
+
+  // Skin with a real pose, not the identity.
+  interpolateJoints(duration * 0.5f, joints, action.getKeyframes(),
+      joint_transformations);
+
+  size_t vertex_cnt = 0;
+  size_t triangle_cnt = 0;
+  std::vector<std::vector<glm::vec3>> vertices(model->getMeshCount());
+  std::vector<std::vector<glm::vec3>> normals(model->getMeshCount());
+  for (size_t i = 0; i < model->getMeshCount(); i++)
+  {
+    const Mesh& mesh = model->getMesh(i);
+    vertex_cnt += mesh.getVertexCount();
+    triangle_cnt += mesh.getTriangleCount();
+    vertices[i].resize(mesh.getVertexCount());
+    normals[i].resize(mesh.getVertexCount());
+  }
+
+  results.push_back(measure(options, bench_model.name, "calculateVertices",
+      "vertex", vertex_cnt, [&](unsigned) {
+        for (size_t i = 0; i < model->getMeshCount(); i++)
+        {
+          const Mesh& mesh = model->getMesh(i);
+          calculateVertices(mesh.getVertices(), joints, mesh.getJoints(),
+              mesh.getWeights(), joint_transformations, vertices[i]);
+        }
+      }));
+
+  // calculateNormals accumulates, so the clear is part of its cost in every
+  // caller and is timed along with it.
+  results.push_back(measure(options, bench_model.name, "calculateNormals",
+      "triangle", triangle_cnt, [&](unsigned) {
+        for (size_t i = 0; i < model->getMeshCount(); i++)
+        {
+          std::fill(normals[i].begin(), normals[i].end(), glm::vec3(0.f));
+          calculateNormals(
+              vertices[i], model->getMesh(i).getTriangles(), normals[i]);
+        }
+      }));
+
+  delete model;
+}
+
+void benchSpline(const Options& options, std::vector<Result>& results)
+{
+  // A closed helix-like path with tangents from
+  // Spline::calculateAndStoreTangents.
+  const size_t POINT_COUNT = 64;
+  Spline spline;
+  for (size_t i = 0; i < POINT_COUNT; i++)
+  {
+    float t = static_cast<float>(i);
+    spline.addPoint(t,
+        glm::vec3(10.f * std::cos(t * 0.4f), 0.5f * t, 10.f * std::sin(t * 0.4f)));
+  }
+  spline.calculateAndStoreTangents();
+  const std::vector<SplinePoint>& points = spline.getPoints();
+
+  // Spline::interpolate skips the outer points, which only carry tangents.
+  const size_t used_cnt = POINT_COUNT - 2;
+  const float duration = points[used_cnt].getTime() - points[1].getTime();
+  glm::vec3 position;
+  glm::vec3 tangent;
+  results.push_back(measure(options, "spline", "interpolateSpline", "sample",
+      1, [&](unsigned iteration) {
+        interpolateSpline(points[1].getTime() + sampleTime(iteration, duration),
+            &points[1], used_cnt, position, tangent);
+      }));
+
+  results.push_back(measure(options, "spline", "Spline::interpolate", "sample",
+      1, [&](unsigned iteration) {
+        position = spline.interpolate(points[1].getTime() +
+            sampleTime(iteration, duration)).getPosition();
+      }));
+
+  CompiledSpline compiled(spline);
+  results.push_back(measure(options, "spline", "CompiledSpline::interpolate",
+      "sample", 1, [&](unsigned iteration) {
+        position = compiled.interpolate(compiled.getStartTime() +
+            sampleTime(iteration, duration)).getPosition();
+      }));
+
+  // One time per follower of the path, as a crowd would evaluate it.
+  const size_t FOLLOWER_COUNT = 1024;
+  std::vector<float> times(FOLLOWER_COUNT);
+  std::vector<glm::vec3> positions(FOLLOWER_COUNT);
+  std::vector<glm::quat> orientations(FOLLOWER_COUNT);
+  for (size_t i = 0; i < FOLLOWER_COUNT; i++)
+    times[i] = compiled.getStartTime() + duration * i / FOLLOWER_COUNT;
+  results.push_back(measure(options, "spline",
+      "CompiledSpline::interpolate (batch)", "sample", FOLLOWER_COUNT,
+      [&](unsigned) {
+        compiled.interpolate(
+            &times[0], FOLLOWER_COUNT, &positions[0], &orientations[0]);
+      }));
+
+  CompiledSpline rmf(spline, CompiledSpline::Orientation::ROTATION_MINIMIZING);
+  results.push_back(measure(options, "spline",
+      "CompiledSpline::interpolate (batch, RMF)", "sample", FOLLOWER_COUNT,
+      [&](unsigned) {
+        rmf.interpolate(
+            &times[0], FOLLOWER_COUNT, &positions[0], &orientations[0]);
+      }));
+}
+
+void printResults(const Options& options, const std::vector<Result>& results)
+{
+  cout << endl
+       << "Kernel timings (" << options.samples << " samples, "
+       << options.warmup << " warmup iterations):" << endl;
+  cout << std::left << std::setw(10) << "model" << std::setw(42) << "kernel"
+       << std::right << std::setw(8) << "units" << std::setw(10) << "min"
+       << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10)
+       << "p99" << std::setw(10) << "mean" << endl;
+  cout << std::fixed << std::setprecision(2);
+  for (const Result& result : results)
+  {
+    cout << std::left << std::setw(10) << result.model << std::setw(42)
+         << result.kernel << std::right << std::setw(8) << result.unit_count
+         << std::setw(10) << result.samples.front() << std::setw(10)
+         << percentile(result.samples, 0.5) << std::setw(10)
+         << percentile(result.samples, 0.9) << std::setw(10)
+         << percentile(result.samples, 0.99) << std::setw(10)
+         << mean(result.samples) << "  ns/" << result.unit << endl;
+  }
+  cout.unsetf(std::ios::fixed);
+}
+
+bool writeJson(const Options& options, const std::vector<Result>& results)
+{
+  std::ofstream out(options.json_file.c_str());
+  if (!out)
+    return false;
+
+  out << "{\n  \"samples\": " << options.samples
+      << ",\n  \"warmup\": " << options.warmup << ",\n  \"results\": [";
+  out << std::setprecision(6);
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& result = results[i];
+    out << (i ? ",\n" : "\n") << "    {\"model\": \"" << result.model
+        << "\", \"kernel\": \"" << result.kernel << "\", \"unit\": \""
+        << result.unit << "\", \"units\": " << result.unit_count
+        << ", \"batch\": " << result.batch
+        << ", \"min_ns\": " << result.samples.front()
+        << ", \"p50_ns\": " << percentile(result.samples, 0.5)
+        << ", \"p90_ns\": " << percentile(result.samples, 0.9)
+        << ", \"p99_ns\": " << percentile(result.samples, 0.99)
+        << ", \"mean_ns\": " << mean(result.samples) << "}";
+  }
+  out << "\n  ]\n}\n";
+  return static_cast<bool>(out);
+}
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.models_dir = "data/models";
+  options.samples = 200;
+  options.warmup = 50;
+  options.min_sample_ns = 50000.0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if (arg == "--json" && i + 1 < argc)
+      options.json_file = argv[++i];
+    else if (arg == "--samples" && i + 1 < argc)
+      options.samples = std::max(std::atoi(argv[++i]), 1);
+    else if (arg == "--warmup" && i + 1 < argc)
+      options.warmup = std::max(std::atoi(argv[++i]), 0);
+    else if (arg[0] != '-')
+      options.models_dir = arg;
+    else
+    {
+      cerr << "Usage: " << argv[0]
+           << " [models_dir] [--samples N] [--warmup N] [--json file]"
+           << endl;
+      return 1;
+    }
+  }
+
+  std::vector<BenchModel> models = findModels(options.models_dir);
+  if (models.empty())
+  {
+    cerr << "No animated models in " << options.models_dir << "." << endl;
+    return 1;
+  }
+
+  std::vector<Result> results;
+  for (const BenchModel& model : models)
+    benchModel(options, model, results);
+  benchSpline(options, results);
+
+  printResults(options, results);
+  if (!options.json_file.empty())
+  {
+    if (!writeJson(options, results))
+    {
+      cerr << "Could not write " << options.json_file << "." << endl;
+      return 1;
+    }
+    cout << "Wrote " << options.json_file << "." << endl;
+  }
+  return 0;
+}
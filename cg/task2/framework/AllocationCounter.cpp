@@ -0,0 +1,87 @@
+#include "AllocationCounter.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<size_t> allocation_count(0);
+std::atomic<size_t> allocated_bytes(0);
+}
+
+bool AllocationCounter::isEnabled()
+{
+#ifdef CG_COUNT_ALLOCATIONS
+  return true;
+#else
+  return false;
+#endif
+}
+
+size_t AllocationCounter::getAllocationCount()
+{
+  return allocation_count;
+}
+
+size_t AllocationCounter::getAllocatedBytes()
+{
+  return allocated_bytes;
+}
+
+#ifdef CG_COUNT_ALLOCATIONS
+namespace
+{
+void* countedAlloc(size_t size)
+{
+  allocation_count.fetch_add(1, std::memory_order_relaxed);
+  allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  return std::malloc(size ? size : 1);
+}
+}
+
+void* operator new(size_t size)
+{
+  void* ptr = countedAlloc(size);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new[](size_t size)
+{
+  void* ptr = countedAlloc(size);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+  return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+  return countedAlloc(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+  std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) throw()
+{
+  std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) throw()
+{
+  std::free(ptr);
+}
+#endif
@@ -0,0 +1,21 @@
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+// Counts heap allocations made through operator new. The counting operators
+// are only compiled in with CG_COUNT_ALLOCATIONS (the CMake option
+// CGTASK2_COUNT_ALLOCATIONS); otherwise isEnabled() is false and the counts
+// stay 0.
+class AllocationCounter
+{
+public:
+  static bool isEnabled();
+  static size_t getAllocationCount();
+  static size_t getAllocatedBytes();
+
+private:
+  AllocationCounter();
+};
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,30 @@
+#ifndef ANIMATIONQUALITY_H
+#define ANIMATIONQUALITY_H
+
+#include <cstddef>
+
+// How much animation work a drawer does per frame; the default is full
+// quality. Chosen by the FrameBudget under load.
+struct AnimationQuality
+{
+  // Extra mesh LOD levels on top of the one picked by projected size.
+  size_t lod_bias;
+  // Face normals are recomputed every normal_interval frames, in between
+  // the vertex normals gather the previous ones.
+  unsigned normal_interval;
+  // Distant instances sample their pose at least every pose_interval
+  // updates and blend in between, see IModelDrawer::calcPoseInterval.
+  unsigned pose_interval;
+  // Whether joints and bones are drawn when enabled.
+  bool draw_glyphs;
+
+  AnimationQuality()
+      : lod_bias(0)
+      , normal_interval(1)
+      , pose_interval(1)
+      , draw_glyphs(true)
+  {
+  }
+};
+
+#endif // ANIMATIONQUALITY_H
@@ -0,0 +1,118 @@
+#include "AssetCache.h"
+#include "IQMImporter.h"
+#include "InFile.h"
+#include <iostream>
+#include <sstream>
+
+using std::cout;
+using std::endl;
+
+AssetCache::AssetCache()
+    : hit_cnt_(0)
+    , miss_cnt_(0)
+{
+}
+
+Model* AssetCache::loadModel(const std::string& path,
+    const std::vector<std::string>& animation_files,
+    const std::vector<float>& animation_repeat_time,
+    const std::vector<bool>& make_relative)
+{
+  IQMImporter importer;
+
+  std::string model_key = makeKey(path);
+  std::shared_ptr<Model>& shared = models_[model_key];
+  if (shared)
+  {
+    cout << "Asset cache: reusing model " << path << "." << endl;
+    hit_cnt_++;
+  }
+  else
+  {
+    cout << "Asset cache: importing model " << path << "." << endl;
+    miss_cnt_++;
+    shared.reset(importer.loadModel(path, std::vector<std::string>(),
+        std::vector<float>(), std::vector<bool>()));
+  }
+
+  Model* model = new Model(*shared);
+  for (size_t i = 0; i < animation_files.size(); i++)
+  {
+    // The clips depend on the model's joint order and the import flags.
+    std::ostringstream key;
+    key << model_key << '|' << makeKey(animation_files[i]) << '|'
+        << animation_repeat_time[i] << '|' << make_relative[i];
+    std::vector<std::shared_ptr<const Animation> >& clips = clips_[key.str()];
+    if (!clips.empty())
+    {
+      cout << "Asset cache: reusing animations " << animation_files[i] << "."
+           << endl;
+      hit_cnt_++;
+    }
+    else
+    {
+      cout << "Asset cache: importing animations " << animation_files[i]
+           << "." << endl;
+      miss_cnt_++;
+      for (const Animation& clip : importer.loadAnimations(path,
+               animation_files[i], animation_repeat_time[i], make_relative[i]))
+        clips.push_back(std::make_shared<const Animation>(clip));
+    }
+
+    for (const std::shared_ptr<const Animation>& clip : clips)
+      model->addAnimation(clip);
+  }
+  return model;
+}
+
+void AssetCache::releaseUnused()
+{
+  // Every instance shares the skeleton of its cache entry, and every clip
+  // of the animation files it was loaded with.
+  for (auto it = models_.begin(); it != models_.end();)
+  {
+    if (!it->second || it->second->getSkeleton().use_count() == 1)
+      it = models_.erase(it);
+    else
+      ++it;
+  }
+  for (auto it = clips_.begin(); it != clips_.end();)
+  {
+    if (it->second.empty() || it->second.front().use_count() == 1)
+      it = clips_.erase(it);
+    else
+      ++it;
+  }
+}
+
+size_t AssetCache::getHitCount() const
+{
+  return hit_cnt_;
+}
+
+size_t AssetCache::getMissCount() const
+{
+  return miss_cnt_;
+}
+
+uint64_t AssetCache::hashFile(const std::string& path)
+{
+  InFile file(path, InFile::OpenMode::BINARY);
+  if (!file.isOpen())
+    return 0;
+
+  uint64_t hash = 14695981039346656037ull;
+  for (unsigned char byte : file.toUnsignedCharVector())
+  {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string AssetCache::makeKey(const std::string& path)
+{
+  std::ostringstream key;
+  key << path << '#' << std::hex << hashFile(path);
+  return key.str();
+}
@@ -0,0 +1,49 @@
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Model.h"
+
+// Imports every model and animation file once per content and hands out
+// Model instances that share the immutable meshes, LODs, skeleton and clips.
+// Entries are keyed by path and a hash of the file's bytes, so a file edited
+// between loads is imported again. Per-instance state (current action, pose,
+// model matrix) lives in the drawers, not here.
+class AssetCache
+{
+public:
+  AssetCache();
+
+  // A new model sharing the cached assets, owned by the caller.
+  Model* loadModel(const std::string& path,
+      const std::vector<std::string>& animation_files,
+      const std::vector<float>& animation_repeat_time,
+      const std::vector<bool>& make_relative);
+
+  // Drops the entries no model refers to any more.
+  void releaseUnused();
+
+  size_t getHitCount() const;
+  size_t getMissCount() const;
+
+  // 64 bit FNV-1a of a file's bytes; 0 if it cannot be read.
+  static uint64_t hashFile(const std::string& path);
+
+private:
+  // Meshes, LODs, materials and skeleton without clips; instances are
+  // copies, which copy the shared pointers only.
+  std::map<std::string, std::shared_ptr<Model> > models_;
+  // The clips of one animation file for one model file.
+  std::map<std::string, std::vector<std::shared_ptr<const Animation> > >
+      clips_;
+  size_t hit_cnt_;
+  size_t miss_cnt_;
+
+  static std::string makeKey(const std::string& path);
+};
+
+#endif // ASSETCACHE_H
@@ -0,0 +1,289 @@
+#include "CompiledSpline.h"
+#include <algorithm>
+#include <cmath>
+
+#ifndef M_PI
+#define M_PI 3.141592f
+#endif
+
+namespace
+{
+// Lookups of the batch interpolation are done in chunks of this size, so
+// the scratch arrays stay on the stack.
+const size_t BATCH_CHUNK = 64;
+
+glm::vec3 reflect(const glm::vec3& v, const glm::vec3& normal, float c)
+{
+  return v - (2.f / c) * glm::dot(normal, v) * normal;
+}
+}
+
+const size_t CompiledSpline::SAMPLES_PER_SEGMENT;
+
+CompiledSpline::CompiledSpline()
+    : orientation_(Orientation::LOOK_AT)
+{
+}
+
+CompiledSpline::CompiledSpline(const Spline& spline, Orientation orientation)
+    : orientation_(orientation)
+{
+  // As in Spline::interpolate, the first and last point only shape the
+  // tangents.
+  const std::vector<SplinePoint>& points = spline.getPoints();
+  if (points.size() < 3)
+    return;
+  const SplinePoint* used = &points[1];
+  const size_t used_cnt = points.size() - 2;
+
+  for (size_t i = 0; i < used_cnt; i++)
+    times_.push_back(used[i].getTime());
+
+  // Hermite basis expanded into power form. The tangents are not scaled by
+  // the segment duration, matching interpolateSpline.
+  for (size_t i = 0; i + 1 < std::max<size_t>(used_cnt, 2); i++)
+  {
+    const SplinePoint& start = used[i];
+    const SplinePoint& end = used[std::min(i + 1, used_cnt - 1)];
+    const glm::vec3& p0 = start.getPoint();
+    const glm::vec3& p1 = end.getPoint();
+    const glm::vec3& m0 = start.getTangent();
+    const glm::vec3& m1 = end.getTangent();
+    float duration = end.getTime() - start.getTime();
+
+    Segment segment;
+    segment.a = 2.f * p0 + m0 - 2.f * p1 + m1;
+    segment.b = -3.f * p0 - 2.f * m0 + 3.f * p1 - m1;
+    segment.c = m0;
+    segment.d = p0;
+    segment.tangent_start = m0;
+    segment.tangent_end = m1;
+    segment.inv_duration = duration > 0.f ? 1.f / duration : 0.f;
+    segments_.push_back(segment);
+  }
+
+  buildArcLengths();
+  if (orientation_ == Orientation::ROTATION_MINIMIZING)
+    buildFrames();
+}
+
+SplineInterpolationResult CompiledSpline::interpolate(float time) const
+{
+  if (segments_.empty())
+    return SplineInterpolationResult(glm::vec3(0.f), glm::quat());
+
+  float u;
+  size_t index = findSegment(time, u);
+  const Segment& s = segments_[index];
+  glm::vec3 position = ((s.a * u + s.b) * u + s.c) * u + s.d;
+  glm::vec3 tangent = s.tangent_start * (1.f - u) + s.tangent_end * u;
+  return SplineInterpolationResult(position, orientationAt(index, u, tangent));
+}
+
+glm::vec3 CompiledSpline::getPosition(float time) const
+{
+  if (segments_.empty())
+    return glm::vec3(0.f);
+
+  float u;
+  const Segment& s = segments_[findSegment(time, u)];
+  return ((s.a * u + s.b) * u + s.c) * u + s.d;
+}
+
+void CompiledSpline::interpolate(const float* times,
+    size_t count,
+    glm::vec3* positions,
+    glm::quat* orientations) const
+{
+  if (segments_.empty())
+  {
+    std::fill(positions, positions + count, glm::vec3(0.f));
+    if (orientations)
+      std::fill(orientations, orientations + count, glm::quat());
+    return;
+  }
+
+  size_t indices[BATCH_CHUNK];
+  float params[BATCH_CHUNK];
+  for (size_t begin = 0; begin < count; begin += BATCH_CHUNK)
+  {
+    size_t chunk = std::min(BATCH_CHUNK, count - begin);
+    for (size_t i = 0; i < chunk; i++)
+      indices[i] = findSegment(times[begin + i], params[i]);
+
+    for (size_t i = 0; i < chunk; i++)
+    {
+      const Segment& s = segments_[indices[i]];
+      float u = params[i];
+      positions[begin + i] = ((s.a * u + s.b) * u + s.c) * u + s.d;
+    }
+
+    if (!orientations)
+      continue;
+    for (size_t i = 0; i < chunk; i++)
+    {
+      const Segment& s = segments_[indices[i]];
+      float u = params[i];
+      glm::vec3 tangent = s.tangent_start * (1.f - u) + s.tangent_end * u;
+      orientations[begin + i] = orientationAt(indices[i], u, tangent);
+    }
+  }
+}
+
+float CompiledSpline::getTimeAtDistance(float distance) const
+{
+  if (arc_lengths_.empty())
+    return getStartTime();
+
+  size_t sample = std::upper_bound(arc_lengths_.begin(), arc_lengths_.end(),
+                      distance) - arc_lengths_.begin();
+  if (sample == 0)
+    return getStartTime();
+  if (sample == arc_lengths_.size())
+    return getEndTime();
+
+  // Linear between the two samples around the distance.
+  float before = arc_lengths_[sample - 1];
+  float step = arc_lengths_[sample] - before;
+  float fraction = step > 0.f ? (distance - before) / step : 0.f;
+  float position = (sample - 1 + fraction) / SAMPLES_PER_SEGMENT;
+  size_t segment = std::min(static_cast<size_t>(position), segments_.size() - 1);
+  float u = position - segment;
+  return times_[segment] +
+         u * (times_[std::min(segment + 1, times_.size() - 1)] - times_[segment]);
+}
+
+float CompiledSpline::getLength() const
+{
+  return arc_lengths_.empty() ? 0.f : arc_lengths_.back();
+}
+
+float CompiledSpline::getStartTime() const
+{
+  return times_.empty() ? 0.f : times_.front();
+}
+
+float CompiledSpline::getEndTime() const
+{
+  return times_.empty() ? 0.f : times_.back();
+}
+
+size_t CompiledSpline::getSegmentCount() const
+{
+  return segments_.size();
+}
+
+size_t CompiledSpline::findSegment(float time, float& u) const
+{
+  // The last segment starting at or before the time; like interpolateSpline
+  // a time on a point belongs to the segment that starts there.
+  size_t index = std::upper_bound(times_.begin(), times_.end(), time) -
+                 times_.begin();
+  index = std::min(index > 0 ? index - 1 : 0, segments_.size() - 1);
+  u = (time - times_[index]) * segments_[index].inv_duration;
+  u = std::min(std::max(u, 0.f), 1.f);
+  return index;
+}
+
+glm::quat CompiledSpline::orientationAt(size_t segment,
+    float u,
+    const glm::vec3& tangent) const
+{
+  if (orientation_ == Orientation::LOOK_AT || frames_.empty())
+    return lookAt(tangent);
+
+  float position = u * SAMPLES_PER_SEGMENT;
+  size_t sample = std::min(static_cast<size_t>(position),
+      SAMPLES_PER_SEGMENT - 1);
+  size_t index = segment * SAMPLES_PER_SEGMENT + sample;
+  return glm::slerp(frames_[index], frames_[index + 1], position - sample);
+}
+
+void CompiledSpline::buildArcLengths()
+{
+  arc_lengths_.reserve(segments_.size() * SAMPLES_PER_SEGMENT + 1);
+  arc_lengths_.push_back(0.f);
+  glm::vec3 previous = segments_.front().d;
+  for (const Segment& s : segments_)
+  {
+    // Segments without duration are never travelled along.
+    for (size_t sample = 1; sample <= SAMPLES_PER_SEGMENT; sample++)
+    {
+      if (s.inv_duration == 0.f)
+      {
+        arc_lengths_.push_back(arc_lengths_.back());
+        continue;
+      }
+      float u = static_cast<float>(sample) / SAMPLES_PER_SEGMENT;
+      glm::vec3 position = ((s.a * u + s.b) * u + s.c) * u + s.d;
+      arc_lengths_.push_back(
+          arc_lengths_.back() + glm::length(position - previous));
+      previous = position;
+    }
+  }
+}
+
+void CompiledSpline::buildFrames()
+{
+  // Double reflection (Wang et al. 2008) on the curve's derivative; the
+  // up vector starts as the one of the look-at orientation.
+  const size_t sample_cnt = segments_.size() * SAMPLES_PER_SEGMENT + 1;
+  std::vector<glm::vec3> positions(sample_cnt);
+  std::vector<glm::vec3> tangents(sample_cnt);
+  for (size_t sample = 0; sample < sample_cnt; sample++)
+  {
+    size_t index =
+        std::min(sample / SAMPLES_PER_SEGMENT, segments_.size() - 1);
+    float u = static_cast<float>(sample - index * SAMPLES_PER_SEGMENT) /
+              SAMPLES_PER_SEGMENT;
+    const Segment& s = segments_[index];
+    positions[sample] = ((s.a * u + s.b) * u + s.c) * u + s.d;
+    glm::vec3 derivative = (3.f * s.a * u + 2.f * s.b) * u + s.c;
+    if (glm::dot(derivative, derivative) == 0.f)
+      derivative = s.tangent_start * (1.f - u) + s.tangent_end * u;
+    if (glm::dot(derivative, derivative) == 0.f)
+      derivative = sample > 0 ? tangents[sample - 1] : glm::vec3(0, 0, 1);
+    tangents[sample] = glm::normalize(derivative);
+  }
+
+  glm::vec3 up = lookAt(tangents[0]) * glm::vec3(0, 1, 0);
+  frames_.resize(sample_cnt);
+  for (size_t sample = 0; sample < sample_cnt; sample++)
+  {
+    const glm::vec3& t = tangents[sample];
+    if (sample > 0)
+    {
+      glm::vec3 v1 = positions[sample] - positions[sample - 1];
+      float c1 = glm::dot(v1, v1);
+      glm::vec3 up_l = up;
+      glm::vec3 t_l = tangents[sample - 1];
+      if (c1 > 0.f)
+      {
+        up_l = reflect(up, v1, c1);
+        t_l = reflect(t_l, v1, c1);
+      }
+      glm::vec3 v2 = t - t_l;
+      float c2 = glm::dot(v2, v2);
+      up = c2 > 0.f ? reflect(up_l, v2, c2) : up_l;
+    }
+    // Keep the frame orthonormal against rounding drift.
+    up = glm::normalize(up - glm::dot(up, t) * t);
+    frames_[sample] = glm::quat_cast(glm::mat3(glm::cross(up, t), up, t));
+  }
+}
+
+glm::quat CompiledSpline::lookAt(const glm::vec3& direction)
+{
+  // Half-way quaternion between +z and the direction: the same rotation as
+  // angleAxis(acos(dot), cross) in Spline::lookAtToOrientation.
+  glm::vec3 dir = glm::normalize(direction);
+  float dot = dir.z;
+
+  if (std::abs(dot + 1.f) < 0.001f)
+    return glm::angleAxis(static_cast<float>(M_PI), glm::vec3(0, 1, 0));
+
+  if (std::abs(dot - 1.f) < 0.001f)
+    return glm::quat();
+
+  return glm::normalize(glm::quat(1.f + dot, -dir.y, dir.x, 0.f));
+}
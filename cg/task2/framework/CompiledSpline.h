@@ -0,0 +1,201 @@
+#ifndef COMPILEDSPLINE_H
+#define COMPILEDSPLINE_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtx/quaternion.hpp>
+#include "Spline.h"
+
+/**
+* An immutable, evaluation friendly form of a Spline, built once after the
+* spline is loaded. Segments are found by binary search and hold their cubic
+* as polynomial coefficients. Optionally it carries an arc-length table for
+* constant-speed travel and rotation-minimizing frames.
+*
+* Positions and tangents match Spline::interpolate up to rounding; the
+* look-at orientation is the same rotation, computed without acos.
+*/
+class CompiledSpline
+{
+ public:
+  /**
+   * How the orientation along the spline is derived.
+   */
+  enum class Orientation
+  {
+    /**
+     * Shortest rotation of +z onto the tangent, as Spline::interpolate.
+     */
+    LOOK_AT,
+
+    /**
+     * Frames transported along the curve without twisting around it
+     * (double reflection method). They start at the look-at orientation.
+     */
+    ROTATION_MINIMIZING
+  };
+
+  /**
+   * Samples per segment of the arc-length table and the frame table.
+   */
+  static const size_t SAMPLES_PER_SEGMENT = 16;
+
+  /**
+   * Default constructor, creates an empty spline.
+   */
+  CompiledSpline();
+
+  /**
+   * Compiles the spline. Like Spline::interpolate, the outer points only
+   * carry tangents and are not travelled through.
+   * @param spline The spline with its tangents already calculated.
+   * @param orientation How orientations are derived.
+   */
+  CompiledSpline(const Spline& spline,
+      Orientation orientation = Orientation::LOOK_AT);
+
+  /**
+   * Interpolates the position and orientation at a time.
+   * @param time The time, clamped to the spline's time range.
+   * @return SplineInterpolationResult The position and orientation.
+   */
+  SplineInterpolationResult interpolate(float time) const;
+
+  /**
+   * Interpolates only the position at a time.
+   * @param time The time, clamped to the spline's time range.
+   * @return glm::vec3 The position.
+   */
+  glm::vec3 getPosition(float time) const;
+
+  /**
+   * Evaluates many times in one call, e.g. one per follower of the path.
+   * Segments are looked up first, then all polynomials are evaluated in a
+   * branch free loop.
+   * @param times The times to evaluate.
+   * @param count The number of times.
+   * @param positions Receives count positions.
+   * @param orientations Receives count orientations, may be null.
+   * @return void Nothing.
+   */
+  void interpolate(const float* times,
+      size_t count,
+      glm::vec3* positions,
+      glm::quat* orientations) const;
+
+  /**
+   * Maps a distance travelled along the spline to the time at which it is
+   * reached, for constant-speed travel.
+   * @param distance The distance from the first point, clamped to the
+   * spline's length.
+   * @return float The time.
+   */
+  float getTimeAtDistance(float distance) const;
+
+  /**
+   * Returns the approximate length of the spline.
+   * @return float The length, from the arc-length table.
+   */
+  float getLength() const;
+
+  /**
+   * Returns the time of the first point.
+   * @return float Time of the first point.
+   */
+  float getStartTime() const;
+
+  /**
+   * Returns the time of the last point.
+   * @return float Time of the last point.
+   */
+  float getEndTime() const;
+
+  /**
+   * Returns the number of segments.
+   * @return size_t The number of segments.
+   */
+  size_t getSegmentCount() const;
+
+ private:
+  /**
+   * Cubic position ((a * u + b) * u + c) * u + d over u in [0, 1] and the
+   * linearly interpolated tangent of one segment.
+   */
+  struct Segment
+  {
+    glm::vec3 a;
+    glm::vec3 b;
+    glm::vec3 c;
+    glm::vec3 d;
+    glm::vec3 tangent_start;
+    glm::vec3 tangent_end;
+    float inv_duration;
+  };
+
+  /**
+   * How orientations are derived.
+   */
+  Orientation orientation_;
+
+  /**
+   * Start times of all points, searched to find the segment of a time.
+   */
+  std::vector<float> times_;
+
+  /**
+   * One entry per segment.
+   */
+  std::vector<Segment> segments_;
+
+  /**
+   * Arc length at every sample, SAMPLES_PER_SEGMENT per segment plus the
+   * end point.
+   */
+  std::vector<float> arc_lengths_;
+
+  /**
+   * Rotation-minimizing frame at every sample, only with
+   * Orientation::ROTATION_MINIMIZING.
+   */
+  std::vector<glm::quat> frames_;
+
+  /**
+   * Returns the segment and local parameter u of a time.
+   * @param time The time.
+   * @param u Receives the parameter within the segment, in [0, 1].
+   * @return size_t The segment index.
+   */
+  size_t findSegment(float time, float& u) const;
+
+  /**
+   * Computes the orientation at a segment parameter.
+   * @param segment The segment index.
+   * @param u The parameter within the segment.
+   * @param tangent The interpolated tangent at u.
+   * @return glm::quat The orientation.
+   */
+  glm::quat orientationAt(size_t segment,
+      float u,
+      const glm::vec3& tangent) const;
+
+  /**
+   * Calculates the arc-length table.
+   * @return void Nothing.
+   */
+  void buildArcLengths();
+
+  /**
+   * Calculates the rotation-minimizing frames.
+   * @return void Nothing.
+   */
+  void buildFrames();
+
+  /**
+   * Rotation of +z onto the direction, as Spline::lookAtToOrientation.
+   * @param direction The direction to look in.
+   * @return glm::quat The orientation.
+   */
+  static glm::quat lookAt(const glm::vec3& direction);
+};
+
+#endif
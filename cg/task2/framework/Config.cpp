@@ -129,6 +129,26 @@ float Config::getJointSize() const
   return joint_size_;
 }
 
+Image::EncoderProfile Config::getScreenshotCompression() const
+{
+  return screenshot_compression_;
+}
+
+bool Config::hasScreenshotVideo() const
+{
+  return !screenshot_video_.empty();
+}
+
+const std::string& Config::getScreenshotVideo() const
+{
+  return screenshot_video_;
+}
+
+unsigned Config::getScreenshotVideoFrameRate() const
+{
+  return screenshot_video_frame_rate_;
+}
+
 bool Config::load(const std::string& file_name)
 {
   std::cout << "Loading the config file from '" << file_name << "'."
@@ -313,12 +333,9 @@ bool Config::load(const std::string& file_name)
   else
   {
     ss.str(screenshots_xml->FirstChild()->Value());
-    while (ss)
-    {
-      float frame_time;
-      ss >> frame_time;
+    float frame_time;
+    while (ss >> frame_time)
       screenshot_frames_.push_back(frame_time);
-    }
     ss.clear();
   }
 
@@ -360,5 +377,45 @@ bool Config::load(const std::string& file_name)
     ss.clear();
   }
 
+  screenshot_compression_ = Image::EncoderProfile::FAST;
+  XMLElement* compression_xml =
+      doc.FirstChildElement("screenshot_compression");
+  if (compression_xml)
+  {
+    std::string compression = compression_xml->FirstChild()->Value();
+    if (compression == "store")
+      screenshot_compression_ = Image::EncoderProfile::STORE;
+    else if (compression == "best")
+      screenshot_compression_ = Image::EncoderProfile::BEST;
+    else if (compression != "fast")
+      std::cerr << "Config: Unknown screenshot compression " << compression
+                << ", using fast." << std::endl;
+  }
+
+  // Screenshots stream into one video instead of PNG files. A duration
+  // replaces the screenshot times by evenly spaced frames, for sequences
+  // too long to list.
+  screenshot_video_.clear();
+  screenshot_video_frame_rate_ = 30;
+  XMLElement* video_xml = doc.FirstChildElement("screenshot_video");
+  if (video_xml && video_xml->FirstChild())
+  {
+    screenshot_video_ = video_xml->FirstChild()->Value();
+    video_xml->QueryAttribute("fps", &screenshot_video_frame_rate_);
+    if (screenshot_video_frame_rate_ == 0)
+      screenshot_video_frame_rate_ = 30;
+    float duration = 0.f;
+    if (video_xml->QueryAttribute("duration", &duration) == 0 &&
+        duration > 0.f)
+    {
+      size_t frame_cnt =
+          static_cast<size_t>(duration * screenshot_video_frame_rate_ + 0.5f);
+      screenshot_frames_.clear();
+      for (size_t frame = 0; frame < frame_cnt; frame++)
+        screenshot_frames_.push_back(
+            static_cast<float>(frame) / screenshot_video_frame_rate_);
+    }
+  }
+
   return true;
 }
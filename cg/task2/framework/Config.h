@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 #include "tinyxml2.h"
 #include "Spline.h"
+#include "Image.h"
 
 class Config
 {
@@ -36,6 +37,11 @@ class Config
   unsigned getAnimationBlendingTo() const;
   float getBoneSize() const;
   float getJointSize() const;
+  Image::EncoderProfile getScreenshotCompression() const;
+  bool hasScreenshotVideo() const;
+  // Video target of the screenshots, see VideoSink.
+  const std::string& getScreenshotVideo() const;
+  unsigned getScreenshotVideoFrameRate() const;
 
   bool load(const std::string& file_name);
 
@@ -61,6 +67,9 @@ class Config
   unsigned animation_blend_to_;
   float bone_size_;
   float joint_size_;
+  Image::EncoderProfile screenshot_compression_;
+  std::string screenshot_video_;
+  unsigned screenshot_video_frame_rate_;
 };
 
 #endif // Config_H_INCLUDED
@@ -0,0 +1,79 @@
+#include "FrameArena.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+// Covers every scalar and SIMD-friendly glm type.
+const size_t BLOCK_ALIGNMENT = 16;
+
+char* allocateBlock(size_t size)
+{
+  char* block = static_cast<char*>(std::malloc(size ? size : 1));
+  if (!block)
+    throw std::bad_alloc();
+  return block;
+}
+}
+
+FrameArena::FrameArena(size_t capacity)
+    : block_(0)
+    , capacity_(capacity)
+    , used_(0)
+    , overflow_bytes_(0)
+{
+  if (capacity_)
+    block_ = allocateBlock(capacity_);
+}
+
+FrameArena::~FrameArena()
+{
+  for (char* block : overflow_blocks_)
+    std::free(block);
+  std::free(block_);
+}
+
+void FrameArena::reset()
+{
+  if (!overflow_blocks_.empty())
+  {
+    // Grow to what the last frame needed in total, with headroom.
+    size_t needed = used_ + overflow_bytes_;
+    for (char* block : overflow_blocks_)
+      std::free(block);
+    overflow_blocks_.clear();
+    std::free(block_);
+    capacity_ = needed + needed / 2;
+    block_ = allocateBlock(capacity_);
+  }
+  used_ = 0;
+  overflow_bytes_ = 0;
+}
+
+size_t FrameArena::getCapacity() const
+{
+  return capacity_;
+}
+
+size_t FrameArena::getUsedBytes() const
+{
+  return used_ + overflow_bytes_;
+}
+
+void* FrameArena::allocateBytes(size_t size, size_t alignment)
+{
+  if (alignment < BLOCK_ALIGNMENT)
+    alignment = BLOCK_ALIGNMENT;
+  size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+  if (block_ && offset + size <= capacity_)
+  {
+    used_ = offset + size;
+    return block_ + offset;
+  }
+
+  // malloc alignment suffices for the types stored here.
+  char* block = allocateBlock(size);
+  overflow_blocks_.push_back(block);
+  overflow_bytes_ += size + alignment;
+  return block;
+}
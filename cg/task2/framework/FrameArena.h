@@ -0,0 +1,47 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Bump allocator for scratch data that lives until the end of a frame.
+// reset() releases everything at once. Allocations that do not fit the
+// block go to overflow blocks; the next reset() replaces all blocks with
+// one block large enough for the whole frame, so after a warm-up frame the
+// arena stops touching the heap.
+class FrameArena
+{
+public:
+  explicit FrameArena(size_t capacity = 0);
+  ~FrameArena();
+
+  // Uninitialized storage for count objects; never null for count > 0.
+  template<typename T>
+  T* allocate(size_t count)
+  {
+    static_assert(std::is_trivially_destructible<T>::value,
+        "FrameArena never runs destructors");
+    return static_cast<T*>(allocateBytes(count * sizeof(T), alignof(T)));
+  }
+
+  void reset();
+
+  size_t getCapacity() const;
+  // Bytes handed out since the last reset, padding included.
+  size_t getUsedBytes() const;
+
+private:
+  char* block_;
+  size_t capacity_;
+  size_t used_;
+  std::vector<char*> overflow_blocks_;
+  size_t overflow_bytes_;
+
+  void* allocateBytes(size_t size, size_t alignment);
+
+  FrameArena(const FrameArena&);
+  FrameArena& operator=(const FrameArena&);
+};
+
+#endif // FRAMEARENA_H
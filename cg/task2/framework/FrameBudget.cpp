@@ -0,0 +1,127 @@
+#include "FrameBudget.h"
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+// Weight of the newest frame in the smoothed frame time.
+const double SMOOTHING = 0.1;
+// A level is given up after this many frames over the target ...
+const unsigned DOWNGRADE_FRAMES = 10;
+// ... and won back after this many frames under UPGRADE_HEADROOM of it.
+const unsigned UPGRADE_FRAMES = 60;
+const double UPGRADE_HEADROOM = 0.75;
+// A level that was won back and lost again right away is retried only after
+// twice as long, up to this many frames.
+const unsigned MAX_UPGRADE_FRAMES = 960;
+
+AnimationQuality makeQuality(size_t lod_bias,
+    unsigned normal_interval,
+    unsigned pose_interval,
+    bool draw_glyphs)
+{
+  AnimationQuality quality;
+  quality.lod_bias = lod_bias;
+  quality.normal_interval = normal_interval;
+  quality.pose_interval = pose_interval;
+  quality.draw_glyphs = draw_glyphs;
+  return quality;
+}
+}
+
+FrameBudget::FrameBudget(double target_ms)
+    : target_ms_(target_ms)
+    , smoothed_ms_(target_ms)
+    , level_(0)
+    , over_cnt_(0)
+    , under_cnt_(0)
+    , upgrade_frames_(UPGRADE_FRAMES)
+    , last_change_up_(false)
+{
+  // Cheapest losses first: debug glyphs, then stale normals and poses of
+  // distant instances, mesh detail last.
+  levels_.push_back(makeQuality(0, 1, 1, true));
+  levels_.push_back(makeQuality(0, 1, 1, false));
+  levels_.push_back(makeQuality(0, 2, 1, false));
+  levels_.push_back(makeQuality(0, 2, 2, false));
+  levels_.push_back(makeQuality(1, 2, 2, false));
+  levels_.push_back(makeQuality(1, 4, 4, false));
+  levels_.push_back(makeQuality(2, 4, 8, false));
+}
+
+bool FrameBudget::addFrame(double frame_ms)
+{
+  smoothed_ms_ += SMOOTHING * (frame_ms - smoothed_ms_);
+
+  if (smoothed_ms_ > target_ms_)
+  {
+    under_cnt_ = 0;
+    if (++over_cnt_ >= DOWNGRADE_FRAMES && level_ + 1 < levels_.size())
+    {
+      if (last_change_up_)
+        upgrade_frames_ = std::min(2 * upgrade_frames_, MAX_UPGRADE_FRAMES);
+      last_change_up_ = false;
+      setLevel(level_ + 1);
+      return true;
+    }
+  }
+  else if (smoothed_ms_ < target_ms_ * UPGRADE_HEADROOM)
+  {
+    over_cnt_ = 0;
+    if (++under_cnt_ >= upgrade_frames_ && level_ > 0)
+    {
+      last_change_up_ = true;
+      setLevel(level_ - 1);
+      return true;
+    }
+  }
+  else
+  {
+    over_cnt_ = 0;
+    under_cnt_ = 0;
+  }
+  return false;
+}
+
+double FrameBudget::getTarget() const
+{
+  return target_ms_;
+}
+
+double FrameBudget::getSmoothedFrameTime() const
+{
+  return smoothed_ms_;
+}
+
+unsigned FrameBudget::getLevel() const
+{
+  return level_;
+}
+
+unsigned FrameBudget::getLevelCount() const
+{
+  return static_cast<unsigned>(levels_.size());
+}
+
+const AnimationQuality& FrameBudget::getQuality() const
+{
+  return levels_[level_];
+}
+
+void FrameBudget::setLevel(unsigned level)
+{
+  level_ = level;
+  over_cnt_ = 0;
+  under_cnt_ = 0;
+
+  const AnimationQuality& quality = levels_[level_];
+  cout << "Frame budget: " << smoothed_ms_ << " ms for a " << target_ms_
+       << " ms target, quality level " << level_ << " (LOD +"
+       << quality.lod_bias << ", normals every " << quality.normal_interval
+       << " frames, distant poses every " << quality.pose_interval
+       << " updates, glyphs " << (quality.draw_glyphs ? "on" : "off") << ")."
+       << endl;
+}
@@ -0,0 +1,41 @@
+#ifndef FRAMEBUDGET_H
+#define FRAMEBUDGET_H
+
+#include <vector>
+#include "AnimationQuality.h"
+
+// Holds the frame time under a target by trading animation quality. Frame
+// times are smoothed; while they stay above the target the quality drops one
+// level at a time, while they stay well below it for longer it rises again.
+// Level 0 is full quality, every level gives up one more thing (debug
+// glyphs, normal updates, pose updates of distant instances, mesh detail).
+class FrameBudget
+{
+public:
+  explicit FrameBudget(double target_ms);
+
+  // Feeds the time of the last frame; true when the level changed.
+  bool addFrame(double frame_ms);
+
+  double getTarget() const;
+  double getSmoothedFrameTime() const;
+  unsigned getLevel() const;
+  unsigned getLevelCount() const;
+  const AnimationQuality& getQuality() const;
+
+private:
+  double target_ms_;
+  double smoothed_ms_;
+  unsigned level_;
+  // Consecutive frames over, respectively well under, the target.
+  unsigned over_cnt_;
+  unsigned under_cnt_;
+  // Frames under the target needed to win a level back.
+  unsigned upgrade_frames_;
+  bool last_change_up_;
+  std::vector<AnimationQuality> levels_;
+
+  void setLevel(unsigned level);
+};
+
+#endif // FRAMEBUDGET_H
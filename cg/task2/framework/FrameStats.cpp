@@ -0,0 +1,97 @@
+#include "FrameStats.h"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+FrameStats::FrameStats(const std::vector<std::string>& stage_names)
+    : stage_names_(stage_names)
+    , samples_(stage_names.size())
+{
+}
+
+void FrameStats::record(size_t stage, double milliseconds)
+{
+  samples_[stage].push_back(milliseconds);
+}
+
+void FrameStats::reserve(size_t frame_count)
+{
+  for (std::vector<double>& samples : samples_)
+    samples.reserve(frame_count);
+}
+
+size_t FrameStats::getStageCount() const
+{
+  return stage_names_.size();
+}
+
+const std::string& FrameStats::getStageName(size_t stage) const
+{
+  return stage_names_[stage];
+}
+
+size_t FrameStats::getSampleCount(size_t stage) const
+{
+  return samples_[stage].size();
+}
+
+FrameStats::Summary FrameStats::summarize(size_t stage) const
+{
+  Summary summary = {0.0, 0.0, 0.0, 0.0, 0.0};
+  std::vector<double> sorted = samples_[stage];
+  if (sorted.empty())
+    return summary;
+
+  std::sort(sorted.begin(), sorted.end());
+  double sum = 0.0;
+  for (double sample : sorted)
+    sum += sample;
+
+  // Nearest rank.
+  auto percentile = [&sorted](double p)
+  {
+    size_t rank = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+  };
+  summary.mean = sum / sorted.size();
+  summary.p50 = percentile(0.5);
+  summary.p95 = percentile(0.95);
+  summary.p99 = percentile(0.99);
+  summary.max = sorted.back();
+  return summary;
+}
+
+std::string FrameStats::toString() const
+{
+  std::stringstream ss;
+  ss << std::left << std::setw(10) << "stage" << std::right << std::setw(10)
+     << "mean" << std::setw(10) << "p50" << std::setw(10) << "p95"
+     << std::setw(10) << "p99" << std::setw(10) << "max" << std::endl;
+  ss << std::fixed << std::setprecision(3);
+  for (size_t stage = 0; stage < stage_names_.size(); stage++)
+  {
+    Summary summary = summarize(stage);
+    ss << std::left << std::setw(10) << stage_names_[stage] << std::right
+       << std::setw(10) << summary.mean << std::setw(10) << summary.p50
+       << std::setw(10) << summary.p95 << std::setw(10) << summary.p99
+       << std::setw(10) << summary.max << "  ms" << std::endl;
+  }
+  return ss.str();
+}
+
+std::string FrameStats::toJson() const
+{
+  std::stringstream ss;
+  ss << std::setprecision(6) << "{";
+  for (size_t stage = 0; stage < stage_names_.size(); stage++)
+  {
+    Summary summary = summarize(stage);
+    ss << (stage ? ", " : "") << "\"" << stage_names_[stage]
+       << "\": {\"mean_ms\": " << summary.mean
+       << ", \"p50_ms\": " << summary.p50 << ", \"p95_ms\": " << summary.p95
+       << ", \"p99_ms\": " << summary.p99 << ", \"max_ms\": " << summary.max
+       << "}";
+  }
+  ss << "}";
+  return ss.str();
+}
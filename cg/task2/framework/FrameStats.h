@@ -0,0 +1,42 @@
+#ifndef FRAMESTATS_H
+#define FRAMESTATS_H
+
+#include <string>
+#include <vector>
+
+// Collects per-frame timings of named stages (update, draw, ...) and
+// summarizes them as mean and percentiles, in milliseconds.
+class FrameStats
+{
+public:
+  struct Summary
+  {
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+  };
+
+  explicit FrameStats(const std::vector<std::string>& stage_names);
+
+  // One sample per stage and frame.
+  void record(size_t stage, double milliseconds);
+  void reserve(size_t frame_count);
+
+  size_t getStageCount() const;
+  const std::string& getStageName(size_t stage) const;
+  size_t getSampleCount(size_t stage) const;
+  Summary summarize(size_t stage) const;
+
+  // A table with one row per stage.
+  std::string toString() const;
+  // {"mean_ms": ..., "p50_ms": ..., ...} objects keyed by stage name.
+  std::string toJson() const;
+
+private:
+  std::vector<std::string> stage_names_;
+  std::vector<std::vector<double>> samples_;
+};
+
+#endif // FRAMESTATS_H
@@ -1,11 +1,37 @@
 #include "GLBuffer.h"
+#include "GLCapabilities.h"
+#include "GLState.h"
 #include <GL/gl3w.h>
+#include <algorithm>
+#include <iostream>
 
-GLBuffer::GLBuffer(BufferType type) : handle_(0), type_(type)
+// ARB_buffer_storage is newer than the gl3w headers we ship, so the entry
+// point and its flags are resolved by hand.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size,
+    const void* data, GLbitfield flags);
+
+GLBuffer::GLBuffer(BufferType type)
+    : handle_(0)
+    , type_(type)
+    , gl_usage_(GL_STATIC_DRAW)
+    , size_(0)
+    , ring_mode_(SUB_DATA)
+    , ring_slot_size_(0)
+    , ring_slot_count_(0)
+    , ring_slot_(0)
+    , ring_data_(0)
 {
   gl_type_ = GL_ARRAY_BUFFER;
   if (type_ == INDEX_BUFFER)
     gl_type_ = GL_ELEMENT_ARRAY_BUFFER;
+  else if (type_ == PIXEL_PACK_BUFFER)
+    gl_type_ = GL_PIXEL_PACK_BUFFER;
 }
 
 GLBuffer::~GLBuffer()
@@ -20,12 +46,12 @@ void GLBuffer::create()
 
 void GLBuffer::bind()
 {
-  glBindBuffer(gl_type_, handle_);
+  GLState::bindBuffer(gl_type_, handle_);
 }
 
 void GLBuffer::unbind()
 {
-  glBindBuffer(gl_type_, 0);
+  GLState::bindBuffer(gl_type_, 0);
 }
 
 void GLBuffer::allocate(size_t byte_count, Usage usage)
@@ -35,8 +61,11 @@ void GLBuffer::allocate(size_t byte_count, Usage usage)
     gl_usage_ = GL_DYNAMIC_DRAW;
   else if (usage == STREAM_DRAW)
     gl_usage_ = GL_STREAM_DRAW;
+  else if (usage == STREAM_READ)
+    gl_usage_ = GL_STREAM_READ;
 
   glBufferData(gl_type_, byte_count, 0, gl_usage_);
+  GLState::countCall();
 
   size_ = byte_count;
 }
@@ -44,16 +73,19 @@ void GLBuffer::allocate(size_t byte_count, Usage usage)
 void GLBuffer::discardData()
 {
   glBufferData(gl_type_, size_, 0, gl_usage_);
+  GLState::countCall();
 }
 
 void GLBuffer::write(size_t size, const void* data, int offset)
 {
   glBufferSubData(gl_type_, offset, size, data);
+  GLState::countCall();
 }
 
 void GLBuffer::write(size_t size, const float* data, int offset)
 {
   glBufferSubData(gl_type_, offset, size * sizeof(float), data);
+  GLState::countCall();
 }
 
 void GLBuffer::write(const std::vector<glm::vec3>& data, int offset)
@@ -64,6 +96,7 @@ void GLBuffer::write(const std::vector<glm::vec3>& data, int offset)
 void GLBuffer::write(size_t size, const int* data, int offset)
 {
   glBufferSubData(gl_type_, offset, size * sizeof(int), data);
+  GLState::countCall();
 }
 
 void GLBuffer::write(const std::vector<glm::ivec3>& data, int offset)
@@ -74,6 +107,7 @@ void GLBuffer::write(const std::vector<glm::ivec3>& data, int offset)
 void GLBuffer::map(void** data, BufferAccessType type)
 {
   *data = glMapBuffer(gl_type_, type );
+  GLState::countCall();
 }
 
 void GLBuffer::map(float** data, BufferAccessType type)
@@ -89,10 +123,198 @@ void GLBuffer::map(glm::vec3** data, BufferAccessType type)
 void GLBuffer::unmap()
 {
   glUnmapBuffer(gl_type_);
+  GLState::countCall();
 }
+
 void GLBuffer::destroy()
 {
+  destroyRing();
   if (handle_)
+  {
+    GLState::forgetBuffer(handle_);
     glDeleteBuffers(1, &handle_);
+  }
+  handle_ = 0;
+}
+
+void GLBuffer::allocateRing(size_t slot_byte_count, unsigned slot_count)
+{
+  destroyRing();
+
+  ring_slot_size_ = slot_byte_count;
+  ring_slot_count_ = slot_count;
+  ring_slot_ = slot_count - 1;
+  size_ = slot_byte_count * slot_count;
+  gl_usage_ = GL_STREAM_DRAW;
+
+  BufferStorageProc buffer_storage = 0;
+  if (GLCapabilities::hasBufferStorage() && GLCapabilities::hasSync())
+    buffer_storage = reinterpret_cast<BufferStorageProc>(
+        gl3wGetProcAddress("glBufferStorage"));
+
+  if (buffer_storage)
+  {
+    const GLbitfield flags =
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    buffer_storage(gl_type_, size_, 0, flags);
+    ring_data_ =
+        static_cast<unsigned char*>(glMapBufferRange(gl_type_, 0, size_, flags));
+    if (ring_data_)
+    {
+      ring_mode_ = PERSISTENT;
+    }
+    else
+    {
+      // Immutable storage can't be respecified, start over with a new name.
+      destroy();
+      create();
+      bind();
+    }
+  }
+
+  if (!ring_data_)
+  {
+    glBufferData(gl_type_, size_, 0, gl_usage_);
+    if (GLCapabilities::hasMapBufferRange() && GLCapabilities::hasSync())
+    {
+      ring_mode_ = UNSYNCHRONIZED;
+    }
+    else
+    {
+      ring_mode_ = SUB_DATA;
+      ring_staging_.resize(ring_slot_size_);
+    }
+  }
+
+  if (ring_mode_ != SUB_DATA)
+    ring_fences_.assign(ring_slot_count_, static_cast<GLsync>(0));
+
+  std::cout << "Allocated ring buffer with " << slot_count << " slots of "
+            << slot_byte_count << " bytes (mode " << ring_mode_ << ")."
+            << std::endl;
+}
+
+void* GLBuffer::beginRingWrite()
+{
+  // Everything issued since the current slot was handed out (including the
+  // draws reading it) is covered by this fence.
+  if (ring_mode_ != SUB_DATA)
+  {
+    ring_fences_[ring_slot_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    GLState::countCall();
+  }
+
+  ring_slot_ = (ring_slot_ + 1) % ring_slot_count_;
+  size_t offset = ring_slot_ * ring_slot_size_;
+  ring_written_.clear();
+
+  switch (ring_mode_)
+  {
+  case PERSISTENT:
+    waitForRingSlot(ring_slot_);
+    return ring_data_ + offset;
+  case UNSYNCHRONIZED:
+    waitForRingSlot(ring_slot_);
+    GLState::countCall();
+    return glMapBufferRange(gl_type_, offset, ring_slot_size_,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+            GL_MAP_INVALIDATE_RANGE_BIT);
+  case SUB_DATA:
+  default:
+    return &ring_staging_[0];
+  }
+}
+
+void GLBuffer::markRingWritten(size_t offset, size_t byte_count)
+{
+  if (byte_count > 0)
+    ring_written_.push_back(std::make_pair(offset, byte_count));
+}
+
+size_t GLBuffer::endRingWrite()
+{
+  size_t offset = ring_slot_ * ring_slot_size_;
+  if (ring_mode_ == UNSYNCHRONIZED)
+  {
+    glUnmapBuffer(gl_type_);
+    GLState::countCall();
+  }
+  else if (ring_mode_ == SUB_DATA && ring_written_.empty())
+  {
+    glBufferSubData(gl_type_, offset, ring_slot_size_, &ring_staging_[0]);
+    GLState::countCall();
+  }
+  else if (ring_mode_ == SUB_DATA)
+  {
+    // One upload per run of adjacent or overlapping ranges.
+    std::sort(ring_written_.begin(), ring_written_.end());
+    size_t i = 0;
+    while (i < ring_written_.size())
+    {
+      size_t begin = ring_written_[i].first;
+      size_t end = begin + ring_written_[i].second;
+      for (i++; i < ring_written_.size() && ring_written_[i].first <= end; i++)
+        end = std::max(end, ring_written_[i].first + ring_written_[i].second);
+      glBufferSubData(
+          gl_type_, offset + begin, end - begin, &ring_staging_[begin]);
+      GLState::countCall();
+    }
+  }
+  return offset;
+}
+
+GLBuffer::RingMode GLBuffer::getRingMode() const
+{
+  return ring_mode_;
+}
+
+unsigned GLBuffer::getRingSlot() const
+{
+  return ring_slot_;
+}
+
+unsigned GLBuffer::getRingSlotCount() const
+{
+  return ring_slot_count_;
+}
+
+size_t GLBuffer::getRingSlotOffset(unsigned slot) const
+{
+  return slot * ring_slot_size_;
+}
+
+void GLBuffer::waitForRingSlot(unsigned slot)
+{
+  GLsync fence = ring_fences_[slot];
+  if (!fence)
+    return;
+
+  const GLuint64 timeout_ns = 1000000000;
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+  while (result == GL_TIMEOUT_EXPIRED)
+    result = glClientWaitSync(fence, 0, timeout_ns);
+
+  glDeleteSync(fence);
+  ring_fences_[slot] = 0;
+  GLState::countCall(2);
+}
+
+void GLBuffer::destroyRing()
+{
+  for (GLsync fence : ring_fences_)
+  {
+    if (fence)
+      glDeleteSync(fence);
+  }
+  ring_fences_.clear();
+  ring_staging_.clear();
+  ring_written_.clear();
+
+  if (ring_mode_ == PERSISTENT && ring_data_ && handle_)
+  {
+    bind();
+    glUnmapBuffer(gl_type_);
+  }
+  ring_data_ = 0;
 }
 
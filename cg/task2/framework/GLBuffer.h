@@ -2,6 +2,7 @@
 #define GLBUFFER_H
 
 #include <GL/gl3w.h>
+#include <utility>
 #include <vector>
 #include <glm/vec3.hpp>
 
@@ -11,7 +12,7 @@ public:
 
   enum BufferType
   {
-    VERTEX_BUFFER, INDEX_BUFFER
+    VERTEX_BUFFER, INDEX_BUFFER, PIXEL_PACK_BUFFER
   };
 
   enum BufferAccessType
@@ -21,7 +22,16 @@ public:
 
   enum Usage
   {
-    STREAM_DRAW, STATIC_DRAW, DYNAMIC_DRAW
+    STREAM_DRAW, STATIC_DRAW, DYNAMIC_DRAW, STREAM_READ
+  };
+
+  // How the slots of a ring buffer reach the GL. PERSISTENT maps the whole
+  // buffer once (ARB_buffer_storage), UNSYNCHRONIZED maps one slot per frame
+  // without implicit synchronization and SUB_DATA stages the slot in client
+  // memory and uploads it with glBufferSubData (plain GL 2.1).
+  enum RingMode
+  {
+    PERSISTENT, UNSYNCHRONIZED, SUB_DATA
   };
 
   GLBuffer(BufferType type);
@@ -43,12 +53,36 @@ public:
   void unmap();
   void destroy();
 
+  void allocateRing(size_t slot_byte_count, unsigned slot_count = 3);
+  void* beginRingWrite();
+  // Declares byte_count bytes at offset into the slot as written this frame;
+  // SUB_DATA uploads only those. Without any, the whole slot goes up.
+  void markRingWritten(size_t offset, size_t byte_count);
+  size_t endRingWrite();
+  RingMode getRingMode() const;
+  unsigned getRingSlot() const;
+  unsigned getRingSlotCount() const;
+  size_t getRingSlotOffset(unsigned slot) const;
+
 private:
   unsigned int handle_;
   BufferType type_;
   unsigned int gl_type_;
   GLenum gl_usage_;
   size_t size_;
+
+  RingMode ring_mode_;
+  size_t ring_slot_size_;
+  unsigned ring_slot_count_;
+  unsigned ring_slot_;
+  unsigned char* ring_data_;
+  std::vector<GLsync> ring_fences_;
+  std::vector<unsigned char> ring_staging_;
+  // (offset, byte count) pairs within the slot, see markRingWritten().
+  std::vector<std::pair<size_t, size_t> > ring_written_;
+
+  void waitForRingSlot(unsigned slot);
+  void destroyRing();
 };
 
 #endif // GLBUFFER_H
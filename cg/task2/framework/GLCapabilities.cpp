@@ -0,0 +1,68 @@
+#include "GLCapabilities.h"
+#include <GL/gl3w.h>
+#include <set>
+
+namespace
+{
+std::set<std::string> extensions;
+bool extensions_loaded = false;
+
+void loadExtensions()
+{
+  extensions_loaded = true;
+  if (!glGetStringi)
+    return;
+
+  GLint extension_cnt = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &extension_cnt);
+  for (GLint i = 0; i < extension_cnt; i++)
+  {
+    const GLubyte* name = glGetStringi(GL_EXTENSIONS, i);
+    if (name)
+      extensions.insert(reinterpret_cast<const char*>(name));
+  }
+}
+}
+
+bool GLCapabilities::hasVersion(int major, int minor)
+{
+  return gl3wIsSupported(major, minor) != 0;
+}
+
+bool GLCapabilities::hasExtension(const std::string& name)
+{
+  if (!extensions_loaded)
+    loadExtensions();
+  return extensions.count(name) != 0;
+}
+
+bool GLCapabilities::hasBufferStorage()
+{
+  return hasVersion(4, 4) || hasExtension("GL_ARB_buffer_storage");
+}
+
+bool GLCapabilities::hasMapBufferRange()
+{
+  return hasVersion(3, 0) || hasExtension("GL_ARB_map_buffer_range");
+}
+
+bool GLCapabilities::hasSync()
+{
+  return hasVersion(3, 2) || hasExtension("GL_ARB_sync");
+}
+
+bool GLCapabilities::hasInstancing()
+{
+  return (hasVersion(3, 3) || hasExtension("GL_ARB_instanced_arrays")) &&
+         glVertexAttribDivisor != 0 && glDrawArraysInstanced != 0;
+}
+
+bool GLCapabilities::hasProgramBinary()
+{
+  if (!(hasVersion(4, 1) || hasExtension("GL_ARB_get_program_binary")) ||
+      !glGetProgramBinary || !glProgramBinary || !glProgramParameteri)
+    return false;
+  GLint format_cnt = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &format_cnt);
+  return format_cnt > 0;
+}
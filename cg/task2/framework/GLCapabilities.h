@@ -0,0 +1,23 @@
+#ifndef GLCAPABILITIES_H
+#define GLCAPABILITIES_H
+
+#include <string>
+
+class GLCapabilities
+{
+public:
+  static bool hasVersion(int major, int minor);
+  static bool hasExtension(const std::string& name);
+
+  static bool hasBufferStorage();
+  static bool hasMapBufferRange();
+  static bool hasSync();
+  static bool hasInstancing();
+  // Program binaries can be retrieved and loaded in at least one format.
+  static bool hasProgramBinary();
+
+private:
+  GLCapabilities();
+};
+
+#endif // GLCAPABILITIES_H
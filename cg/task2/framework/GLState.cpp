@@ -0,0 +1,175 @@
+#include "GLState.h"
+
+namespace
+{
+const GLuint UNKNOWN = ~0u;
+const unsigned MAX_CACHED_ATTRIBS = 32;
+
+enum BufferSlot
+{
+  ARRAY_SLOT, ELEMENT_ARRAY_SLOT, PIXEL_PACK_SLOT, PIXEL_UNPACK_SLOT,
+  BUFFER_SLOT_CNT
+};
+
+GLuint program = UNKNOWN;
+GLuint vertex_array = 0;
+GLuint buffers[BUFFER_SLOT_CNT] = {UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN};
+
+// Enable state of the default vertex array. Named vertex arrays carry their
+// own enables, which are only set up once, so they aren't cached.
+unsigned attribs_enabled = 0;
+unsigned attribs_known = 0;
+
+unsigned calls = 0;
+unsigned skipped = 0;
+unsigned frame_calls = 0;
+unsigned frame_skipped = 0;
+
+int bufferSlot(GLenum target)
+{
+  switch (target)
+  {
+  case GL_ARRAY_BUFFER:
+    return ARRAY_SLOT;
+  case GL_ELEMENT_ARRAY_BUFFER:
+    return ELEMENT_ARRAY_SLOT;
+  case GL_PIXEL_PACK_BUFFER:
+    return PIXEL_PACK_SLOT;
+  case GL_PIXEL_UNPACK_BUFFER:
+    return PIXEL_UNPACK_SLOT;
+  default:
+    return -1;
+  }
+}
+
+void setAttribArray(GLuint index, bool enable)
+{
+  unsigned bit = index < MAX_CACHED_ATTRIBS ? 1u << index : 0u;
+  bool cacheable = bit && vertex_array == 0;
+  if (cacheable && (attribs_known & bit) &&
+      ((attribs_enabled & bit) != 0) == enable)
+  {
+    skipped++;
+    return;
+  }
+
+  if (enable)
+    glEnableVertexAttribArray(index);
+  else
+    glDisableVertexAttribArray(index);
+  calls++;
+
+  if (cacheable)
+  {
+    attribs_known |= bit;
+    attribs_enabled = enable ? attribs_enabled | bit : attribs_enabled & ~bit;
+  }
+}
+}
+
+void GLState::useProgram(GLuint new_program)
+{
+  if (program == new_program)
+  {
+    skipped++;
+    return;
+  }
+  glUseProgram(new_program);
+  program = new_program;
+  calls++;
+}
+
+void GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+  int slot = bufferSlot(target);
+  if (slot >= 0 && buffers[slot] == buffer)
+  {
+    skipped++;
+    return;
+  }
+  glBindBuffer(target, buffer);
+  if (slot >= 0)
+    buffers[slot] = buffer;
+  calls++;
+}
+
+void GLState::bindVertexArray(GLuint new_vertex_array)
+{
+  if (vertex_array == new_vertex_array)
+  {
+    skipped++;
+    return;
+  }
+  glBindVertexArray(new_vertex_array);
+  vertex_array = new_vertex_array;
+  calls++;
+
+  // The element array binding belongs to the vertex array object.
+  buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+}
+
+void GLState::enableVertexAttribArray(GLuint index)
+{
+  setAttribArray(index, true);
+}
+
+void GLState::disableVertexAttribArray(GLuint index)
+{
+  setAttribArray(index, false);
+}
+
+void GLState::forgetBuffer(GLuint buffer)
+{
+  for (int slot = 0; slot < BUFFER_SLOT_CNT; slot++)
+  {
+    if (buffers[slot] == buffer)
+      buffers[slot] = UNKNOWN;
+  }
+}
+
+void GLState::forgetVertexArray(GLuint old_vertex_array)
+{
+  if (vertex_array == old_vertex_array)
+  {
+    vertex_array = 0;
+    buffers[ELEMENT_ARRAY_SLOT] = UNKNOWN;
+  }
+}
+
+void GLState::invalidate()
+{
+  // The vertex array binding is left alone, it is only ever changed through
+  // bindVertexArray and the entry point may not exist on GL 2.1.
+  program = UNKNOWN;
+  for (int slot = 0; slot < BUFFER_SLOT_CNT; slot++)
+    buffers[slot] = UNKNOWN;
+  attribs_known = 0;
+}
+
+void GLState::countCall(unsigned call_cnt)
+{
+  calls += call_cnt;
+}
+
+void GLState::countSkipped(unsigned call_cnt)
+{
+  skipped += call_cnt;
+}
+
+void GLState::beginFrame()
+{
+  frame_calls = calls;
+  frame_skipped = skipped;
+  calls = 0;
+  skipped = 0;
+}
+
+unsigned GLState::getCallCount()
+{
+  return frame_calls;
+}
+
+unsigned GLState::getSkippedCount()
+{
+  return frame_skipped;
+}
@@ -0,0 +1,33 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/gl3w.h>
+
+// Thin cache in front of the GL binding state. Redundant binds and enables
+// are dropped before they reach the driver, and every call that does reach
+// it is counted so the per-frame GL traffic can be inspected.
+class GLState
+{
+public:
+  static void useProgram(GLuint program);
+  static void bindBuffer(GLenum target, GLuint buffer);
+  static void bindVertexArray(GLuint vertex_array);
+  static void enableVertexAttribArray(GLuint index);
+  static void disableVertexAttribArray(GLuint index);
+
+  // Must be called when a cached object is deleted, GL silently rebinds 0.
+  static void forgetBuffer(GLuint buffer);
+  static void forgetVertexArray(GLuint vertex_array);
+  static void invalidate();
+
+  static void countCall(unsigned call_cnt = 1);
+  static void countSkipped(unsigned call_cnt = 1);
+  static void beginFrame();
+  static unsigned getCallCount();
+  static unsigned getSkippedCount();
+
+private:
+  GLState();
+};
+
+#endif // GLSTATE_H
@@ -0,0 +1,101 @@
+#include "GlyphGeometry.h"
+
+namespace
+{
+std::vector<glm::vec3> buildGlyph(const glm::vec3* positions, size_t count)
+{
+  std::vector<glm::vec3> vertices;
+  for (size_t v_idx = 0; v_idx < count; v_idx += 3)
+  {
+    const glm::vec3& v1 = positions[v_idx];
+    const glm::vec3& v2 = positions[v_idx + 1];
+    const glm::vec3& v3 = positions[v_idx + 2];
+    glm::vec3 normal = glm::normalize(glm::cross(v2 - v1, v2 - v3));
+    for (size_t corner = 0; corner < 3; corner++)
+    {
+      vertices.push_back(positions[v_idx + corner]);
+      vertices.push_back(normal);
+    }
+  }
+  return vertices;
+}
+
+glm::mat3 cofactor(const glm::mat3& m)
+{
+  return glm::mat3(glm::cross(m[1], m[2]), glm::cross(m[2], m[0]),
+      glm::cross(m[0], m[1]));
+}
+}
+
+const std::vector<glm::vec3>& GlyphGeometry::getJointVertices()
+{
+  // A four sided pyramid with its tip on the joint's y axis.
+  static const glm::vec3 positions[JOINT_VERTEX_COUNT] = {
+      glm::vec3(-1, -1, 1), glm::vec3(0, 1, 0), glm::vec3(1, -1, 1),
+      glm::vec3(1, -1, -1), glm::vec3(0, 1, 0), glm::vec3(-1, -1, -1),
+      glm::vec3(1, -1, 1), glm::vec3(0, 1, 0), glm::vec3(1, -1, -1),
+      glm::vec3(-1, -1, -1), glm::vec3(0, 1, 0), glm::vec3(-1, -1, 1),
+      glm::vec3(1, -1, -1), glm::vec3(-1, -1, -1), glm::vec3(-1, -1, 1),
+      glm::vec3(1, -1, -1), glm::vec3(-1, -1, 1), glm::vec3(1, -1, 1)};
+  static const std::vector<glm::vec3> vertices =
+      buildGlyph(positions, JOINT_VERTEX_COUNT);
+  return vertices;
+}
+
+const std::vector<glm::vec3>& GlyphGeometry::getBoneVertices()
+{
+  // The open sides of a unit box reaching from y = 0 (parent) to y = 1
+  // (joint).
+  static const glm::vec3 positions[BONE_VERTEX_COUNT] = {
+      glm::vec3(1, 0, 1), glm::vec3(-1, 0, 1), glm::vec3(-1, 1, 1),
+      glm::vec3(1, 0, 1), glm::vec3(-1, 1, 1), glm::vec3(1, 1, 1),
+      glm::vec3(-1, 0, -1), glm::vec3(1, 0, -1), glm::vec3(1, 1, -1),
+      glm::vec3(-1, 0, -1), glm::vec3(1, 1, -1), glm::vec3(-1, 1, -1),
+      glm::vec3(1, 0, -1), glm::vec3(1, 0, 1), glm::vec3(1, 1, 1),
+      glm::vec3(1, 0, -1), glm::vec3(1, 1, 1), glm::vec3(1, 1, -1),
+      glm::vec3(-1, 0, 1), glm::vec3(-1, 0, -1), glm::vec3(-1, 1, -1),
+      glm::vec3(-1, 0, 1), glm::vec3(-1, 1, -1), glm::vec3(-1, 1, 1)};
+  static const std::vector<glm::vec3> vertices =
+      buildGlyph(positions, BONE_VERTEX_COUNT);
+  return vertices;
+}
+
+GlyphInstance GlyphGeometry::jointInstance(const glm::mat4& joint_transform,
+    float joint_size)
+{
+  GlyphInstance instance;
+  instance.model = joint_transform;
+  instance.model[0] *= joint_size;
+  instance.model[1] *= joint_size;
+  instance.model[2] *= joint_size;
+  instance.normal = cofactor(glm::mat3(instance.model));
+  return instance;
+}
+
+GlyphInstance GlyphGeometry::boneInstance(const glm::mat4& parent_transform,
+    const glm::mat4& joint_transform,
+    float bone_size)
+{
+  // The near end is the parent's xz plane, the far end the same plane moved
+  // to the joint's origin, so the unit box is sheared along y.
+  GlyphInstance instance;
+  instance.model[0] = parent_transform[0] * bone_size;
+  instance.model[1] = joint_transform[3] - parent_transform[3];
+  instance.model[2] = parent_transform[2] * bone_size;
+  instance.model[3] = parent_transform[3];
+  instance.normal = cofactor(glm::mat3(instance.model));
+  return instance;
+}
+
+void GlyphGeometry::transform(const GlyphInstance& instance,
+    const std::vector<glm::vec3>& glyph_vertices,
+    glm::vec3* out_vertices)
+{
+  for (size_t v_idx = 0; v_idx < glyph_vertices.size(); v_idx += 2)
+  {
+    out_vertices[v_idx] =
+        glm::vec3(instance.model * glm::vec4(glyph_vertices[v_idx], 1));
+    out_vertices[v_idx + 1] =
+        glm::normalize(instance.normal * glyph_vertices[v_idx + 1]);
+  }
+}
@@ -0,0 +1,43 @@
+#ifndef GLYPHGEOMETRY_H
+#define GLYPHGEOMETRY_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Per-instance data of a joint or bone glyph. The normal matrix is the
+// cofactor of the upper 3x3 of the model matrix, which keeps the winding
+// dependent sign the face normals had when they were computed on the CPU.
+struct GlyphInstance
+{
+  glm::mat4 model;
+  glm::mat3 normal;
+};
+
+// Static unit geometry of the debug glyphs, stored as interleaved
+// position/normal pairs, and the instance transforms that place them.
+class GlyphGeometry
+{
+public:
+  static const size_t JOINT_VERTEX_COUNT = 18;
+  static const size_t BONE_VERTEX_COUNT = 24;
+
+  static const std::vector<glm::vec3>& getJointVertices();
+  static const std::vector<glm::vec3>& getBoneVertices();
+
+  static GlyphInstance jointInstance(const glm::mat4& joint_transform,
+      float joint_size);
+  static GlyphInstance boneInstance(const glm::mat4& parent_transform,
+      const glm::mat4& joint_transform,
+      float bone_size);
+
+  // Expands one instance into world space glyph vertices, for renderers
+  // without instancing. out_vertices receives 2 * vertex count entries.
+  static void transform(const GlyphInstance& instance,
+      const std::vector<glm::vec3>& glyph_vertices,
+      glm::vec3* out_vertices);
+
+private:
+  GlyphGeometry();
+};
+
+#endif // GLYPHGEOMETRY_H
@@ -11,15 +11,50 @@
 #include "Shader.h"
 #include "Camera.h"
 #include "Config.h"
+#include "Animation.h"
+#include "Profiler.h"
+#include "../task2.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+namespace
+{
+// Hands every instance a different phase for its pose updates.
+std::atomic<unsigned> next_pose_stagger(0);
+}
+
+const float IModelDrawer::POSE_FULL_RATE_SIZE = 0.25f;
+const unsigned IModelDrawer::MAX_POSE_STEP = 3;
 
 IModelDrawer::IModelDrawer(const Model* model)
     : config_(0)
     , shader_(0)
+    , glyph_shader_(0)
+    , mesh_shader_(0)
     , camera_(0)
     , model_(model)
     , joint_size_(0.1f)
     , bone_size_(0.01f)
     , translation_(0.f)
+    , action_started_(false)
+    , curr_action_(0)
+    , update_cnt_(0)
+    , bounds_radius_(0.f)
+    , pose_lod_enabled_(true)
+    , pose_interval_(1)
+    , pose_stagger_(next_pose_stagger++)
+    , last_update_time_(0.f)
+    , has_pose_(false)
+    , pose_blend_valid_(false)
+    , pose_time_(0.f)
 {
 }
 
@@ -37,6 +72,16 @@ void IModelDrawer::setShader(Shader* shader)
   shader_ = shader;
 }
 
+void IModelDrawer::setGlyphShader(Shader* shader)
+{
+  glyph_shader_ = shader;
+}
+
+void IModelDrawer::setMeshShader(Shader* shader)
+{
+  mesh_shader_ = shader;
+}
+
 void IModelDrawer::setCamera(const Camera* camera)
 {
   camera_ = camera;
@@ -61,3 +106,285 @@ void IModelDrawer::orientate(const glm::quat& orientation)
 {
   orientation_ = orientation;
 }
+
+void IModelDrawer::setAnimationQuality(const AnimationQuality& quality)
+{
+  quality_ = quality;
+}
+
+void IModelDrawer::setPoseLodEnabled(bool enabled)
+{
+  pose_lod_enabled_ = enabled;
+  pose_blend_valid_ = false;
+}
+
+const AnimationQuality& IModelDrawer::getAnimationQuality() const
+{
+  return quality_;
+}
+
+void IModelDrawer::startAction(size_t action)
+{
+  curr_action_ = action;
+  action_started_ = true;
+}
+
+void IModelDrawer::update(float time)
+{
+  PROFILE_ZONE("ModelDrawer::update");
+
+  // Calculate the model matrix.
+  model_mat_ = glm::translate(glm::mat4(1), translation_);
+  model_mat_ *= glm::mat4_cast(orientation_);
+
+  // Calculate the normal matrix.
+  normal_mat_ = camera_->getViewMatrix() * model_mat_;
+  normal_mat_ = glm::transpose(glm::inverse(normal_mat_));
+
+  float dt = time - last_update_time_;
+  last_update_time_ = time;
+  pose_time_ = time;
+  if (!action_started_)
+    return;
+
+  unsigned interval = calcPoseInterval();
+  if (interval != pose_interval_)
+  {
+    pose_interval_ = interval;
+    pose_blend_valid_ = false;
+  }
+  if (interval == 1 || !has_pose_)
+  {
+    samplePose(time, joint_transformations_);
+    has_pose_ = true;
+    return;
+  }
+
+  // Far instances sample the pose they will reach at the end of the
+  // interval and blend toward it from the pose shown last; the phase is
+  // staggered per instance so their samples spread over the frames. Until
+  // the first interval starts, and in intervals that cross the loop point
+  // where blending would sweep through the whole clip, the pose is sampled
+  // every frame.
+  unsigned phase = (update_cnt_++ + pose_stagger_) % interval;
+  if (phase == 0)
+  {
+    float target_time = time + (interval - 1) * dt;
+    pose_blend_valid_ = !loopsBetween(time - dt, target_time);
+    if (pose_blend_valid_)
+    {
+      decompose(joint_transformations_, pose_from_);
+      samplePose(target_time, pose_sample_);
+      decompose(pose_sample_, pose_to_);
+    }
+  }
+  if (!pose_blend_valid_)
+  {
+    samplePose(time, joint_transformations_);
+    return;
+  }
+
+  float weight = static_cast<float>(phase + 1) / interval;
+  for (size_t j = 0; j < joint_transformations_.size(); j++)
+  {
+    const JointTRS& from = pose_from_[j];
+    const JointTRS& to = pose_to_[j];
+    glm::mat4& m = joint_transformations_[j];
+    m = glm::mat4_cast(glm::slerp(from.rotation, to.rotation, weight));
+    glm::vec3 scale = glm::mix(from.scale, to.scale, weight);
+    m[0] *= scale.x;
+    m[1] *= scale.y;
+    m[2] *= scale.z;
+    m[3] = glm::vec4(glm::mix(from.translation, to.translation, weight), 1.f);
+  }
+}
+
+unsigned IModelDrawer::calcPoseInterval() const
+{
+  // One step per halving of the projected size below POSE_FULL_RATE_SIZE;
+  // the frame budget may ask distant instances for longer intervals.
+  if (!pose_lod_enabled_ || !camera_ || bounds_radius_ <= 0.f)
+    return 1;
+  float size = calcProjectedSize();
+  if (size >= POSE_FULL_RATE_SIZE)
+    return 1;
+  unsigned step = static_cast<unsigned>(std::log2(POSE_FULL_RATE_SIZE / size));
+  unsigned interval = 1u << std::min(step, MAX_POSE_STEP);
+  return std::max(interval, quality_.pose_interval);
+}
+
+void IModelDrawer::samplePose(float time, std::vector<glm::mat4>& pose)
+{
+  if (config_->hasAnimationBlending())
+  {
+    const Animation& action_1 =
+        model_->getAnimation(config_->getAnimationBlendingFrom());
+    const Animation& action_2 =
+        model_->getAnimation(config_->getAnimationBlendingTo());
+
+    interpolateJointsForAnimationModulation(action_1.loopTime(time), action_2.loopTime(time), model_->getJoints(), action_1.getKeyframes(), action_2.getKeyframes(), pose);
+  }
+  else
+  {
+    const Animation& action = model_->getAnimation(curr_action_);
+
+    if (config_->useTransformationsFile())
+    {
+      const glm::mat4* track_pose = joint_track_.sample(time);
+      if (track_pose)
+        std::copy(track_pose, track_pose + joint_track_.getJointCount(),
+            pose.begin());
+    }
+    else
+    {
+      interpolateJoints(action.loopTime(time), model_->getJoints(), action.getKeyframes(), pose);
+    }
+  }
+}
+
+void IModelDrawer::decompose(const std::vector<glm::mat4>& pose,
+    std::vector<JointTRS>& trs)
+{
+  for (size_t j = 0; j < pose.size(); j++)
+  {
+    const glm::mat4& m = pose[j];
+    glm::vec3 scale(glm::length(glm::vec3(m[0])), glm::length(glm::vec3(m[1])),
+        glm::length(glm::vec3(m[2])));
+    glm::mat3 rotation(glm::vec3(m[0]) / scale.x, glm::vec3(m[1]) / scale.y,
+        glm::vec3(m[2]) / scale.z);
+    trs[j].translation = glm::vec3(m[3]);
+    trs[j].rotation = glm::quat_cast(rotation);
+    trs[j].scale = scale;
+  }
+}
+
+bool IModelDrawer::loopsBetween(float from, float to) const
+{
+  if (config_->hasAnimationBlending())
+  {
+    const Animation& action_1 =
+        model_->getAnimation(config_->getAnimationBlendingFrom());
+    const Animation& action_2 =
+        model_->getAnimation(config_->getAnimationBlendingTo());
+    return action_1.loopTime(to) < action_1.loopTime(from) ||
+           action_2.loopTime(to) < action_2.loopTime(from);
+  }
+  if (config_->useTransformationsFile())
+    return false;
+  const Animation& action = model_->getAnimation(curr_action_);
+  return action.loopTime(to) < action.loopTime(from);
+}
+
+float IModelDrawer::calcProjectedSize() const
+{
+  // Projected radius of the bounding sphere relative to half the viewport
+  // height.
+  glm::vec4 center = camera_->getViewMatrix() * model_mat_ *
+                     glm::vec4(bounds_center_, 1.f);
+  float distance = std::max(-center.z, bounds_radius_);
+  return bounds_radius_ * camera_->getProjMatrix()[1][1] / distance;
+}
+
+void IModelDrawer::calcBounds()
+{
+  glm::vec3 min_corner(std::numeric_limits<float>::max());
+  glm::vec3 max_corner(-std::numeric_limits<float>::max());
+  for (size_t i = 0; i < model_->getMeshCount(); i++)
+  {
+    for (const glm::vec3& vertex : model_->getMesh(i).getVertices())
+    {
+      min_corner = glm::min(min_corner, vertex);
+      max_corner = glm::max(max_corner, vertex);
+    }
+  }
+  if (min_corner.x > max_corner.x)
+    return;
+
+  bounds_center_ = 0.5f * (min_corner + max_corner);
+  bounds_radius_ = 0.f;
+  for (size_t i = 0; i < model_->getMeshCount(); i++)
+    for (const glm::vec3& vertex : model_->getMesh(i).getVertices())
+      bounds_radius_ =
+          std::max(bounds_radius_, glm::length(vertex - bounds_center_));
+}
+
+void IModelDrawer::exportJointTransformations(const std::string& filename)
+{
+  // Rewriting the track that is mapped for replay would pull the pages out
+  // from under the reader.
+  if (joint_track_.isOpen() &&
+      filename == config_->getJointTransformationsFileName())
+  {
+    cerr << "Not exporting joint transformations over the replayed track."
+         << endl;
+    return;
+  }
+
+  if (!joint_track_writer_.isOpen() && !joint_track_writer_.open(
+          filename, joint_transformations_.size()))
+  {
+    cerr << "Could not export joint transformations: "
+         << joint_track_writer_.getError() << endl;
+    return;
+  }
+  if (!joint_track_writer_.append(pose_time_, joint_transformations_))
+    cerr << "Could not export joint transformations: "
+         << joint_track_writer_.getError() << endl;
+}
+
+bool IModelDrawer::finishJointTransformationsExport()
+{
+  if (!joint_track_writer_.isOpen())
+    return joint_track_writer_.getError().empty();
+  size_t frame_cnt = joint_track_writer_.getFrameCount();
+  if (!joint_track_writer_.close())
+  {
+    cerr << "Could not export joint transformations: "
+         << joint_track_writer_.getError() << endl;
+    return false;
+  }
+  cout << "Exported " << frame_cnt << " poses of joint transformations."
+       << endl;
+  return joint_track_writer_.getError().empty();
+}
+
+void IModelDrawer::importJointTransformations(const std::string& filename)
+{
+  cout << "Mapping joint track " << filename << "." << endl;
+  if (!joint_track_.open(filename))
+  {
+    cerr << "Could not open input file for importing joint transformations."
+         << endl;
+    return;
+  }
+
+  if (joint_track_.getJointCount() > joint_transformations_.size())
+  {
+    cerr << "Joint track has " << joint_track_.getJointCount()
+         << " joints, the model only " << joint_transformations_.size()
+         << "." << endl;
+    joint_track_.close();
+    return;
+  }
+
+  cout << "Joint track holds " << joint_track_.getFrameCount()
+       << " frames of " << joint_track_.getJointCount() << " joints."
+       << endl;
+}
+
+const std::vector<glm::mat4>& IModelDrawer::getJointTransformations() const
+{
+  return joint_transformations_;
+}
+
+void IModelDrawer::initPose()
+{
+  joint_transformations_.resize(model_->getJointCount());
+  pose_from_.resize(model_->getJointCount());
+  pose_to_.resize(model_->getJointCount());
+  pose_sample_.resize(model_->getJointCount());
+  calcBounds();
+
+  if (config_->useTransformationsFile())
+    importJointTransformations(config_->getJointTransformationsFileName());
+}
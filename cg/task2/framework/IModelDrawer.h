@@ -13,6 +13,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 #include "Image.h"
+#include "JointTrack.h"
+#include "AnimationQuality.h"
 
 class Model;
 class Shader;
@@ -29,27 +31,101 @@ class IModelDrawer
   virtual void draw() = 0;
   virtual void drawJoints() = 0;
   virtual void drawBones() = 0;
-  virtual void startAction(size_t action) = 0;
-  virtual void update(float time) = 0;
+  virtual void startAction(size_t action);
+  virtual void update(float time);
   virtual Image makeScreenshot() = 0;
-  virtual void exportJointTransformations(const std::string& filename) = 0;
+  // Appends the current pose to the run's track, started on the first call.
+  virtual void exportJointTransformations(const std::string& filename);
+  // Writes the index of the exported track; true if nothing failed.
+  bool finishJointTransformationsExport();
+  void importJointTransformations(const std::string& filename);
+  const std::vector<glm::mat4>& getJointTransformations() const;
   void setConfig(Config* config);
   void setShader(Shader* shader);
+  void setGlyphShader(Shader* shader);
+  void setMeshShader(Shader* shader);
   void setCamera(const Camera* camera);
   void setJointSize(float size);
   void setBoneSize(float size);
   void moveTo(const glm::vec3& position);
   void orientate(const glm::quat& orientation);
+  void setAnimationQuality(const AnimationQuality& quality);
+  // Pose update-rate LOD assumes update() follows the frames at a steady
+  // dt; callers sampling explicit times (screenshots, headless, regression
+  // runs) turn it off to get the exact pose at every time.
+  void setPoseLodEnabled(bool enabled);
+  const AnimationQuality& getAnimationQuality() const;
 
  protected:
   Config* config_;
   Shader* shader_;
+  Shader* glyph_shader_;
+  // Reads the packed mesh stream; 0 streams full float vertices instead.
+  Shader* mesh_shader_;
   const Camera* camera_;
   const Model* model_;
   float joint_size_;
   float bone_size_;
   glm::vec3 translation_;
   glm::quat orientation_;
+
+  // Pose state shared by all backends, evaluated by update().
+  glm::mat4 model_mat_;
+  glm::mat4 normal_mat_;
+  std::vector<glm::mat4> joint_transformations_;
+  bool action_started_;
+  size_t curr_action_;
+  AnimationQuality quality_;
+  // Updates since the action started, to space out pose updates.
+  unsigned update_cnt_;
+
+  // Bind-pose bounding sphere of the whole model.
+  glm::vec3 bounds_center_;
+  float bounds_radius_;
+
+  // Pose update-rate LOD: below POSE_FULL_RATE_SIZE (projected radius over
+  // half the viewport height) every halving doubles the interval between
+  // pose samples, up to 2^MAX_POSE_STEP. In between the pose blends toward
+  // the next sample.
+  const static float POSE_FULL_RATE_SIZE;
+  const static unsigned MAX_POSE_STEP;
+  // Joint transformation split for blending, so rotations stay rigid.
+  struct JointTRS
+  {
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+  };
+  bool pose_lod_enabled_;
+  unsigned pose_interval_;
+  unsigned pose_stagger_;
+  float last_update_time_;
+  bool has_pose_;
+  // Whether pose_from_ and pose_to_ belong to the current interval.
+  bool pose_blend_valid_;
+  std::vector<JointTRS> pose_from_;
+  std::vector<JointTRS> pose_to_;
+  // Scratch pose of the next sample before it is decomposed.
+  std::vector<glm::mat4> pose_sample_;
+
+  // Recorded poses replayed instead of interpolating, see
+  // use_transformations_file.
+  JointTrack joint_track_;
+  // Time of the pose in joint_transformations_, stamped on exported frames.
+  float pose_time_;
+  JointTrackWriter joint_track_writer_;
+
+  // Sizes the pose for the model and maps the replay track if configured.
+  void initPose();
+  void calcBounds();
+  float calcProjectedSize() const;
+  unsigned calcPoseInterval() const;
+  // Evaluates the action, blending or replay track at a time.
+  void samplePose(float time, std::vector<glm::mat4>& pose);
+  // Whether the animation wraps around between two times.
+  bool loopsBetween(float from, float to) const;
+  static void decompose(const std::vector<glm::mat4>& pose,
+      std::vector<JointTRS>& trs);
 };
 
 #endif /* IMODELDRAWER_H_ */
@@ -13,6 +13,8 @@
 #include "Joint.h"
 #include "Keyframe.h"
 #include "Animation.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
 #include <string>
 #include <vector>
 #include <map>
@@ -20,6 +22,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
 
 using std::string;
 using std::vector;
@@ -28,6 +32,8 @@ using std::cerr;
 using std::endl;
 
 const size_t IQMImporter::HEADER_SIZE = 120;
+const size_t IQMImporter::MESH_LOD_LEVELS = 3;
+const size_t IQMImporter::MESH_LOD_MIN_TRIANGLES = 64;
 
 IQMImporter::IQMImporter()
     : file_(0)
@@ -72,6 +78,7 @@ Model* IQMImporter::loadModel(const std::string& path,
   loadTriangles();
   loadJoints();
   loadMeshes();
+  buildMeshLods();
 
   auto reapeat_it = animation_repeat_time.begin();
   auto make_relative_it = make_relative.begin();
@@ -86,6 +93,34 @@ Model* IQMImporter::loadModel(const std::string& path,
   return model_;
 }
 
+std::vector<Animation> IQMImporter::loadAnimations(
+    const std::string& model_path,
+    const std::string& animation_path,
+    float repeat_time,
+    bool make_relative)
+{
+  // Only the skeleton of the model file is read, for the joint order the
+  // clip's channels are mapped to.
+  InFile model_file(model_path, InFile::OpenMode::BINARY);
+  model_file.cache();
+  Model skeleton;
+  file_ = &model_file;
+  model_ = &skeleton;
+  joint_index_map_.clear();
+  loadJoints();
+
+  InFile anim_file(animation_path, InFile::OpenMode::BINARY);
+  anim_file.cache();
+  loadAnimations(anim_file, repeat_time, make_relative);
+  file_ = 0;
+  model_ = 0;
+
+  std::vector<Animation> animations;
+  for (size_t i = 0; i < skeleton.getActionCount(); i++)
+    animations.push_back(skeleton.getAnimation(i));
+  return animations;
+}
+
 void IQMImporter::loadMeshes()
 {
   cout << "Loading meshes from IQM file." << endl;
@@ -145,11 +180,33 @@ void IQMImporter::loadMeshes()
          i++)
       mesh.addTriangle(triangles_[i]);
 
+    cout << "Optimizing the mesh for the vertex cache." << endl;
+    float acmr_before = MeshOptimizer::calcAcmr(mesh.getTriangles(),
+        mesh.getVertexCount(), MeshOptimizer::ACMR_CACHE_SIZE);
+    mesh = MeshOptimizer::optimizeVertexCache(mesh);
+    float acmr_after = MeshOptimizer::calcAcmr(mesh.getTriangles(),
+        mesh.getVertexCount(), MeshOptimizer::ACMR_CACHE_SIZE);
+    cout << "ACMR (FIFO " << MeshOptimizer::ACMR_CACHE_SIZE
+         << "): " << acmr_before << " before, " << acmr_after << " after."
+         << endl;
+
     cout << "Adding the mesh to the model." << endl;
     model_->addMesh(mesh);
   }
 }
 
+void IQMImporter::buildMeshLods()
+{
+  for (size_t mesh_idx = 0; mesh_idx < model_->getMeshCount(); mesh_idx++)
+  {
+    const Mesh& mesh = model_->getMesh(mesh_idx);
+    std::vector<Mesh> lods = MeshSimplifier::buildLodChain(
+        mesh, MESH_LOD_LEVELS, MESH_LOD_MIN_TRIANGLES);
+    for (const Mesh& lod : lods)
+      model_->addMeshLod(mesh_idx, MeshOptimizer::optimizeVertexCache(lod));
+  }
+}
+
 void IQMImporter::loadVertexArrays()
 {
   cout << "Loading vertex arrays from IQM file." << endl;
@@ -194,35 +251,78 @@ void IQMImporter::loadPositionArray(unsigned int vertex_cnt,
 {
   cout << "Loading position vertex array from IQM file." << endl;
 
-  if (format != VertexArrayFormat::IQM_FLOAT)
+  if (!isSupportedVectorFormat(format))
   {
     cerr << "Vertex data in unsupported format." << endl;
     return;
   }
 
   for (unsigned int i = 0; i < vertex_cnt; i++)
-  {
-    std::vector<float> v = file_->getFloatVector(3);
-    glm::vec3 pos = glm::make_vec3(&v[0]);
-    position_array_.push_back(pos);
-  }
+    position_array_.push_back(readVector(format, false));
 }
 
 void IQMImporter::loadNormalArray(unsigned int vertex_cnt, unsigned int format)
 {
   cout << "Loading normal vertex array from IQM file." << endl;
-  if (format != VertexArrayFormat::IQM_FLOAT)
+  if (!isSupportedVectorFormat(format))
   {
     cerr << "Normal data in unsupported format." << endl;
     return;
   }
 
   for (unsigned int i = 0; i < vertex_cnt; i++)
+    normal_array_.push_back(readVector(format, true));
+}
+
+bool IQMImporter::isSupportedVectorFormat(unsigned int format)
+{
+  return format == VertexArrayFormat::IQM_FLOAT ||
+         format == VertexArrayFormat::IQM_HALF ||
+         format == VertexArrayFormat::IQM_BYTE ||
+         format == VertexArrayFormat::IQM_UBYTE ||
+         format == VertexArrayFormat::IQM_SHORT ||
+         format == VertexArrayFormat::IQM_USHORT;
+}
+
+glm::vec3 IQMImporter::readVector(unsigned int format, bool normalized)
+{
+  // Integer components are taken as is, or mapped to [-1, 1] when
+  // normalized, since the only normalized vectors are normals. Unsigned
+  // formats store them biased, c / max * 2 - 1.
+  glm::vec3 v;
+  for (int i = 0; i < 3; i++)
   {
-    std::vector<float> n = file_->getFloatVector(3);
-    glm::vec3 normal = glm::make_vec3(&n[0]);
-    normal_array_.push_back(normal);
+    switch (format)
+    {
+    case VertexArrayFormat::IQM_FLOAT:
+      v[i] = file_->getFloat();
+      break;
+    case VertexArrayFormat::IQM_HALF:
+      v[i] = glm::unpackHalf1x16(file_->getUnsignedShort());
+      break;
+    case VertexArrayFormat::IQM_BYTE:
+      v[i] = static_cast<signed char>(file_->getUnsignedChar());
+      if (normalized)
+        v[i] = std::max(v[i] / 127.f, -1.f);
+      break;
+    case VertexArrayFormat::IQM_UBYTE:
+      v[i] = file_->getUnsignedChar();
+      if (normalized)
+        v[i] = v[i] / 255.f * 2.f - 1.f;
+      break;
+    case VertexArrayFormat::IQM_SHORT:
+      v[i] = static_cast<short>(file_->getUnsignedShort());
+      if (normalized)
+        v[i] = std::max(v[i] / 32767.f, -1.f);
+      break;
+    case VertexArrayFormat::IQM_USHORT:
+      v[i] = file_->getUnsignedShort();
+      if (normalized)
+        v[i] = v[i] / 65535.f * 2.f - 1.f;
+      break;
+    }
   }
+  return v;
 }
 
 void IQMImporter::loadJointIndexArray(unsigned int vertex_cnt,
@@ -367,8 +467,8 @@ void IQMImporter::loadJoints()
       glm::mat4 base_mat = p.getBasePoseMatrix() * j.getBasePoseMatrix();
       j.setBasePoseMatrix(base_mat);
     }
-    model_->addJoint(j);
   }
+  model_->addJoints(joints);
 }
 
 std::vector<Joint> IQMImporter::sortJoints(std::vector<Joint>& joints)
@@ -18,6 +18,7 @@ class InFile;
 class Model;
 class Mesh;
 class Joint;
+class Animation;
 
 class IQMImporter
 {
@@ -27,6 +28,12 @@ public:
 
   Model* loadModel(const std::string& path, const std::vector<std::string>& animation_files, const std::vector<float>& animation_repeat_time, const std::vector<bool>& make_relative);
 
+  // The clips of an animation file, mapped to the joints of the model file.
+  std::vector<Animation> loadAnimations(const std::string& model_path,
+      const std::string& animation_path,
+      float repeat_time,
+      bool make_relative);
+
 private:
   InFile* file_;
   Model* model_;
@@ -80,14 +87,19 @@ private:
   };
 
   const static size_t HEADER_SIZE;
+  const static size_t MESH_LOD_LEVELS;
+  const static size_t MESH_LOD_MIN_TRIANGLES;
 
   void loadVertexArrays();
   void loadTriangles();
   void loadPositionArray(unsigned int vertex_cnt, unsigned int format);
   void loadNormalArray(unsigned int vertex_cnt, unsigned int format);
+  bool isSupportedVectorFormat(unsigned int format);
+  glm::vec3 readVector(unsigned int format, bool normalized);
   void loadJointIndexArray(unsigned int vertex_cnt, unsigned int format);
   void loadJointWeightArray(unsigned int vertex_cnt, unsigned int format);
   void loadMeshes();
+  void buildMeshLods();
   void loadTexts();
   void loadJoints();
   std::vector<Joint> sortJoints(std::vector<Joint>& joints);
@@ -1,13 +1,18 @@
 #include "Image.h"
-#include <lodepng.h>
+#include "PngEncoder.h"
+#include <chrono>
 #include <sstream>
+#include <cstring>
 
 Image::Image()
     : width_(0),
       height_(0),
       format_(Image::Format::RGB),
       component_count_(3),
-      data_()
+      data_(),
+      encoder_profile_(Image::EncoderProfile::FAST),
+      filter_strategy_(Image::FilterStrategy::SUB),
+      encoder_thread_count_(0)
 {
 }
 
@@ -17,7 +22,10 @@ Image::Image(int width, int height, Image::Format format)
       format_(format),
       component_count_(0),
       data_(),
-      error_("")
+      error_(""),
+      encoder_profile_(Image::EncoderProfile::FAST),
+      filter_strategy_(Image::FilterStrategy::SUB),
+      encoder_thread_count_(0)
 {
   switch (format_)
   {
@@ -35,8 +43,12 @@ Image::Image(const Image& instance)
     : width_(instance.width_),
       height_(instance.height_),
       format_(instance.format_),
+      component_count_(instance.component_count_),
       data_(instance.data_),
-      error_("")
+      error_(""),
+      encoder_profile_(instance.encoder_profile_),
+      filter_strategy_(instance.filter_strategy_),
+      encoder_thread_count_(instance.encoder_thread_count_)
 {
 }
 
@@ -67,23 +79,49 @@ unsigned char* Image::getDataPointer()
 
 bool Image::save(std::string file_name)
 {
-  LodePNGColorType ct = LCT_RGB;
-  if (format_ == Image::Format::RGBA)
-    ct = LCT_RGBA;
+  PngEncoder::Settings settings =
+      PngEncoder::getProfileSettings(encoder_profile_);
+  settings.filter = filter_strategy_;
+  settings.thread_count = encoder_thread_count_;
 
-  unsigned error = lodepng::encode(file_name, data_, width_, height_, ct);
+  auto start = std::chrono::steady_clock::now();
+  bool saved = PngEncoder::encode(file_name, &data_[0], width_, height_,
+      component_count_, settings, error_);
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
 
-  if (error)
+  if (!saved)
   {
-    std::stringstream ss;
-    ss << "Encoder error (" << error << "): " << lodepng_error_text(error);
-    error_ = ss.str();
+    error_ = "Encoder error: " + error_;
     return false;
   }
 
+  PngEncoder::recordThroughput(
+      encoder_profile_, data_.size(), seconds.count());
   return true;
 }
 
+void Image::setEncoderProfile(EncoderProfile profile)
+{
+  encoder_profile_ = profile;
+  filter_strategy_ = PngEncoder::getProfileSettings(profile).filter;
+}
+
+void Image::setFilterStrategy(FilterStrategy strategy)
+{
+  filter_strategy_ = strategy;
+}
+
+void Image::setEncoderThreadCount(unsigned thread_count)
+{
+  encoder_thread_count_ = thread_count;
+}
+
+std::string Image::getEncoderStatistics()
+{
+  return PngEncoder::getStatistics();
+}
+
 void Image::flip(bool x, bool y)
 {
   std::vector<unsigned char> data_copy(data_);
@@ -107,3 +145,14 @@ void Image::flip(bool x, bool y)
     }
   }
 }
+
+void Image::copyRows(const unsigned char* data, bool flip_rows)
+{
+  const size_t row_size = width_ * component_count_;
+  for (int row = 0; row < height_; row++)
+  {
+    int source_row = flip_rows ? height_ - row - 1 : row;
+    std::memcpy(&data_[row * row_size], data + source_row * row_size,
+        row_size);
+  }
+}
@@ -26,6 +26,44 @@ public:
     RGBA
   };
 
+  /**
+   * Presets that trade PNG size for encoding speed.
+   */
+  enum class EncoderProfile
+  {
+    /**
+     * No compression, only the PNG framing around the raw rows.
+     */
+    STORE,
+
+    /**
+     * Fastest zlib level with a cheap row filter.
+     */
+    FAST,
+
+    /**
+     * Strongest zlib level with per-row adaptive filtering.
+     */
+    BEST
+  };
+
+  /**
+   * How the PNG row filter is chosen for each scanline.
+   */
+  enum class FilterStrategy
+  {
+    NONE,
+    SUB,
+    UP,
+    AVERAGE,
+    PAETH,
+
+    /**
+     * Picks the filter with the smallest sum of absolute differences per row.
+     */
+    ADAPTIVE
+  };
+
   /**
    * Default constructor of the Image class. 
    */
@@ -83,6 +121,34 @@ public:
    */
   bool save(std::string file_name);
 
+  /**
+   * Sets the profile used by save. Also resets the filter strategy to the
+   * profile's default.
+   * @param profile The encoder profile.
+   * @return void
+   */
+  void setEncoderProfile(EncoderProfile profile);
+
+  /**
+   * Overrides the row filter of the current encoder profile.
+   * @param strategy The filter strategy.
+   * @return void
+   */
+  void setFilterStrategy(FilterStrategy strategy);
+
+  /**
+   * Sets how many threads save may use to filter and deflate the image.
+   * @param thread_count The thread count, 0 uses all hardware threads.
+   * @return void
+   */
+  void setEncoderThreadCount(unsigned thread_count);
+
+  /**
+   * Get the encoding throughput of all saved images so far.
+   * @return std::string One line per used encoder profile with its MB/s.
+   */
+  static std::string getEncoderStatistics();
+
   /**
    * Flips the image data.
    * @param x Flip the image along the x-axis.
@@ -91,6 +157,16 @@ public:
    */
   void flip(bool x, bool y);
 
+  /**
+   * Copies tightly packed pixel rows in the image's format into the image.
+   * Flipping the rows during the copy avoids a separate flip pass over
+   * bottom-up data such as glReadPixels output.
+   * @param data The pixel rows, width * height * components bytes.
+   * @param flip_rows Whether the first source row is the bottom row.
+   * @return void
+   */
+  void copyRows(const unsigned char* data, bool flip_rows);
+
 private:
   /**
    * Width of the image.
@@ -122,6 +198,21 @@ private:
    * Error that may have happened within a method.
    */
   std::string error_;
+
+  /**
+   * The profile used when saving the image.
+   */
+  EncoderProfile encoder_profile_;
+
+  /**
+   * The row filter used when saving the image.
+   */
+  FilterStrategy filter_strategy_;
+
+  /**
+   * Threads that may be used when saving the image, 0 for all.
+   */
+  unsigned encoder_thread_count_;
 };
 
 #endif
@@ -0,0 +1,88 @@
+#include "ImageEncoderPool.h"
+#include "Image.h"
+#include <iostream>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+ImageEncoderPool::ImageEncoderPool(unsigned thread_count, size_t max_queued)
+    : max_queued_(max_queued)
+    , busy_(0)
+    , stopping_(false)
+{
+  if (thread_count == 0)
+  {
+    unsigned hardware_threads = std::thread::hardware_concurrency();
+    thread_count = hardware_threads > 1 ? hardware_threads - 1 : 1;
+  }
+  if (max_queued_ == 0)
+    max_queued_ = 2 * thread_count;
+
+  cout << "Starting " << thread_count << " image encoder threads." << endl;
+  for (unsigned i = 0; i < thread_count; i++)
+    threads_.push_back(std::thread(&ImageEncoderPool::run, this));
+}
+
+ImageEncoderPool::~ImageEncoderPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  job_queued_.notify_all();
+  for (std::thread& thread : threads_)
+    thread.join();
+}
+
+void ImageEncoderPool::submit(Image* image, const std::string& file_name)
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_finished_.wait(lock, [this] { return jobs_.size() < max_queued_; });
+
+  Job job;
+  job.image = image;
+  job.file_name = file_name;
+  jobs_.push_back(job);
+
+  lock.unlock();
+  job_queued_.notify_one();
+}
+
+void ImageEncoderPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_finished_.wait(lock, [this] { return jobs_.empty() && busy_ == 0; });
+}
+
+unsigned ImageEncoderPool::getThreadCount() const
+{
+  return static_cast<unsigned>(threads_.size());
+}
+
+void ImageEncoderPool::run()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true)
+  {
+    job_queued_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+    if (jobs_.empty())
+      return;
+
+    Job job = jobs_.front();
+    jobs_.pop_front();
+    busy_++;
+    // A queue slot just opened up.
+    job_finished_.notify_all();
+    lock.unlock();
+
+    if (!job.image->save(job.file_name))
+      cerr << "Could not save " << job.file_name << ": "
+           << job.image->getError() << endl;
+    delete job.image;
+
+    lock.lock();
+    busy_--;
+    job_finished_.notify_all();
+  }
+}
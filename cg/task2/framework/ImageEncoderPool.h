@@ -0,0 +1,49 @@
+#ifndef IMAGEENCODERPOOL_H
+#define IMAGEENCODERPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Image;
+
+// Saves images on a fixed set of worker threads so the render thread never
+// waits on PNG encoding. The queue is bounded: submit() blocks while it is
+// full, which keeps memory in check when encoding falls behind rendering.
+class ImageEncoderPool
+{
+public:
+  // A thread count of 0 uses one thread less than the hardware provides.
+  ImageEncoderPool(unsigned thread_count = 0, size_t max_queued = 0);
+  ~ImageEncoderPool();
+
+  // Takes ownership of the image, it is deleted once saved.
+  void submit(Image* image, const std::string& file_name);
+  // Blocks until every submitted image has been written.
+  void wait();
+
+  unsigned getThreadCount() const;
+
+private:
+  struct Job
+  {
+    Image* image;
+    std::string file_name;
+  };
+
+  std::vector<std::thread> threads_;
+  std::deque<Job> jobs_;
+  std::mutex mutex_;
+  std::condition_variable job_queued_;
+  std::condition_variable job_finished_;
+  size_t max_queued_;
+  unsigned busy_;
+  bool stopping_;
+
+  void run();
+};
+
+#endif // IMAGEENCODERPOOL_H
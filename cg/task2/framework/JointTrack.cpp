@@ -0,0 +1,442 @@
+#include "JointTrack.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using std::cerr;
+using std::endl;
+
+namespace
+{
+const char MAGIC[4] = {'C', 'G', 'J', 'T'};
+const uint32_t VERSION = 1;
+
+struct TrackHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t joint_count;
+  uint32_t frame_count;
+  uint64_t index_offset;
+};
+
+bool isValidHeader(const TrackHeader& header)
+{
+  return std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 &&
+         header.version == VERSION;
+}
+}
+
+JointTrack::JointTrack()
+    : mapping_(0)
+    , mapping_size_(0)
+#ifdef _WIN32
+    , file_handle_(INVALID_HANDLE_VALUE)
+    , mapping_handle_(0)
+#endif
+    , frames_(0)
+    , index_(0)
+    , joint_count_(0)
+    , frame_count_(0)
+{
+}
+
+JointTrack::~JointTrack()
+{
+  close();
+}
+
+bool JointTrack::open(const std::string& file_name)
+{
+  close();
+
+  if (!map(file_name))
+    return false;
+
+  TrackHeader header;
+  if (mapping_size_ < sizeof(header))
+  {
+    unmap();
+    return readLegacy(file_name);
+  }
+  std::memcpy(&header, mapping_, sizeof(header));
+  if (!isValidHeader(header))
+  {
+    unmap();
+    return readLegacy(file_name);
+  }
+
+  size_t frames_size =
+      sizeof(glm::mat4) * header.joint_count * header.frame_count;
+  size_t index_size = sizeof(IndexEntry) * header.frame_count;
+  if (sizeof(header) + frames_size > header.index_offset ||
+      header.index_offset + index_size > mapping_size_)
+  {
+    cerr << "Joint track " << file_name << " is truncated." << endl;
+    unmap();
+    return false;
+  }
+
+  joint_count_ = header.joint_count;
+  frame_count_ = header.frame_count;
+  frames_ = reinterpret_cast<const glm::mat4*>(mapping_ + sizeof(header));
+  index_ = reinterpret_cast<const IndexEntry*>(mapping_ + header.index_offset);
+  return true;
+}
+
+void JointTrack::close()
+{
+  unmap();
+  legacy_frames_.clear();
+  legacy_index_.clear();
+  frames_ = 0;
+  index_ = 0;
+  joint_count_ = 0;
+  frame_count_ = 0;
+}
+
+bool JointTrack::isOpen() const
+{
+  return frames_ != 0;
+}
+
+size_t JointTrack::getJointCount() const
+{
+  return joint_count_;
+}
+
+size_t JointTrack::getFrameCount() const
+{
+  return frame_count_;
+}
+
+bool JointTrack::isLegacy() const
+{
+  return !legacy_frames_.empty();
+}
+
+const glm::mat4* JointTrack::sample(float time) const
+{
+  if (frame_count_ == 0)
+    return 0;
+
+  const IndexEntry* end = index_ + frame_count_;
+  const IndexEntry* entry = std::upper_bound(index_, end, time,
+      [](float t, const IndexEntry& e) { return t < e.time; });
+  if (entry != index_)
+    entry--;
+  return frames_ + static_cast<size_t>(entry->frame) * joint_count_;
+}
+
+JointTrackWriter::JointTrackWriter()
+    : joint_count_(0)
+    , index_offset_(0)
+{
+}
+
+JointTrackWriter::~JointTrackWriter()
+{
+  close();
+}
+
+bool JointTrackWriter::open(const std::string& file_name,
+    size_t joint_count,
+    bool append)
+{
+  close();
+  file_name_ = file_name;
+  joint_count_ = joint_count;
+  index_.clear();
+  error_.clear();
+
+  if (append)
+  {
+    file_.open(file_name.c_str(), std::ios::in | std::ios::out |
+        std::ios::binary);
+    if (file_.is_open())
+    {
+      TrackHeader header;
+      if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+          !isValidHeader(header))
+      {
+        error_ = file_name + " is not a joint track.";
+        file_.close();
+        return false;
+      }
+      if (header.joint_count != joint_count)
+      {
+        std::stringstream ss;
+        ss << file_name << " holds poses of " << header.joint_count
+           << " joints, not " << joint_count << ".";
+        error_ = ss.str();
+        file_.close();
+        return false;
+      }
+
+      // New frames overwrite the old index, which is kept in memory.
+      index_.resize(header.frame_count);
+      file_.seekg(header.index_offset);
+      if (!index_.empty())
+        file_.read(reinterpret_cast<char*>(&index_[0]),
+            index_.size() * sizeof(JointTrack::IndexEntry));
+      if (!file_)
+      {
+        error_ = "Could not read the index of " + file_name + ".";
+        file_.close();
+        return false;
+      }
+      index_offset_ = header.index_offset;
+      return true;
+    }
+    file_.clear();
+  }
+
+  file_.open(file_name.c_str(), std::ios::in | std::ios::out |
+      std::ios::binary | std::ios::trunc);
+  if (!file_.is_open())
+  {
+    error_ = "Could not open " + file_name + " for writing.";
+    return false;
+  }
+
+  // An empty track until close() writes the real header.
+  TrackHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.joint_count = static_cast<uint32_t>(joint_count);
+  header.frame_count = 0;
+  header.index_offset = sizeof(header);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  index_offset_ = sizeof(header);
+  if (!file_)
+  {
+    error_ = "Could not write " + file_name + ".";
+    file_.close();
+    return false;
+  }
+  return true;
+}
+
+bool JointTrackWriter::append(float time,
+    const std::vector<glm::mat4>& joint_transformations)
+{
+  if (!file_.is_open())
+  {
+    error_ = "No joint track is open.";
+    return false;
+  }
+  if (joint_transformations.size() != joint_count_)
+  {
+    std::stringstream ss;
+    ss << "Pose of " << joint_transformations.size() << " joints for "
+       << file_name_ << ", a track of " << joint_count_ << ".";
+    error_ = ss.str();
+    return false;
+  }
+
+  file_.seekp(index_offset_);
+  if (joint_count_)
+    file_.write(reinterpret_cast<const char*>(&joint_transformations[0]),
+        joint_count_ * sizeof(glm::mat4));
+  if (!file_)
+  {
+    error_ = "Could not write " + file_name_ + ".";
+    return false;
+  }
+
+  JointTrack::IndexEntry entry;
+  entry.time = time;
+  entry.frame = static_cast<unsigned>(index_.size());
+  index_.push_back(entry);
+  index_offset_ += joint_count_ * sizeof(glm::mat4);
+  return true;
+}
+
+bool JointTrackWriter::close()
+{
+  if (!file_.is_open())
+    return error_.empty();
+
+  // Frames of equal time keep their order.
+  std::stable_sort(index_.begin(), index_.end(),
+      [](const JointTrack::IndexEntry& a, const JointTrack::IndexEntry& b)
+      { return a.time < b.time; });
+  file_.seekp(index_offset_);
+  if (!index_.empty())
+    file_.write(reinterpret_cast<const char*>(&index_[0]),
+        index_.size() * sizeof(JointTrack::IndexEntry));
+
+  TrackHeader header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.joint_count = static_cast<uint32_t>(joint_count_);
+  header.frame_count = static_cast<uint32_t>(index_.size());
+  header.index_offset = index_offset_;
+  file_.seekp(0);
+  file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  bool written = static_cast<bool>(file_);
+  file_.close();
+  if (!written)
+  {
+    error_ = "Could not write " + file_name_ + ".";
+    return false;
+  }
+  return true;
+}
+
+bool JointTrackWriter::isOpen() const
+{
+  return file_.is_open();
+}
+
+size_t JointTrackWriter::getFrameCount() const
+{
+  return index_.size();
+}
+
+const std::string& JointTrackWriter::getError() const
+{
+  return error_;
+}
+
+#ifdef _WIN32
+bool JointTrack::map(const std::string& file_name)
+{
+  file_handle_ = CreateFileA(file_name.c_str(), GENERIC_READ,
+      FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+  if (file_handle_ == INVALID_HANDLE_VALUE)
+  {
+    cerr << "Could not open joint track " << file_name << "." << endl;
+    return false;
+  }
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_handle_, &size);
+  mapping_size_ = static_cast<size_t>(size.QuadPart);
+  if (mapping_size_ == 0)
+    return true;
+
+  mapping_handle_ =
+      CreateFileMappingA(file_handle_, 0, PAGE_READONLY, 0, 0, 0);
+  if (mapping_handle_)
+    mapping_ = static_cast<const unsigned char*>(
+        MapViewOfFile(mapping_handle_, FILE_MAP_READ, 0, 0, 0));
+  if (!mapping_)
+  {
+    cerr << "Could not map joint track " << file_name << "." << endl;
+    unmap();
+    return false;
+  }
+  return true;
+}
+
+void JointTrack::unmap()
+{
+  if (mapping_)
+    UnmapViewOfFile(mapping_);
+  if (mapping_handle_)
+    CloseHandle(mapping_handle_);
+  if (file_handle_ != INVALID_HANDLE_VALUE)
+    CloseHandle(file_handle_);
+  mapping_ = 0;
+  mapping_handle_ = 0;
+  file_handle_ = INVALID_HANDLE_VALUE;
+  mapping_size_ = 0;
+}
+#else
+bool JointTrack::map(const std::string& file_name)
+{
+  int fd = ::open(file_name.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    cerr << "Could not open joint track " << file_name << "." << endl;
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  mapping_size_ = static_cast<size_t>(info.st_size);
+  if (mapping_size_ == 0)
+  {
+    ::close(fd);
+    return true;
+  }
+
+  // The mapping stays valid after the descriptor is closed.
+  void* mapping = mmap(0, mapping_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED)
+  {
+    cerr << "Could not map joint track " << file_name << "." << endl;
+    mapping_size_ = 0;
+    return false;
+  }
+  mapping_ = static_cast<const unsigned char*>(mapping);
+  return true;
+}
+
+void JointTrack::unmap()
+{
+  if (mapping_)
+    munmap(const_cast<unsigned char*>(mapping_), mapping_size_);
+  mapping_ = 0;
+  mapping_size_ = 0;
+}
+#endif
+
+bool JointTrack::readLegacy(const std::string& file_name)
+{
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+  {
+    cerr << "Could not open joint track " << file_name << "." << endl;
+    return false;
+  }
+
+  int joint_id;
+  glm::mat4 transformation;
+  while (file.read(reinterpret_cast<char*>(&joint_id), sizeof(joint_id)) &&
+         file.read(reinterpret_cast<char*>(&transformation),
+             sizeof(transformation)))
+  {
+    if (joint_id < 0)
+      continue;
+    if (static_cast<size_t>(joint_id) >= legacy_frames_.size())
+      legacy_frames_.resize(joint_id + 1, glm::mat4(1.f));
+    legacy_frames_[joint_id] = transformation;
+  }
+
+  if (legacy_frames_.empty())
+  {
+    cerr << "Joint track " << file_name << " is empty." << endl;
+    return false;
+  }
+
+  IndexEntry entry;
+  entry.time = 0.f;
+  entry.frame = 0;
+  legacy_index_.push_back(entry);
+
+  joint_count_ = legacy_frames_.size();
+  frame_count_ = 1;
+  frames_ = &legacy_frames_[0];
+  index_ = &legacy_index_[0];
+  return true;
+}
@@ -0,0 +1,107 @@
+#ifndef JOINTTRACK_H
+#define JOINTTRACK_H
+
+#include <fstream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+// Recorded joint transformations for many frames in one file:
+//
+//   header   magic "CGJT", version, joint count, frame count, index offset
+//   frames   frame count * joint count contiguous mat4s, in append order
+//   index    frame count (time, frame) pairs sorted by time
+//
+// JointTrackWriter appends the frames of a run sequentially and writes the
+// index and header once when closed. Reading maps the file once; sampling is
+// a binary search over the index and returns a pointer into the mapping.
+// Single-pose files of the old (joint id, mat4) format are still read, as a
+// track with one frame.
+class JointTrack
+{
+public:
+  JointTrack();
+  ~JointTrack();
+
+  bool open(const std::string& file_name);
+  void close();
+  bool isOpen() const;
+
+  size_t getJointCount() const;
+  size_t getFrameCount() const;
+  // Read from the single-pose format, which records no time.
+  bool isLegacy() const;
+  // The pose of the last frame recorded at or before time, or the first
+  // frame for earlier times. Null if the track is empty.
+  const glm::mat4* sample(float time) const;
+
+private:
+  friend class JointTrackWriter;
+
+  struct IndexEntry
+  {
+    float time;
+    unsigned frame;
+  };
+
+  const unsigned char* mapping_;
+  size_t mapping_size_;
+#ifdef _WIN32
+  void* file_handle_;
+  void* mapping_handle_;
+#endif
+
+  const glm::mat4* frames_;
+  const IndexEntry* index_;
+  size_t joint_count_;
+  size_t frame_count_;
+
+  // Backing store for tracks that are not mapped (legacy files).
+  std::vector<glm::mat4> legacy_frames_;
+  std::vector<IndexEntry> legacy_index_;
+
+  bool map(const std::string& file_name);
+  void unmap();
+  bool readLegacy(const std::string& file_name);
+
+  JointTrack(const JointTrack&);
+  JointTrack& operator=(const JointTrack&);
+};
+
+// Records a JointTrack frame by frame. Frames may come in any time order;
+// the index is kept in memory and sorted when the track is closed, so a
+// run writes every frame once and the index once. A new track reads as
+// empty until then.
+class JointTrackWriter
+{
+public:
+  JointTrackWriter();
+  ~JointTrackWriter();
+
+  // Starts a track for poses of joint_count joints. A new track replaces
+  // the file; with append the frames go behind those of an existing track,
+  // which has to be a track of as many joints.
+  bool open(const std::string& file_name, size_t joint_count,
+      bool append = false);
+  bool append(float time, const std::vector<glm::mat4>& joint_transformations);
+  // Writes the index and header.
+  bool close();
+  bool isOpen() const;
+
+  size_t getFrameCount() const;
+  const std::string& getError() const;
+
+private:
+  std::string file_name_;
+  std::fstream file_;
+  size_t joint_count_;
+  uint64_t index_offset_;
+  std::vector<JointTrack::IndexEntry> index_;
+  std::string error_;
+
+  JointTrackWriter(const JointTrackWriter&);
+  JointTrackWriter& operator=(const JointTrackWriter&);
+};
+
+#endif // JOINTTRACK_H
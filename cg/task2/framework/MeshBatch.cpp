@@ -0,0 +1,161 @@
+#include "MeshBatch.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+MeshBatch::MeshBatch()
+    : vertex_pool_(0)
+    , index_pool_(0)
+    , vertex_cnt_(0)
+    , vertex_stride_(0)
+{
+}
+
+MeshBatch::~MeshBatch()
+{
+  delete vertex_pool_;
+  delete index_pool_;
+}
+
+size_t MeshBatch::addMesh(const Mesh& mesh)
+{
+  Range range;
+  range.first_vertex = vertex_cnt_;
+  range.vertex_cnt = mesh.getVertexCount();
+  range.first_index = indices_.size() * 3;
+  range.index_cnt = mesh.getTriangleCount() * 3;
+  ranges_.push_back(range);
+
+  glm::ivec3 bias(static_cast<int>(range.first_vertex));
+  for (const glm::ivec3& triangle : mesh.getTriangles())
+    indices_.push_back(triangle + bias);
+  vertex_cnt_ += range.vertex_cnt;
+  return ranges_.size() - 1;
+}
+
+void MeshBatch::create(size_t vertex_stride)
+{
+  // One slot holds the vertex streams of all meshes for a single frame.
+  vertex_stride_ = vertex_stride;
+  size_t slot_byte_cnt = std::max<size_t>(vertex_cnt_, 1) * vertex_stride;
+  cout << "Packing " << ranges_.size() << " meshes into one pool ("
+       << vertex_cnt_ << " vertices, " << indices_.size() * 3
+       << " indices, " << slot_byte_cnt << " vertex bytes per frame)."
+       << endl;
+  vertex_pool_ = new GLBuffer(GLBuffer::BufferType::VERTEX_BUFFER);
+  vertex_pool_->create();
+  vertex_pool_->bind();
+  vertex_pool_->allocateRing(slot_byte_cnt);
+  vertex_pool_->unbind();
+
+  index_pool_ = new GLBuffer(GLBuffer::BufferType::INDEX_BUFFER);
+  index_pool_->create();
+  index_pool_->bind();
+  index_pool_->allocate(
+      indices_.size() * sizeof(glm::ivec3), GLBuffer::Usage::STATIC_DRAW);
+  index_pool_->write(indices_);
+  index_pool_->unbind();
+  std::vector<glm::ivec3>().swap(indices_);
+
+  draws_.reserve(ranges_.size());
+  counts_.reserve(ranges_.size());
+  offsets_.reserve(ranges_.size());
+}
+
+GLBuffer* MeshBatch::getVertexPool()
+{
+  return vertex_pool_;
+}
+
+GLBuffer* MeshBatch::getIndexPool()
+{
+  return index_pool_;
+}
+
+size_t MeshBatch::getRangeCount() const
+{
+  return ranges_.size();
+}
+
+void* MeshBatch::beginWrite()
+{
+  vertex_pool_->bind();
+  return vertex_pool_->beginRingWrite();
+}
+
+size_t MeshBatch::getFirstVertex(size_t range) const
+{
+  return ranges_[range].first_vertex;
+}
+
+size_t MeshBatch::endWrite()
+{
+  // Culled meshes and the LODs not drawn keep stale vertices in the slot.
+  for (const Draw& draw : draws_)
+  {
+    const Range& range = ranges_[draw.range];
+    vertex_pool_->markRingWritten(range.first_vertex * vertex_stride_,
+        range.vertex_cnt * vertex_stride_);
+  }
+  return vertex_pool_->endRingWrite();
+}
+
+void MeshBatch::clearDraws()
+{
+  draws_.clear();
+}
+
+void MeshBatch::queueDraw(size_t range, size_t material)
+{
+  Draw draw;
+  draw.material = material;
+  draw.range = range;
+  draws_.push_back(draw);
+}
+
+size_t MeshBatch::getDrawCount() const
+{
+  return draws_.size();
+}
+
+void MeshBatch::submit(Shader* program,
+    const Shader::Uniform& diffuse_uniform,
+    const std::vector<Material>& materials)
+{
+  PROFILE_ZONE("MeshBatch::submit");
+
+  // Ranges of one material stay in pool order for locality.
+  std::sort(draws_.begin(), draws_.end());
+  size_t begin = 0;
+  while (begin < draws_.size())
+  {
+    size_t material = draws_[begin].material;
+    counts_.clear();
+    offsets_.clear();
+    size_t end = begin;
+    for (; end < draws_.size() && draws_[end].material == material; end++)
+    {
+      const Range& range = ranges_[draws_[end].range];
+      counts_.push_back(static_cast<GLsizei>(range.index_cnt));
+      offsets_.push_back(reinterpret_cast<const GLvoid*>(
+          range.first_index * sizeof(GLuint)));
+    }
+
+    program->setUniform3f(diffuse_uniform, materials[material].getDiffuse());
+    glMultiDrawElements(GL_TRIANGLES, &counts_[0], GL_UNSIGNED_INT,
+        &offsets_[0], static_cast<GLsizei>(counts_.size()));
+    GLState::countCall();
+    begin = end;
+  }
+}
+
+bool MeshBatch::Draw::operator<(const Draw& other) const
+{
+  if (material != other.material)
+    return material < other.material;
+  return range < other.range;
+}
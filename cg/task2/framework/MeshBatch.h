@@ -0,0 +1,80 @@
+#ifndef MESHBATCH_H
+#define MESHBATCH_H
+
+#include <vector>
+#include <GL/gl3w.h>
+#include "GLBuffer.h"
+#include "Material.h"
+#include "Mesh.h"
+#include "Shader.h"
+
+// Packs many meshes into one vertex pool, streamed through a ring buffer
+// once per frame, and one static index pool. Draws queued during a frame are
+// sorted by material and each material goes out as a single
+// glMultiDrawElements. Indices are biased by the mesh's place in the pool
+// when it is built, so no base-vertex draws are needed and the batch works
+// on plain GL 2.1.
+//
+// Everything in a batch shares one program state (model matrix, vertex
+// format), so a batch holds the meshes of one model and its LODs.
+class MeshBatch
+{
+public:
+  MeshBatch();
+  ~MeshBatch();
+
+  // Reserves a range for the mesh; returns its index. All meshes are added
+  // before create().
+  size_t addMesh(const Mesh& mesh);
+  // Allocates the pools for vertex_stride bytes per vertex.
+  void create(size_t vertex_stride);
+
+  GLBuffer* getVertexPool();
+  GLBuffer* getIndexPool();
+  size_t getRangeCount() const;
+
+  // The frame's vertex stream: beginWrite maps the ring slot, a range's
+  // vertices start getFirstVertex(range) strides into it. endWrite uploads
+  // only the ranges queued for drawing since clearDraws().
+  void* beginWrite();
+  size_t getFirstVertex(size_t range) const;
+  size_t endWrite();
+
+  void clearDraws();
+  void queueDraw(size_t range, size_t material);
+  size_t getDrawCount() const;
+  // Binds nothing; the vertex layout and index pool must be bound.
+  void submit(Shader* program,
+      const Shader::Uniform& diffuse_uniform,
+      const std::vector<Material>& materials);
+
+private:
+  struct Range
+  {
+    size_t first_vertex;
+    size_t vertex_cnt;
+    size_t first_index;
+    size_t index_cnt;
+  };
+
+  struct Draw
+  {
+    size_t material;
+    size_t range;
+
+    bool operator<(const Draw& other) const;
+  };
+
+  GLBuffer* vertex_pool_;
+  GLBuffer* index_pool_;
+  std::vector<Range> ranges_;
+  // Biased triangles of all meshes until create() uploads them.
+  std::vector<glm::ivec3> indices_;
+  size_t vertex_cnt_;
+  size_t vertex_stride_;
+  std::vector<Draw> draws_;
+  std::vector<GLsizei> counts_;
+  std::vector<const GLvoid*> offsets_;
+};
+
+#endif // MESHBATCH_H
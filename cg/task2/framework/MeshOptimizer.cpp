@@ -0,0 +1,230 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Tuning constants from Forsyth's "Linear-Speed Vertex Cache Optimisation".
+const int CACHE_SIZE = 32;
+const float CACHE_DECAY_POWER = 1.5f;
+const float LAST_TRIANGLE_SCORE = 0.75f;
+const float VALENCE_BOOST_SCALE = 2.0f;
+const float VALENCE_BOOST_POWER = 0.5f;
+
+float vertexScore(int cache_position, unsigned remaining_triangles)
+{
+  if (remaining_triangles == 0)
+    return -1.f;
+
+  float score = 0.f;
+  if (cache_position >= 0)
+  {
+    // The three vertices of the last triangle score the same, so the next
+    // triangle does not depend on the order they were emitted in.
+    if (cache_position < 3)
+      score = LAST_TRIANGLE_SCORE;
+    else
+      score = std::pow(1.f - static_cast<float>(cache_position - 3) /
+                                 (CACHE_SIZE - 3),
+          CACHE_DECAY_POWER);
+  }
+  // Favour vertices with few triangles left so they leave the cache early.
+  score += VALENCE_BOOST_SCALE *
+           std::pow(static_cast<float>(remaining_triangles),
+               -VALENCE_BOOST_POWER);
+  return score;
+}
+
+std::vector<glm::ivec3> optimizeTriangleOrder(
+    const std::vector<glm::ivec3>& triangles,
+    size_t vertex_cnt)
+{
+  // Vertex to triangle adjacency; the first remaining[v] entries of a
+  // vertex are the triangles it still has to emit.
+  std::vector<unsigned> offsets(vertex_cnt + 1, 0);
+  for (const glm::ivec3& triangle : triangles)
+    for (int corner = 0; corner < 3; corner++)
+      offsets[triangle[corner] + 1]++;
+  for (size_t v_idx = 1; v_idx <= vertex_cnt; v_idx++)
+    offsets[v_idx] += offsets[v_idx - 1];
+  std::vector<unsigned> remaining(vertex_cnt, 0);
+  std::vector<unsigned> adjacency(offsets.back());
+  for (size_t t_idx = 0; t_idx < triangles.size(); t_idx++)
+  {
+    for (int corner = 0; corner < 3; corner++)
+    {
+      int v = triangles[t_idx][corner];
+      adjacency[offsets[v] + remaining[v]++] = static_cast<unsigned>(t_idx);
+    }
+  }
+
+  std::vector<int> cache_positions(vertex_cnt, -1);
+  std::vector<float> vertex_scores(vertex_cnt);
+  for (size_t v_idx = 0; v_idx < vertex_cnt; v_idx++)
+    vertex_scores[v_idx] = vertexScore(-1, remaining[v_idx]);
+
+  std::vector<float> triangle_scores(triangles.size());
+  std::vector<bool> emitted(triangles.size(), false);
+  for (size_t t_idx = 0; t_idx < triangles.size(); t_idx++)
+  {
+    const glm::ivec3& t = triangles[t_idx];
+    triangle_scores[t_idx] =
+        vertex_scores[t[0]] + vertex_scores[t[1]] + vertex_scores[t[2]];
+  }
+
+  std::vector<glm::ivec3> result;
+  result.reserve(triangles.size());
+  // LRU cache, three slots larger so a new triangle can push in before the
+  // oldest entries fall out.
+  std::vector<int> cache;
+  std::vector<int> new_cache;
+  cache.reserve(CACHE_SIZE + 3);
+  new_cache.reserve(CACHE_SIZE + 3);
+  size_t scan_cursor = 0;
+  int best = -1;
+
+  while (result.size() < triangles.size())
+  {
+    if (best < 0)
+    {
+      // Nothing in the cache has triangles left, restart at the best
+      // triangle that has not been emitted yet.
+      float best_score = -1.f;
+      while (scan_cursor < triangles.size() && emitted[scan_cursor])
+        scan_cursor++;
+      for (size_t t_idx = scan_cursor; t_idx < triangles.size(); t_idx++)
+      {
+        if (!emitted[t_idx] && triangle_scores[t_idx] > best_score)
+        {
+          best_score = triangle_scores[t_idx];
+          best = static_cast<int>(t_idx);
+        }
+      }
+    }
+
+    const glm::ivec3& triangle = triangles[best];
+    emitted[best] = true;
+    result.push_back(triangle);
+
+    new_cache.clear();
+    for (int corner = 0; corner < 3; corner++)
+    {
+      int v = triangle[corner];
+      new_cache.push_back(v);
+      // Drop the emitted triangle from the vertex's remaining list.
+      unsigned* begin = &adjacency[offsets[v]];
+      unsigned* end = begin + remaining[v];
+      std::swap(*std::find(begin, end, static_cast<unsigned>(best)), end[-1]);
+      remaining[v]--;
+    }
+    for (int v : cache)
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+        new_cache.push_back(v);
+    for (size_t i = CACHE_SIZE; i < new_cache.size(); i++)
+    {
+      cache_positions[new_cache[i]] = -1;
+      vertex_scores[new_cache[i]] = vertexScore(-1, remaining[new_cache[i]]);
+    }
+    if (new_cache.size() > static_cast<size_t>(CACHE_SIZE))
+      new_cache.resize(CACHE_SIZE);
+    cache.swap(new_cache);
+
+    for (size_t i = 0; i < cache.size(); i++)
+    {
+      cache_positions[cache[i]] = static_cast<int>(i);
+      vertex_scores[cache[i]] =
+          vertexScore(static_cast<int>(i), remaining[cache[i]]);
+    }
+
+    // Only triangles touching the cache changed score.
+    best = -1;
+    float best_score = -1.f;
+    for (int v : cache)
+    {
+      for (unsigned i = 0; i < remaining[v]; i++)
+      {
+        unsigned t_idx = adjacency[offsets[v] + i];
+        const glm::ivec3& t = triangles[t_idx];
+        float score =
+            vertex_scores[t[0]] + vertex_scores[t[1]] + vertex_scores[t[2]];
+        triangle_scores[t_idx] = score;
+        if (score > best_score)
+        {
+          best_score = score;
+          best = static_cast<int>(t_idx);
+        }
+      }
+    }
+  }
+  return result;
+}
+}
+
+const size_t MeshOptimizer::ACMR_CACHE_SIZE = 16;
+
+Mesh MeshOptimizer::optimizeVertexCache(const Mesh& mesh)
+{
+  std::vector<glm::ivec3> triangles =
+      optimizeTriangleOrder(mesh.getTriangles(), mesh.getVertexCount());
+
+  // Renumber in first-use order; unreferenced vertices keep their relative
+  // order at the end.
+  const int UNUSED = -1;
+  std::vector<int> remap(mesh.getVertexCount(), UNUSED);
+  std::vector<size_t> order;
+  order.reserve(mesh.getVertexCount());
+  for (glm::ivec3& triangle : triangles)
+  {
+    for (int corner = 0; corner < 3; corner++)
+    {
+      int& v = triangle[corner];
+      if (remap[v] == UNUSED)
+      {
+        remap[v] = static_cast<int>(order.size());
+        order.push_back(v);
+      }
+      v = remap[v];
+    }
+  }
+  for (size_t v_idx = 0; v_idx < remap.size(); v_idx++)
+    if (remap[v_idx] == UNUSED)
+      order.push_back(v_idx);
+
+  Mesh result;
+  result.setMaterial(mesh.getMaterial());
+  result.allocateSpace(order.size());
+  bool has_normals = mesh.getNormalCount() == mesh.getVertexCount();
+  for (size_t i = 0; i < order.size(); i++)
+  {
+    result.addVertex(mesh.getVertex(order[i]));
+    if (has_normals)
+      result.addNormal(mesh.getNormal(order[i]));
+    result.addJoints(i, mesh.getJoints(order[i]));
+    result.addWeights(i, mesh.getWeights(order[i]));
+  }
+  result.addTriangles(triangles);
+  return result;
+}
+
+float MeshOptimizer::calcAcmr(const std::vector<glm::ivec3>& triangles,
+    size_t vertex_count,
+    size_t cache_size)
+{
+  if (triangles.empty())
+    return 0.f;
+
+  // FIFO cache: a vertex is a hit while fewer than cache_size misses
+  // happened since it was loaded.
+  std::vector<size_t> loaded_at(vertex_count, 0);
+  size_t misses = 0;
+  for (const glm::ivec3& triangle : triangles)
+  {
+    for (int corner = 0; corner < 3; corner++)
+    {
+      size_t& stamp = loaded_at[triangle[corner]];
+      if (stamp == 0 || misses - stamp >= cache_size)
+        stamp = ++misses;
+    }
+  }
+  return static_cast<float>(misses) / triangles.size();
+}
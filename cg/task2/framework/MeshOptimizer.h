@@ -0,0 +1,32 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Mesh.h"
+
+// Import-time reordering for locality. Triangles are sorted for the
+// post-transform vertex cache with Tom Forsyth's linear-speed algorithm,
+// then vertices are renumbered in the order the triangles first use them,
+// so skinning, the normal pass and vertex fetch walk memory front to back.
+class MeshOptimizer
+{
+public:
+  // FIFO size used to report the average cache miss ratio.
+  const static size_t ACMR_CACHE_SIZE;
+
+  // Returns the mesh with reordered triangles and vertices; positions,
+  // normals, joints and weights move together.
+  static Mesh optimizeVertexCache(const Mesh& mesh);
+
+  // Transformed vertices per triangle for a FIFO cache of cache_size
+  // entries; 0.5 is the ideal for large regular meshes, 3 the worst case.
+  static float calcAcmr(const std::vector<glm::ivec3>& triangles,
+      size_t vertex_count,
+      size_t cache_size);
+
+private:
+  MeshOptimizer();
+};
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,336 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+// Weight of the planes that pin open borders, relative to face planes.
+const double BORDER_WEIGHT = 10.0;
+// Collapses that turn a face by more than ~78 degrees are rejected.
+const double MIN_NORMAL_DOT = 0.2;
+
+// Symmetric 4x4 error quadric, upper triangle.
+struct Quadric
+{
+  double a[10];
+
+  Quadric()
+  {
+    std::fill(a, a + 10, 0.0);
+  }
+
+  void addPlane(const glm::dvec3& n, double d, double weight)
+  {
+    a[0] += weight * n.x * n.x;
+    a[1] += weight * n.x * n.y;
+    a[2] += weight * n.x * n.z;
+    a[3] += weight * n.x * d;
+    a[4] += weight * n.y * n.y;
+    a[5] += weight * n.y * n.z;
+    a[6] += weight * n.y * d;
+    a[7] += weight * n.z * n.z;
+    a[8] += weight * n.z * d;
+    a[9] += weight * d * d;
+  }
+
+  Quadric& operator+=(const Quadric& other)
+  {
+    for (int i = 0; i < 10; i++)
+      a[i] += other.a[i];
+    return *this;
+  }
+
+  double error(const glm::dvec3& p) const
+  {
+    return a[0] * p.x * p.x + 2.0 * a[1] * p.x * p.y +
+           2.0 * a[2] * p.x * p.z + 2.0 * a[3] * p.x + a[4] * p.y * p.y +
+           2.0 * a[5] * p.y * p.z + 2.0 * a[6] * p.y + a[7] * p.z * p.z +
+           2.0 * a[8] * p.z + a[9];
+  }
+};
+
+struct Collapse
+{
+  double cost;
+  unsigned from;
+  unsigned to;
+  unsigned from_version;
+  unsigned to_version;
+
+  bool operator>(const Collapse& other) const
+  {
+    return cost > other.cost;
+  }
+};
+
+unsigned long long edgeKey(unsigned a, unsigned b)
+{
+  if (a > b)
+    std::swap(a, b);
+  return (static_cast<unsigned long long>(a) << 32) | b;
+}
+
+glm::dvec3 faceNormal(const glm::dvec3& p0,
+    const glm::dvec3& p1,
+    const glm::dvec3& p2)
+{
+  return glm::cross(p1 - p0, p2 - p0);
+}
+}
+
+Mesh MeshSimplifier::simplify(const Mesh& mesh, size_t target_triangle_count)
+{
+  // Weld vertices at identical positions; representatives keep the first
+  // original vertex, whose skinning data the result inherits.
+  const std::vector<glm::vec3>& vertices = mesh.getVertices();
+  std::vector<unsigned> welded(vertices.size());
+  std::vector<unsigned> representatives;
+  std::map<std::tuple<float, float, float>, unsigned> position_index;
+  for (size_t v_idx = 0; v_idx < vertices.size(); v_idx++)
+  {
+    const glm::vec3& v = vertices[v_idx];
+    auto inserted = position_index.insert(std::make_pair(
+        std::make_tuple(v.x, v.y, v.z),
+        static_cast<unsigned>(representatives.size())));
+    if (inserted.second)
+      representatives.push_back(static_cast<unsigned>(v_idx));
+    welded[v_idx] = inserted.first->second;
+  }
+
+  const size_t vertex_cnt = representatives.size();
+  std::vector<glm::dvec3> positions(vertex_cnt);
+  for (size_t i = 0; i < vertex_cnt; i++)
+    positions[i] = glm::dvec3(vertices[representatives[i]]);
+
+  std::vector<glm::uvec3> triangles;
+  triangles.reserve(mesh.getTriangleCount());
+  for (const glm::ivec3& triangle : mesh.getTriangles())
+  {
+    glm::uvec3 t(welded[triangle[0]], welded[triangle[1]], welded[triangle[2]]);
+    if (t[0] != t[1] && t[1] != t[2] && t[2] != t[0])
+      triangles.push_back(t);
+  }
+
+  // Face planes, area weighted, and border planes perpendicular to the face
+  // along every edge that only one face uses.
+  std::vector<Quadric> quadrics(vertex_cnt);
+  std::unordered_map<unsigned long long, unsigned> edge_use;
+  for (const glm::uvec3& t : triangles)
+  {
+    glm::dvec3 normal =
+        faceNormal(positions[t[0]], positions[t[1]], positions[t[2]]);
+    double length = glm::length(normal);
+    if (length > 0.0)
+    {
+      normal /= length;
+      double d = -glm::dot(normal, positions[t[0]]);
+      for (int corner = 0; corner < 3; corner++)
+        quadrics[t[corner]].addPlane(normal, d, 0.5 * length);
+    }
+    for (int corner = 0; corner < 3; corner++)
+      edge_use[edgeKey(t[corner], t[(corner + 1) % 3])]++;
+  }
+  for (const glm::uvec3& t : triangles)
+  {
+    glm::dvec3 normal =
+        faceNormal(positions[t[0]], positions[t[1]], positions[t[2]]);
+    for (int corner = 0; corner < 3; corner++)
+    {
+      unsigned a = t[corner];
+      unsigned b = t[(corner + 1) % 3];
+      if (edge_use[edgeKey(a, b)] != 1)
+        continue;
+      glm::dvec3 edge = positions[b] - positions[a];
+      glm::dvec3 border_normal = glm::cross(edge, normal);
+      double length = glm::length(border_normal);
+      if (length == 0.0)
+        continue;
+      border_normal /= length;
+      double d = -glm::dot(border_normal, positions[a]);
+      double weight = BORDER_WEIGHT * glm::dot(edge, edge);
+      quadrics[a].addPlane(border_normal, d, weight);
+      quadrics[b].addPlane(border_normal, d, weight);
+    }
+  }
+
+  std::vector<std::vector<unsigned>> vertex_triangles(vertex_cnt);
+  for (size_t t_idx = 0; t_idx < triangles.size(); t_idx++)
+    for (int corner = 0; corner < 3; corner++)
+      vertex_triangles[triangles[t_idx][corner]].push_back(
+          static_cast<unsigned>(t_idx));
+
+  std::vector<bool> triangle_removed(triangles.size(), false);
+  std::vector<bool> vertex_removed(vertex_cnt, false);
+  std::vector<unsigned> versions(vertex_cnt, 0);
+  std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>>
+      queue;
+
+  auto push = [&](unsigned from, unsigned to)
+  {
+    Quadric q = quadrics[from];
+    q += quadrics[to];
+    Collapse collapse = {
+        q.error(positions[to]), from, to, versions[from], versions[to]};
+    queue.push(collapse);
+  };
+  auto pushEdgesAround = [&](unsigned vertex)
+  {
+    for (unsigned t_idx : vertex_triangles[vertex])
+    {
+      if (triangle_removed[t_idx])
+        continue;
+      for (int corner = 0; corner < 3; corner++)
+      {
+        unsigned other = triangles[t_idx][corner];
+        if (other == vertex)
+          continue;
+        push(vertex, other);
+        push(other, vertex);
+      }
+    }
+  };
+
+  for (const glm::uvec3& t : triangles)
+  {
+    for (int corner = 0; corner < 3; corner++)
+    {
+      push(t[corner], t[(corner + 1) % 3]);
+      push(t[(corner + 1) % 3], t[corner]);
+    }
+  }
+
+  size_t live_cnt = triangles.size();
+  while (live_cnt > target_triangle_count && !queue.empty())
+  {
+    Collapse collapse = queue.top();
+    queue.pop();
+    const unsigned from = collapse.from;
+    const unsigned to = collapse.to;
+    if (vertex_removed[from] || vertex_removed[to] ||
+        versions[from] != collapse.from_version ||
+        versions[to] != collapse.to_version)
+      continue;
+
+    // Faces that survive the collapse must not fold over or degenerate.
+    bool valid = true;
+    for (unsigned t_idx : vertex_triangles[from])
+    {
+      const glm::uvec3& t = triangles[t_idx];
+      if (triangle_removed[t_idx] || t[0] == to || t[1] == to || t[2] == to)
+        continue;
+      glm::dvec3 before =
+          faceNormal(positions[t[0]], positions[t[1]], positions[t[2]]);
+      glm::dvec3 p[3] = {positions[t[0]], positions[t[1]], positions[t[2]]};
+      for (int corner = 0; corner < 3; corner++)
+        if (t[corner] == from)
+          p[corner] = positions[to];
+      glm::dvec3 after = faceNormal(p[0], p[1], p[2]);
+      double length = glm::length(before) * glm::length(after);
+      if (length == 0.0 || glm::dot(before, after) < MIN_NORMAL_DOT * length)
+      {
+        valid = false;
+        break;
+      }
+    }
+    if (!valid)
+      continue;
+
+    for (unsigned t_idx : vertex_triangles[from])
+    {
+      if (triangle_removed[t_idx])
+        continue;
+      glm::uvec3& t = triangles[t_idx];
+      if (t[0] == to || t[1] == to || t[2] == to)
+      {
+        triangle_removed[t_idx] = true;
+        live_cnt--;
+        continue;
+      }
+      for (int corner = 0; corner < 3; corner++)
+        if (t[corner] == from)
+          t[corner] = to;
+      vertex_triangles[to].push_back(t_idx);
+    }
+    vertex_removed[from] = true;
+    vertex_triangles[from].clear();
+    quadrics[to] += quadrics[from];
+    versions[to]++;
+
+    std::vector<unsigned>& around = vertex_triangles[to];
+    around.erase(std::remove_if(around.begin(), around.end(),
+                     [&](unsigned t_idx) { return triangle_removed[t_idx]; }),
+        around.end());
+    pushEdgesAround(to);
+  }
+
+  // Compact the surviving vertices in first-use order.
+  const unsigned UNUSED = ~0u;
+  std::vector<unsigned> remap(vertex_cnt, UNUSED);
+  std::vector<unsigned> kept;
+  Mesh result;
+  result.setMaterial(mesh.getMaterial());
+  for (size_t t_idx = 0; t_idx < triangles.size(); t_idx++)
+  {
+    if (triangle_removed[t_idx])
+      continue;
+    glm::ivec3 out;
+    for (int corner = 0; corner < 3; corner++)
+    {
+      unsigned v = triangles[t_idx][corner];
+      if (remap[v] == UNUSED)
+      {
+        remap[v] = static_cast<unsigned>(kept.size());
+        kept.push_back(v);
+      }
+      out[corner] = static_cast<int>(remap[v]);
+    }
+    result.addTriangle(out);
+  }
+
+  result.allocateSpace(kept.size());
+  std::vector<glm::vec3> normals(kept.size(), glm::vec3(0.f));
+  for (size_t i = 0; i < kept.size(); i++)
+  {
+    unsigned original = representatives[kept[i]];
+    result.addVertex(vertices[original]);
+    result.addJoints(i, mesh.getJoints(original));
+    result.addWeights(i, mesh.getWeights(original));
+  }
+  for (const glm::ivec3& t : result.getTriangles())
+  {
+    glm::vec3 normal = glm::cross(result.getVertex(t[1]) - result.getVertex(t[0]),
+        result.getVertex(t[2]) - result.getVertex(t[0]));
+    for (int corner = 0; corner < 3; corner++)
+      normals[t[corner]] += normal;
+  }
+  for (glm::vec3& normal : normals)
+  {
+    float length = glm::length(normal);
+    result.addNormal(length > 0.f ? normal / length : glm::vec3(0.f, 1.f, 0.f));
+  }
+  return result;
+}
+
+std::vector<Mesh> MeshSimplifier::buildLodChain(const Mesh& mesh,
+    size_t max_level_count,
+    size_t min_triangle_count)
+{
+  std::vector<Mesh> levels;
+  const Mesh* previous = &mesh;
+  for (size_t level = 1; level <= max_level_count; level++)
+  {
+    size_t target = previous->getTriangleCount() / 2;
+    if (target < min_triangle_count)
+      break;
+    Mesh simplified = simplify(*previous, target);
+    if (simplified.getTriangleCount() * 10 > previous->getTriangleCount() * 9)
+      break;
+    levels.push_back(simplified);
+    previous = &levels.back();
+  }
+  return levels;
+}
@@ -0,0 +1,30 @@
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include <vector>
+#include "Mesh.h"
+
+// Quadric error simplification (Garland/Heckbert) for skinned meshes. It
+// collapses edges onto one of their end points (half-edge collapses), so
+// every vertex of the result is an original vertex and keeps its joints and
+// weights unchanged. Vertices at the same position are welded first so that
+// seams do not tear open, and open borders are held in place by extra border
+// planes.
+class MeshSimplifier
+{
+public:
+  // Simplifies towards target_triangle_count. Stops early when no collapse
+  // passes the flip test any more. Normals are recomputed smooth.
+  static Mesh simplify(const Mesh& mesh, size_t target_triangle_count);
+
+  // Halves the triangle count per level until a level would drop below
+  // min_triangle_count or stops shrinking; level 0 is not included.
+  static std::vector<Mesh> buildLodChain(const Mesh& mesh,
+      size_t max_level_count,
+      size_t min_triangle_count);
+
+private:
+  MeshSimplifier();
+};
+
+#endif // MESHSIMPLIFIER_H
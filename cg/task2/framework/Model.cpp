@@ -1,6 +1,7 @@
 #include "Model.h"
 
 Model::Model()
+    : joints_(std::make_shared<std::vector<Joint> >())
 {
 }
 
@@ -9,23 +10,29 @@ Model::~Model()
 }
 
 void Model::addMesh(const Mesh& mesh)
+{
+  meshes_.push_back(std::make_shared<const Mesh>(mesh));
+}
+
+void Model::addMesh(const std::shared_ptr<const Mesh>& mesh)
 {
   meshes_.push_back(mesh);
 }
 
 void Model::addMeshes(const std::vector<Mesh>& meshes)
 {
-  meshes_.insert(meshes_.end(), meshes.begin(), meshes.end());
+  for (const Mesh& mesh : meshes)
+    addMesh(mesh);
 }
 
 const Mesh& Model::getMesh(size_t index) const
 {
-  return meshes_[index];
+  return *meshes_[index];
 }
 
-const std::vector<Mesh>& Model::getMeshes() const
+const std::shared_ptr<const Mesh>& Model::getSharedMesh(size_t index) const
 {
-  return meshes_;
+  return meshes_[index];
 }
 
 size_t Model::getMeshCount() const
@@ -33,6 +40,39 @@ size_t Model::getMeshCount() const
   return meshes_.size();
 }
 
+void Model::addMeshLod(size_t mesh_index, const Mesh& mesh)
+{
+  addMeshLod(mesh_index, std::make_shared<const Mesh>(mesh));
+}
+
+void Model::addMeshLod(size_t mesh_index,
+    const std::shared_ptr<const Mesh>& mesh)
+{
+  if (mesh_lods_.size() <= mesh_index)
+    mesh_lods_.resize(mesh_index + 1);
+  mesh_lods_[mesh_index].push_back(mesh);
+}
+
+const Mesh& Model::getMeshLod(size_t mesh_index, size_t level) const
+{
+  return *getSharedMeshLod(mesh_index, level);
+}
+
+const std::shared_ptr<const Mesh>& Model::getSharedMeshLod(size_t mesh_index,
+    size_t level) const
+{
+  if (level == 0)
+    return meshes_[mesh_index];
+  return mesh_lods_[mesh_index][level - 1];
+}
+
+size_t Model::getMeshLodCount(size_t mesh_index) const
+{
+  if (mesh_index >= mesh_lods_.size())
+    return 1;
+  return mesh_lods_[mesh_index].size() + 1;
+}
+
 void Model::addMaterial(const Material& material)
 {
   materials_.push_back(material);
@@ -60,35 +100,60 @@ size_t Model::getMaterialCount() const
 
 void Model::addJoint(const Joint& joint)
 {
-  joints_.push_back(joint);
+  addJoints(std::vector<Joint>(1, joint));
 }
 
 void Model::addJoints(const std::vector<Joint>& joints)
 {
-  joints_.insert(joints_.end(), joints.begin(), joints.end());
+  // The skeleton may be shared, so it is replaced rather than appended to.
+  std::shared_ptr<std::vector<Joint> > skeleton =
+      std::make_shared<std::vector<Joint> >(*joints_);
+  skeleton->insert(skeleton->end(), joints.begin(), joints.end());
+  joints_ = skeleton;
+}
+
+void Model::setSkeleton(const std::shared_ptr<const std::vector<Joint> >& joints)
+{
+  joints_ = joints;
 }
 
 const Joint& Model::getJoint(size_t index) const
 {
-  return joints_[index];
+  return (*joints_)[index];
 }
 
 const std::vector<Joint>& Model::getJoints() const
+{
+  return *joints_;
+}
+
+const std::shared_ptr<const std::vector<Joint> >& Model::getSkeleton() const
 {
   return joints_;
 }
 
 size_t Model::getJointCount() const
 {
-  return joints_.size();
+  return joints_->size();
 }
 
 void Model::addAnimation(const Animation& action)
+{
+  actions_.push_back(std::make_shared<const Animation>(action));
+}
+
+void Model::addAnimation(const std::shared_ptr<const Animation>& action)
 {
   actions_.push_back(action);
 }
 
 const Animation& Model::getAnimation(size_t index) const
+{
+  return *actions_[index];
+}
+
+const std::shared_ptr<const Animation>& Model::getSharedAnimation(
+    size_t index) const
 {
   return actions_[index];
 }
@@ -1,12 +1,15 @@
 #ifndef Model_H_INCLUDED
 #define Model_H_INCLUDED
 
+#include <memory>
 #include <vector>
 #include "Mesh.h"
 #include "Material.h"
 #include "Joint.h"
 #include "Animation.h"
 
+// Meshes, the skeleton and the clips are immutable once added and held by
+// shared pointers, so models loaded through the AssetCache share them.
 class Model
 {
 public:
@@ -14,11 +17,20 @@ public:
   virtual ~Model();
 
   void addMesh(const Mesh& mesh);
+  void addMesh(const std::shared_ptr<const Mesh>& mesh);
   void addMeshes(const std::vector<Mesh>& meshes);
   const Mesh& getMesh(size_t index) const;
-  const std::vector<Mesh>& getMeshes() const;
+  const std::shared_ptr<const Mesh>& getSharedMesh(size_t index) const;
   size_t getMeshCount() const;
 
+  // Simplified versions of a mesh, level 0 is the mesh itself.
+  void addMeshLod(size_t mesh_index, const Mesh& mesh);
+  void addMeshLod(size_t mesh_index, const std::shared_ptr<const Mesh>& mesh);
+  const Mesh& getMeshLod(size_t mesh_index, size_t level) const;
+  const std::shared_ptr<const Mesh>& getSharedMeshLod(size_t mesh_index,
+      size_t level) const;
+  size_t getMeshLodCount(size_t mesh_index) const;
+
   void addMaterial(const Material& material);
   void addMaterials(const std::vector<Material>& materials);
   const Material& getMaterial(size_t index) const;
@@ -27,19 +39,25 @@ public:
 
   void addJoint(const Joint& joint);
   void addJoints(const std::vector<Joint>& joints);
+  void setSkeleton(const std::shared_ptr<const std::vector<Joint> >& joints);
   const Joint& getJoint(size_t index) const;
   const std::vector<Joint>& getJoints() const;
+  const std::shared_ptr<const std::vector<Joint> >& getSkeleton() const;
   size_t getJointCount() const;
 
   void addAnimation(const Animation& action);
+  void addAnimation(const std::shared_ptr<const Animation>& action);
   const Animation& getAnimation(size_t index) const;
+  const std::shared_ptr<const Animation>& getSharedAnimation(
+      size_t index) const;
   size_t getActionCount() const;
 
 protected:
-  std::vector<Mesh> meshes_;
+  std::vector<std::shared_ptr<const Mesh> > meshes_;
+  std::vector<std::vector<std::shared_ptr<const Mesh> > > mesh_lods_;
   std::vector<Material> materials_;
-  std::vector<Joint> joints_;
-  std::vector<Animation> actions_;
+  std::shared_ptr<const std::vector<Joint> > joints_;
+  std::vector<std::shared_ptr<const Animation> > actions_;
 
 private:
   Model(const Model* model);
@@ -47,5 +65,3 @@ private:
 
 
 #endif  // Model_H_INCLUDED
-
-
@@ -16,7 +16,11 @@
 #include <glm/gtx/string_cast.hpp>
 #include <iostream>
 #include "Shader.h"
+#include "GLState.h"
+#include "Profiler.h"
 #include "Joint.h"
+#include "GlyphGeometry.h"
+#include "GLCapabilities.h"
 #include "Animation.h"
 #include "Keyframe.h"
 #include "Camera.h"
@@ -24,16 +28,28 @@
 #include "Config.h"
 #include <cmath>
 #include <sstream>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 
 using std::cout;
 using std::cerr;
 using std::endl;
 
+const float ModelDrawer::LOD_FULL_DETAIL_SIZE = 0.25f;
+
 ModelDrawer::ModelDrawer(const Model* model)
     : IModelDrawer(model)
+    , lod_level_(0)
+    , max_lod_level_(0)
     , joints_vbo_(0)
-    , action_started_(false)
-    , curr_action_(0)
+    , bones_vbo_(0)
+    , joint_glyph_vbo_(0)
+    , bone_glyph_vbo_(0)
+    , use_instancing_(false)
+    , draw_cnt_(0)
+    , use_packed_vertices_(false)
+    , mesh_program_(0)
 {
 }
 
@@ -44,177 +60,299 @@ ModelDrawer::~ModelDrawer()
 void ModelDrawer::init()
 {
   cout << "Initializing the model drawer." << endl;
+
+  cout << "Resolving shader inputs." << endl;
+  position_attrib_ = shader_->getAttrib("position");
+  normal_attrib_ = shader_->getAttrib("normal");
+  model_mat_uniform_ = shader_->getUniform("model_mat");
+  normal_mat_uniform_ = shader_->getUniform("normal_mat");
+  mat_diffuse_uniform_ = shader_->getUniform("mat_diffuse");
+
+  use_packed_vertices_ = mesh_shader_ != 0;
+  mesh_program_ = use_packed_vertices_ ? mesh_shader_ : shader_;
+  cout << "Streaming " << (use_packed_vertices_ ? "packed" : "float")
+       << " mesh vertices (" << getStreamStride() << " bytes each)." << endl;
+  mesh_position_attrib_ = mesh_program_->getAttrib("position");
+  mesh_normal_attrib_ = mesh_program_->getAttrib("normal");
+  mesh_model_mat_uniform_ = mesh_program_->getUniform("model_mat");
+  mesh_normal_mat_uniform_ = mesh_program_->getUniform("normal_mat");
+  mesh_diffuse_uniform_ = mesh_program_->getUniform("mat_diffuse");
+  if (use_packed_vertices_)
+  {
+    position_center_uniform_ = mesh_program_->getUniform("position_center");
+    position_extent_uniform_ = mesh_program_->getUniform("position_extent");
+  }
+
+  // Every mesh LOD gets its own range ("slot") in the batch.
   for (size_t i = 0; i < model_->getMeshCount(); i++)
   {
-    const Mesh& mesh = model_->getMesh(i);
+    lod_slots_.emplace_back();
+    max_lod_level_ = std::max(max_lod_level_, model_->getMeshLodCount(i) - 1);
+    for (size_t level = 0; level < model_->getMeshLodCount(i); level++)
+    {
+      const Mesh& mesh = model_->getMeshLod(i, level);
+      lod_slots_.back().push_back(batch_.addMesh(mesh));
+
+      vertices_.emplace_back(mesh.getVertexCount());
+      face_normals_.emplace_back(mesh.getTriangleCount());
+      vertex_triangle_offsets_.emplace_back();
+      vertex_triangles_.emplace_back();
+      normals_draw_.push_back(std::numeric_limits<size_t>::max());
+      calcVertexTriangleAdjacency(
+          mesh, vertex_triangle_offsets_.back(), vertex_triangles_.back());
+    }
+  }
 
-    cout << "Creating vertex vbo for mesh " << i << "." << endl;
-    GLBuffer* vertex_vbo = genVertexVBO(mesh);
-    vertex_vbos_[i] = vertex_vbo;
+  cout << "Creating the mesh batch." << endl;
+  batch_.create(getStreamStride());
+  if (VertexArray::isSupported())
+  {
+    cout << "Creating vertex arrays for the mesh batch." << endl;
+    vertex_arrays_ =
+        genVertexArrays(batch_.getVertexPool(), batch_.getIndexPool());
+  }
 
-    cout << "Creating normal vbo for mesh " << i << "." << endl;
-    GLBuffer* normal_vbo = genNormalVBO(mesh);
-    normal_vbos_[i] = normal_vbo;
+  cout << "Calculating joint bounding spheres." << endl;
+  for (size_t i = 0; i < model_->getMeshCount(); i++)
+  {
+    joint_spheres_.emplace_back();
+    calcJointSpheres(model_->getMeshLod(i, 0), joint_spheres_.back());
+  }
+  mesh_culled_.assign(model_->getMeshCount(), false);
 
-    cout << "Creating triangle ibo for mesh " << i << "." << endl;
-    GLBuffer* triangle_ibo = genTriangleIBO(mesh);
-    triangle_ibos_[i] = triangle_ibo;
+  cout << "Caching bone count." << endl;
+  bone_count_ = calcBoneCount();
 
-    vertices_.emplace_back(mesh.getVertexCount());
-    normals_.emplace_back(mesh.getVertexCount());
+  use_instancing_ = glyph_shader_ && GLCapabilities::hasInstancing();
+  if (use_instancing_)
+  {
+    cout << "Drawing joints and bones with instancing." << endl;
+    glyph_position_attrib_ = glyph_shader_->getAttrib("position");
+    glyph_normal_attrib_ = glyph_shader_->getAttrib("normal");
+    instance_mat_attrib_ = glyph_shader_->getAttrib("instance_mat");
+    instance_normal_mat_attrib_ =
+        glyph_shader_->getAttrib("instance_normal_mat");
+    glyph_model_mat_uniform_ = glyph_shader_->getUniform("model_mat");
+    glyph_normal_mat_uniform_ = glyph_shader_->getUniform("normal_mat");
+    glyph_mat_diffuse_uniform_ = glyph_shader_->getUniform("mat_diffuse");
+
+    joint_glyph_vbo_ = genGlyphVBO(GlyphGeometry::getJointVertices());
+    bone_glyph_vbo_ = genGlyphVBO(GlyphGeometry::getBoneVertices());
+  }
+  else
+  {
+    cout << "Drawing joints and bones as CPU batches." << endl;
   }
 
   cout << "Creating joints vbo." << endl;
-  joints_vbo_ = genJointsVBO();
+  joints_vbo_ = genGlyphStreamVBO(
+      model_->getJointCount(), GlyphGeometry::JOINT_VERTEX_COUNT);
 
   cout << "Creating bones vbo." << endl;
-  bones_vbo_ = genBonesVBO();
-
-  cout << "Caching bone count." << endl;
-  bone_count_ = calcBoneCount();
+  bones_vbo_ =
+      genGlyphStreamVBO(bone_count_, GlyphGeometry::BONE_VERTEX_COUNT);
 
   cout << "Initializing the model matrix with the identity matrix." << endl;
   model_mat_ = glm::mat4(1);
 
-  joint_transformations_.resize(model_->getJointCount());
+  initPose();
 }
 
 void ModelDrawer::draw()
 {
-  // Pass model and normal matrix over to the shader.
-  shader_->setUniformMatrix4f("model_mat", model_mat_);
-  shader_->setUniformMatrix4f("normal_mat", normal_mat_);
+  PROFILE_GPU_ZONE("ModelDrawer::draw");
 
-  size_t mesh_cnt = model_->getMeshCount();
-  for (size_t i = 0; i < mesh_cnt; i++)
+  // The frame budget may push the model to coarser levels than its size
+  // asks for.
+  size_t lod_level =
+      std::min(calcLodLevel() + quality_.lod_bias, max_lod_level_);
+  if (lod_level != lod_level_)
   {
-    const Mesh& mesh = model_->getMesh(i);
-    const Material& material = model_->getMaterial(mesh.getMaterial());
-    GLBuffer* vertex_vbo = vertex_vbos_[i];
-    GLBuffer* normal_vbo = normal_vbos_[i];
-    GLBuffer* triangle_ibo = triangle_ibos_[i];
+    cout << "Switching model to LOD " << lod_level << "." << endl;
+    lod_level_ = lod_level;
+  }
 
-    vertex_vbo->bind();
+  // Skin every visible mesh first; packed vertices of the whole batch are
+  // quantized against the bounds of all of them. Culled meshes skip
+  // skinning, normals and upload.
+  size_t mesh_cnt = model_->getMeshCount();
+  glm::vec3 min_corner(std::numeric_limits<float>::max());
+  glm::vec3 max_corner(-std::numeric_limits<float>::max());
+  batch_.clearDraws();
+  for (size_t mesh_idx = 0; mesh_idx < mesh_cnt; mesh_idx++)
+  {
+    bool culled = !isMeshVisible(mesh_idx);
+    if (culled != mesh_culled_[mesh_idx])
+    {
+      cout << (culled ? "Culling" : "Showing") << " mesh " << mesh_idx << "."
+           << endl;
+      mesh_culled_[mesh_idx] = culled;
+    }
+    if (culled)
+      continue;
 
+    size_t level = std::min(lod_level_, lod_slots_[mesh_idx].size() - 1);
+    size_t i = lod_slots_[mesh_idx][level];
+    const Mesh& mesh = model_->getMeshLod(mesh_idx, level);
     if (action_started_)
     {
+      PROFILE_ZONE("skinning");
       calculateVertices(mesh.getVertices(), model_->getJoints(),
           mesh.getJoints(), mesh.getWeights(), joint_transformations_,
           vertices_[i]);
     }
-    else
-    {
-      vertices_[i] = mesh.getVertices();
-    }
-
-    vertex_vbo->discardData();
-    vertex_vbo->write(vertices_[i]);
-    vertex_vbo->unbind();
+    if (use_packed_vertices_)
+      VertexPacking::extendBounds(
+          action_started_ ? vertices_[i] : mesh.getVertices(), min_corner,
+          max_corner);
+    batch_.queueDraw(i, mesh.getMaterial());
+  }
+  if (batch_.getDrawCount() == 0)
+    return;
+
+  glm::vec3 center;
+  glm::vec3 extent;
+  VertexPacking::calcBounds(min_corner, max_corner, center, extent);
+  glm::vec3 inv_extent = 1.f / extent;
+  draw_cnt_++;
+  void* stream_data = batch_.beginWrite();
+  for (size_t mesh_idx = 0; mesh_idx < mesh_cnt; mesh_idx++)
+  {
+    if (mesh_culled_[mesh_idx])
+      continue;
 
-    normal_vbo->bind();
-    if (action_started_)
+    size_t level = std::min(lod_level_, lod_slots_[mesh_idx].size() - 1);
+    size_t i = lod_slots_[mesh_idx][level];
+    const Mesh& mesh = model_->getMeshLod(mesh_idx, level);
+    const std::vector<glm::vec3>& positions =
+        action_started_ ? vertices_[i] : mesh.getVertices();
+    size_t first_vertex = batch_.getFirstVertex(i);
+    bool update_face_normals =
+        normals_draw_[i] == std::numeric_limits<size_t>::max() ||
+        draw_cnt_ - normals_draw_[i] >= quality_.normal_interval;
+    if (action_started_ && update_face_normals)
+      normals_draw_[i] = draw_cnt_;
+
+    if (use_packed_vertices_)
     {
-      calculateNormals(vertices_[i], mesh.getTriangles(), normals_[i]);
+      PackedVertex* packed =
+          static_cast<PackedVertex*>(stream_data) + first_vertex;
+      if (action_started_)
+      {
+        PROFILE_ZONE("normals");
+        calculatePackedNormals(positions, mesh.getTriangles(),
+            vertex_triangle_offsets_[i], vertex_triangles_[i],
+            face_normals_[i], center, extent, packed, update_face_normals);
+      }
+      else
+      {
+        PROFILE_ZONE("upload");
+        const std::vector<glm::vec3>& normals = mesh.getNormals();
+        for (size_t v_idx = 0; v_idx < positions.size(); v_idx++)
+          packed[v_idx] = VertexPacking::pack(
+              positions[v_idx], normals[v_idx], center, inv_extent);
+      }
     }
     else
     {
-      normals_[i] = mesh.getNormals();
+      glm::vec3* interleaved =
+          static_cast<glm::vec3*>(stream_data) + 2 * first_vertex;
+      if (action_started_)
+      {
+        // Writes straight into the mapped stream buffer.
+        PROFILE_ZONE("normals");
+        calculateInterleavedNormals(positions, mesh.getTriangles(),
+            vertex_triangle_offsets_[i], vertex_triangles_[i],
+            face_normals_[i], interleaved, update_face_normals);
+      }
+      else
+      {
+        PROFILE_ZONE("upload");
+        const std::vector<glm::vec3>& normals = mesh.getNormals();
+        for (size_t v_idx = 0; v_idx < positions.size(); v_idx++)
+        {
+          interleaved[2 * v_idx] = positions[v_idx];
+          interleaved[2 * v_idx + 1] = normals[v_idx];
+        }
+      }
     }
-    normal_vbo->discardData();
-    normal_vbo->write(normals_[i]);
-    normal_vbo->unbind();
+  }
 
-    vertex_vbo->bind();
-    shader_->setAttribPointer("position", GL_FLOAT, 3, 0);
-    shader_->enableAttribArray("position");
+  size_t stream_offset;
+  {
+    PROFILE_ZONE("upload");
+    stream_offset = batch_.endWrite();
+  }
 
-    normal_vbo->bind();
-    shader_->setAttribPointer("normal", GL_FLOAT, 3, 0);
-    shader_->enableAttribArray("normal");
+  if (mesh_program_ != shader_)
+    mesh_program_->bind();
 
-    triangle_ibo->bind();
+  // Pass model and normal matrix over to the shader.
+  mesh_program_->setUniformMatrix4f(mesh_model_mat_uniform_, model_mat_);
+  mesh_program_->setUniformMatrix4f(mesh_normal_mat_uniform_, normal_mat_);
+  if (use_packed_vertices_)
+  {
+    mesh_program_->setUniform3f(position_center_uniform_, center);
+    mesh_program_->setUniform3f(position_extent_uniform_, extent);
+  }
 
-    shader_->setUniform3f("mat_diffuse", material.getDiffuse());
+  if (!vertex_arrays_.empty())
+  {
+    vertex_arrays_[batch_.getVertexPool()->getRingSlot()]->bind();
+  }
+  else
+  {
+    setMeshAttribPointers(stream_offset);
+    batch_.getIndexPool()->bind();
+  }
 
-    GLsizei element_cnt = static_cast<GLsizei>(mesh.getTriangleCount() * 3);
-    glDrawElements(GL_TRIANGLES, element_cnt, GL_UNSIGNED_INT, 0);
+  batch_.submit(
+      mesh_program_, mesh_diffuse_uniform_, model_->getMaterials());
 
-    triangle_ibo->unbind();
-    normal_vbo->unbind();
-    vertex_vbo->unbind();
-  }
+  // Leave the default layout and program bound for the immediate-style
+  // drawers.
+  if (!vertex_arrays_.empty())
+    GLState::bindVertexArray(0);
+  if (mesh_program_ != shader_)
+    shader_->bind();
 }
 
 void ModelDrawer::drawJoints()
 {
-  std::vector<glm::vec3> vertex_data;
+  const std::vector<glm::vec3>& glyph = GlyphGeometry::getJointVertices();
   size_t joint_count = model_->getJointCount();
+
+  joints_vbo_->bind();
+  void* stream_data = joints_vbo_->beginRingWrite();
+  GlyphInstance* instances = static_cast<GlyphInstance*>(stream_data);
+  glm::vec3* vertices = static_cast<glm::vec3*>(stream_data);
   for (size_t joint_index = 0; joint_index < joint_count; joint_index++)
   {
-    const Joint& joint = model_->getJoint(joint_index);
-
-    // Vertices
-    const glm::mat4& joint_transform = joint_transformations_[joint_index];
-    const float& js = joint_size_;
-    std::vector<glm::vec3> vertices = {glm::vec3(-js, -js, js),
-        glm::vec3(0, js, 0),
-        glm::vec3(js, -js, js),
-        glm::vec3(-js, -js, -js),
-        glm::vec3(0, js, 0),
-        glm::vec3(js, -js, -js),
-        glm::vec3(js, -js, js),
-        glm::vec3(0, js, 0),
-        glm::vec3(js, -js, -js),
-        glm::vec3(-js, -js, -js),
-        glm::vec3(0, js, 0),
-        glm::vec3(-js, -js, js),
-        glm::vec3(js, -js, -js),
-        glm::vec3(-js, -js, -js),
-        glm::vec3(-js, -js, js),
-        glm::vec3(js, -js, -js),
-        glm::vec3(-js, -js, js),
-        glm::vec3(js, -js, js)};
-
-    for (size_t v_idx = 0; v_idx < vertices.size(); ++v_idx)
-    {
-      vertices[v_idx] =
-          glm::vec3(joint_transform * glm::vec4(vertices[v_idx], 1));
-    }
-    std::vector<glm::ivec3> triangles = {glm::ivec3(0, 1, 2),
-        glm::ivec3(5, 4, 3),
-        glm::ivec3(6, 7, 8),
-        glm::ivec3(9, 10, 11),
-        glm::ivec3(12, 13, 14),
-        glm::ivec3(15, 16, 17)};
-    std::vector<glm::vec3> normals(vertices.size());
-    calculateNormals(vertices, triangles, normals);
-
-    for (size_t v_idx = 0; v_idx < vertices.size(); ++v_idx)
-    {
-      vertex_data.push_back(vertices[v_idx]);
-      vertex_data.push_back(normals[v_idx]);
-    }
+    GlyphInstance instance = GlyphGeometry::jointInstance(
+        joint_transformations_[joint_index], joint_size_);
+    if (use_instancing_)
+      instances[joint_index] = instance;
+    else
+      GlyphGeometry::transform(
+          instance, glyph, vertices + joint_index * glyph.size());
   }
+  joints_vbo_->markRingWritten(0, use_instancing_
+          ? joint_count * sizeof(GlyphInstance)
+          : joint_count * glyph.size() * sizeof(glm::vec3));
+  size_t stream_offset = joints_vbo_->endRingWrite();
 
-  joints_vbo_->bind();
-  joints_vbo_->discardData();
-  joints_vbo_->write(vertex_data);
-
-  shader_->setAttribPointer("position", GL_FLOAT, 3, 24, 0);
-  shader_->enableAttribArray("position");
-  shader_->setAttribPointer("normal", GL_FLOAT, 3, 24, 12);
-  shader_->enableAttribArray("normal");
-  shader_->setUniform3f("mat_diffuse", model_->getMaterial(0).getDiffuse());
-  shader_->setUniformMatrix4f("model_mat", model_mat_);
-  shader_->setUniformMatrix4f("normal_mat", normal_mat_);
-  glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(joint_count * 18));
-
-  joints_vbo_->unbind();
+  drawGlyphs(joint_glyph_vbo_, joints_vbo_, stream_offset,
+      GlyphGeometry::JOINT_VERTEX_COUNT, joint_count);
 }
 
 void ModelDrawer::drawBones()
 {
-  std::vector<glm::vec3> vertex_data;
+  const std::vector<glm::vec3>& glyph = GlyphGeometry::getBoneVertices();
+
+  bones_vbo_->bind();
+  void* stream_data = bones_vbo_->beginRingWrite();
+  GlyphInstance* instances = static_cast<GlyphInstance*>(stream_data);
+  glm::vec3* vertices = static_cast<glm::vec3*>(stream_data);
   size_t bone_count = 0;
   for (const Joint& joint : model_->getJoints())
   {
@@ -223,150 +361,181 @@ void ModelDrawer::drawBones()
       continue;
     }
 
-    glm::mat4 parent_transform = joint_transformations_[joint.getParent()];
-
-    glm::mat4 joint_transform = joint_transformations_[joint.getID()];
-    glm::vec4 joint_transl = joint_transform[3];
-    joint_transform = parent_transform;
-    joint_transform[3] = joint_transl;
-
-    // Vertices
-    std::vector<glm::vec3> vertices = {
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(parent_transform * glm::vec4(-bone_size_, 0, bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, -bone_size_, 1)),
-        glm::vec3(joint_transform * glm::vec4(-bone_size_, 0, bone_size_, 1))};
-
-    // Normals
-    std::vector<glm::ivec3> triangles = {glm::ivec3(0, 1, 2),
-        glm::ivec3(3, 4, 5),
-        glm::ivec3(6, 7, 8),
-        glm::ivec3(9, 10, 11),
-        glm::ivec3(12, 13, 14),
-        glm::ivec3(15, 16, 17),
-        glm::ivec3(18, 19, 20),
-        glm::ivec3(21, 22, 23)};
-
-    std::vector<glm::vec3> normals(vertices.size());
-    calculateNormals(vertices, triangles, normals);
-
-    for (unsigned i = 0; i < vertices.size(); i++)
-    {
-      vertex_data.push_back(vertices[i]);
-      vertex_data.push_back(normals[i]);
-    }
+    GlyphInstance instance = GlyphGeometry::boneInstance(
+        joint_transformations_[joint.getParent()],
+        joint_transformations_[joint.getID()], bone_size_);
+    if (use_instancing_)
+      instances[bone_count] = instance;
+    else
+      GlyphGeometry::transform(
+          instance, glyph, vertices + bone_count * glyph.size());
 
     bone_count++;
   }
+  bones_vbo_->markRingWritten(0, use_instancing_
+          ? bone_count * sizeof(GlyphInstance)
+          : bone_count * glyph.size() * sizeof(glm::vec3));
+  size_t stream_offset = bones_vbo_->endRingWrite();
 
-  bones_vbo_->bind();
-  bones_vbo_->discardData();
-  bones_vbo_->write(vertex_data);
-
-  shader_->setAttribPointer("position", GL_FLOAT, 3, 24, 0);
-  shader_->enableAttribArray("position");
-  shader_->setAttribPointer("normal", GL_FLOAT, 3, 24, 12);
-  shader_->enableAttribArray("normal");
-  shader_->setUniform3f("mat_diffuse", model_->getMaterial(0).getDiffuse());
-  shader_->setUniformMatrix4f("model_mat", model_mat_);
-  shader_->setUniformMatrix4f("normal_mat", normal_mat_);
-  glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(bone_count * 24));
-
-  bones_vbo_->unbind();
+  drawGlyphs(bone_glyph_vbo_, bones_vbo_, stream_offset,
+      GlyphGeometry::BONE_VERTEX_COUNT, bone_count);
 }
 
-GLBuffer* ModelDrawer::genVertexVBO(const Mesh& mesh)
+void ModelDrawer::drawGlyphs(GLBuffer* glyph_vbo,
+    GLBuffer* stream_vbo,
+    size_t stream_offset,
+    size_t vertex_cnt,
+    size_t instance_cnt)
 {
-  const std::vector<glm::vec3>& vertices = mesh.getVertices();
-  const size_t byte_cnt = vertices.size() * sizeof(glm::vec3);
-  cout << "Generating vertex vbo for " << vertices.size() << " vertices ("
-       << byte_cnt << " bytes)." << endl;
-  GLBuffer* vbo = new GLBuffer(GLBuffer::BufferType::VERTEX_BUFFER);
-  vbo->create();
-  vbo->bind();
-  vbo->allocate(byte_cnt, GLBuffer::Usage::STREAM_DRAW);
-  vbo->write(vertices);
-  vbo->unbind();
+  PROFILE_GPU_ZONE("ModelDrawer::drawGlyphs");
 
-  return vbo;
+  const glm::vec3& diffuse = model_->getMaterial(0).getDiffuse();
+  const int vertex_stride = 2 * sizeof(glm::vec3);
+
+  if (!use_instancing_)
+  {
+    stream_vbo->bind();
+    shader_->setAttribPointer(
+        position_attrib_, GL_FLOAT, 3, vertex_stride, stream_offset);
+    shader_->enableAttribArray(position_attrib_);
+    shader_->setAttribPointer(normal_attrib_, GL_FLOAT, 3, vertex_stride,
+        stream_offset + sizeof(glm::vec3));
+    shader_->enableAttribArray(normal_attrib_);
+    shader_->setUniform3f(mat_diffuse_uniform_, diffuse);
+    shader_->setUniformMatrix4f(model_mat_uniform_, model_mat_);
+    shader_->setUniformMatrix4f(normal_mat_uniform_, normal_mat_);
+    glDrawArrays(
+        GL_TRIANGLES, 0, static_cast<GLsizei>(instance_cnt * vertex_cnt));
+    GLState::countCall();
+    return;
+  }
+
+  glyph_shader_->bind();
+  glyph_shader_->setUniform3f(glyph_mat_diffuse_uniform_, diffuse);
+  glyph_shader_->setUniformMatrix4f(glyph_model_mat_uniform_, model_mat_);
+  glyph_shader_->setUniformMatrix4f(glyph_normal_mat_uniform_, normal_mat_);
+
+  glyph_vbo->bind();
+  glyph_shader_->setAttribPointer(
+      glyph_position_attrib_, GL_FLOAT, 3, vertex_stride, 0);
+  glyph_shader_->enableAttribArray(glyph_position_attrib_);
+  glyph_shader_->setAttribPointer(
+      glyph_normal_attrib_, GL_FLOAT, 3, vertex_stride, sizeof(glm::vec3));
+  glyph_shader_->enableAttribArray(glyph_normal_attrib_);
+
+  const int instance_stride = sizeof(GlyphInstance);
+  stream_vbo->bind();
+  for (unsigned col = 0; col < 4; col++)
+  {
+    Shader::Attrib attrib = instance_mat_attrib_.column(col);
+    glyph_shader_->setAttribPointer(attrib, GL_FLOAT, 4, instance_stride,
+        stream_offset + col * sizeof(glm::vec4));
+    glyph_shader_->enableAttribArray(attrib);
+    glyph_shader_->setAttribDivisor(attrib, 1);
+  }
+  for (unsigned col = 0; col < 3; col++)
+  {
+    Shader::Attrib attrib = instance_normal_mat_attrib_.column(col);
+    glyph_shader_->setAttribPointer(attrib, GL_FLOAT, 3, instance_stride,
+        stream_offset + sizeof(glm::mat4) + col * sizeof(glm::vec3));
+    glyph_shader_->enableAttribArray(attrib);
+    glyph_shader_->setAttribDivisor(attrib, 1);
+  }
+
+  glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(vertex_cnt),
+      static_cast<GLsizei>(instance_cnt));
+  GLState::countCall();
+
+  // Per-instance arrays would leak into the mesh shader's locations.
+  for (unsigned col = 0; col < 4; col++)
+  {
+    glyph_shader_->setAttribDivisor(instance_mat_attrib_.column(col), 0);
+    glyph_shader_->disableAttribArray(instance_mat_attrib_.column(col));
+  }
+  for (unsigned col = 0; col < 3; col++)
+  {
+    glyph_shader_->setAttribDivisor(instance_normal_mat_attrib_.column(col), 0);
+    glyph_shader_->disableAttribArray(instance_normal_mat_attrib_.column(col));
+  }
+
+  shader_->bind();
 }
 
-GLBuffer* ModelDrawer::genNormalVBO(const Mesh& mesh)
+size_t ModelDrawer::getStreamStride() const
 {
-  const std::vector<glm::vec3>& normals = mesh.getNormals();
-  const size_t byte_cnt = normals.size() * sizeof(glm::vec3);
-  cout << "Generating normal vbo for " << normals.size() << " normals ("
-       << byte_cnt << " bytes)." << endl;
-  GLBuffer* vbo = new GLBuffer(GLBuffer::BufferType::VERTEX_BUFFER);
-  vbo->create();
-  vbo->bind();
-  vbo->allocate(byte_cnt, GLBuffer::Usage::STREAM_DRAW);
-  vbo->write(normals);
-  vbo->unbind();
+  return use_packed_vertices_ ? sizeof(PackedVertex) : 2 * sizeof(glm::vec3);
+}
 
-  return vbo;
+void ModelDrawer::setMeshAttribPointers(size_t stream_offset)
+{
+  const int stride = static_cast<int>(getStreamStride());
+  if (use_packed_vertices_)
+  {
+    mesh_program_->setAttribPointer(mesh_position_attrib_, GL_SHORT, 3,
+        stride, stream_offset + offsetof(PackedVertex, position), true);
+    mesh_program_->setAttribPointer(mesh_normal_attrib_, GL_SHORT, 2, stride,
+        stream_offset + offsetof(PackedVertex, normal), true);
+  }
+  else
+  {
+    mesh_program_->setAttribPointer(
+        mesh_position_attrib_, GL_FLOAT, 3, stride, stream_offset);
+    mesh_program_->setAttribPointer(mesh_normal_attrib_, GL_FLOAT, 3, stride,
+        stream_offset + sizeof(glm::vec3));
+  }
+  mesh_program_->enableAttribArray(mesh_position_attrib_);
+  mesh_program_->enableAttribArray(mesh_normal_attrib_);
 }
 
-GLBuffer* ModelDrawer::genTriangleIBO(const Mesh& mesh)
+std::vector<VertexArray*> ModelDrawer::genVertexArrays(GLBuffer* stream_vbo,
+    GLBuffer* triangle_ibo)
 {
-  const std::vector<glm::ivec3>& triangles = mesh.getTriangles();
-  const size_t byte_cnt = triangles.size() * sizeof(glm::ivec3);
-  cout << "Generating triangle ibo for " << triangles.size() << " triangles ("
-       << byte_cnt << " bytes)." << endl;
-  GLBuffer* ibo = new GLBuffer(GLBuffer::BufferType::INDEX_BUFFER);
-  ibo->create();
-  ibo->bind();
-  ibo->allocate(byte_cnt, GLBuffer::Usage::STATIC_DRAW);
-  ibo->write(triangles);
-  ibo->unbind();
-
-  return ibo;
+  std::vector<VertexArray*> vertex_arrays;
+  for (unsigned slot = 0; slot < stream_vbo->getRingSlotCount(); slot++)
+  {
+    size_t slot_offset = stream_vbo->getRingSlotOffset(slot);
+    VertexArray* vertex_array = new VertexArray();
+    vertex_array->create();
+    vertex_array->bind();
+
+    stream_vbo->bind();
+    setMeshAttribPointers(slot_offset);
+    triangle_ibo->bind();
+
+    vertex_array->unbind();
+    vertex_arrays.push_back(vertex_array);
+  }
+  stream_vbo->unbind();
+  return vertex_arrays;
 }
 
-GLBuffer* ModelDrawer::genJointsVBO()
+GLBuffer* ModelDrawer::genGlyphStreamVBO(size_t instance_cnt,
+    size_t vertex_cnt)
 {
-  size_t joint_cnt = model_->getJointCount();
-  const size_t byte_cnt = joint_cnt * 36 * sizeof(glm::vec3);
-  cout << "Generating vbo for the joint representation (" << byte_cnt
-       << " bytes)." << endl;
+  size_t slot_byte_cnt = std::max<size_t>(instance_cnt, 1);
+  if (use_instancing_)
+    slot_byte_cnt *= sizeof(GlyphInstance);
+  else
+    slot_byte_cnt *= vertex_cnt * 2 * sizeof(glm::vec3);
+  cout << "Generating glyph stream vbo for " << instance_cnt
+       << " instances (" << slot_byte_cnt << " bytes per frame)." << endl;
   GLBuffer* vbo = new GLBuffer(GLBuffer::BufferType::VERTEX_BUFFER);
   vbo->create();
   vbo->bind();
-  vbo->allocate(byte_cnt, GLBuffer::Usage::STREAM_DRAW);
+  vbo->allocateRing(slot_byte_cnt);
   vbo->unbind();
   return vbo;
 }
 
-GLBuffer* ModelDrawer::genBonesVBO()
+GLBuffer* ModelDrawer::genGlyphVBO(const std::vector<glm::vec3>& vertices)
 {
-  size_t bone_cnt = calcBoneCount();
-  const size_t byte_cnt = bone_cnt * 48 * sizeof(glm::vec3);
-  cout << "Generating vbo for the bone representation (" << byte_cnt
-       << " bytes)." << endl;
+  const size_t byte_cnt = vertices.size() * sizeof(glm::vec3);
+  cout << "Generating glyph vbo (" << byte_cnt << " bytes)." << endl;
   GLBuffer* vbo = new GLBuffer(GLBuffer::BufferType::VERTEX_BUFFER);
   vbo->create();
   vbo->bind();
-  vbo->allocate(byte_cnt, GLBuffer::Usage::STREAM_DRAW);
+  vbo->allocate(byte_cnt, GLBuffer::Usage::STATIC_DRAW);
+  vbo->write(vertices);
   vbo->unbind();
   return vbo;
 }
@@ -384,112 +553,164 @@ size_t ModelDrawer::calcBoneCount()
   return bone_cnt;
 }
 
-void ModelDrawer::startAction(size_t action)
+size_t ModelDrawer::calcLodLevel() const
 {
-  curr_action_ = action;
-  action_started_ = true;
+  if (!camera_ || bounds_radius_ <= 0.f)
+    return 0;
+
+  // Every halving of the projected size below LOD_FULL_DETAIL_SIZE steps
+  // one level down.
+  float size = calcProjectedSize();
+  if (size >= LOD_FULL_DETAIL_SIZE)
+    return 0;
+  size_t level = static_cast<size_t>(std::log2(LOD_FULL_DETAIL_SIZE / size));
+  return std::min(level, max_lod_level_);
 }
 
-void ModelDrawer::update(float time)
+void ModelDrawer::calcJointSpheres(const Mesh& mesh,
+    std::vector<JointSphere>& spheres)
 {
-  // Calculate the model matrix.
-  model_mat_ = glm::translate(glm::mat4(1), translation_);
-  model_mat_ *= glm::mat4_cast(orientation_);
-
-  // Calculate the normal matrix.
-  normal_mat_ = camera_->getViewMatrix() * model_mat_;
-  normal_mat_ = glm::transpose(glm::inverse(normal_mat_));
-
-  if (action_started_)
+  // Box and then sphere around the vertices each joint influences.
+  size_t joint_cnt = model_->getJointCount();
+  std::vector<glm::vec3> min_corners(
+      joint_cnt, glm::vec3(std::numeric_limits<float>::max()));
+  std::vector<glm::vec3> max_corners(
+      joint_cnt, glm::vec3(-std::numeric_limits<float>::max()));
+  std::vector<float> radii(joint_cnt, 0.f);
+  const std::vector<glm::vec3>& vertices = mesh.getVertices();
+  for (size_t v_idx = 0; v_idx < vertices.size(); v_idx++)
   {
-    if (config_->hasAnimationBlending())
+    const std::vector<size_t>& joints = mesh.getJoints(v_idx);
+    const std::vector<float>& weights = mesh.getWeights(v_idx);
+    for (size_t j = 0; j < joints.size(); j++)
     {
-
-      const Animation& action_1 =
-          model_->getAnimation(config_->getAnimationBlendingFrom());
-      const Animation& action_2 =
-          model_->getAnimation(config_->getAnimationBlendingTo());
-
-      interpolateJointsForAnimationModulation(action_1.loopTime(time), action_2.loopTime(time), model_->getJoints(), action_1.getKeyframes(), action_2.getKeyframes(), joint_transformations_);
+      if (weights[j] <= 0.f)
+        continue;
+      min_corners[joints[j]] = glm::min(min_corners[joints[j]], vertices[v_idx]);
+      max_corners[joints[j]] = glm::max(max_corners[joints[j]], vertices[v_idx]);
     }
-    else
+  }
+  for (size_t v_idx = 0; v_idx < vertices.size(); v_idx++)
+  {
+    const std::vector<size_t>& joints = mesh.getJoints(v_idx);
+    const std::vector<float>& weights = mesh.getWeights(v_idx);
+    for (size_t j = 0; j < joints.size(); j++)
     {
-      const Animation& action = model_->getAnimation(curr_action_);
-
-      if (config_->useTransformationsFile())
-      {
-        importJointTransformations(config_->getJointTransformationsFileName());
-      }
-      else
-      {
-        interpolateJoints(action.loopTime(time), model_->getJoints(), action.getKeyframes(), joint_transformations_);
-      }
+      if (weights[j] <= 0.f)
+        continue;
+      glm::vec3 center = 0.5f * (min_corners[joints[j]] + max_corners[joints[j]]);
+      radii[joints[j]] =
+          std::max(radii[joints[j]], glm::length(vertices[v_idx] - center));
     }
   }
+
+  spheres.clear();
+  for (size_t joint = 0; joint < joint_cnt; joint++)
+  {
+    if (min_corners[joint].x > max_corners[joint].x)
+      continue;
+    JointSphere sphere;
+    sphere.joint = joint;
+    sphere.center = 0.5f * (min_corners[joint] + max_corners[joint]);
+    sphere.radius = radii[joint];
+    spheres.push_back(sphere);
+  }
 }
 
-Image ModelDrawer::makeScreenshot()
+bool ModelDrawer::isMeshVisible(size_t mesh_idx) const
 {
-  // Get the viewport size.
-  GLint viewport[4];
-  glGetIntegerv(GL_VIEWPORT, viewport);
-
-  Image image(viewport[2], viewport[3], Image::Format::RGB);
-
-  glPixelStorei(GL_PACK_ALIGNMENT, 1);
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-  glReadPixels(0, 0, image.getWidth(), image.getHeight(), GL_RGB,
-      GL_UNSIGNED_BYTE, image.getDataPointer());
-
-  image.flip(true, false);
+  const std::vector<JointSphere>& spheres = joint_spheres_[mesh_idx];
+  if (!camera_ || spheres.empty())
+    return true;
+
+  // Box around the joints' spheres after skinning, in O(joints); without an
+  // action the mesh is drawn in its bind pose.
+  const std::vector<Joint>& joints = model_->getJoints();
+  glm::vec3 min_corner(std::numeric_limits<float>::max());
+  glm::vec3 max_corner(-std::numeric_limits<float>::max());
+  for (const JointSphere& sphere : spheres)
+  {
+    glm::vec3 center = sphere.center;
+    float radius = sphere.radius;
+    if (action_started_)
+    {
+      glm::mat4 skinning = joint_transformations_[sphere.joint] *
+                           joints[sphere.joint].getInverseBindPoseMatrix();
+      center = glm::vec3(skinning * glm::vec4(center, 1.f));
+      radius *= std::sqrt(std::max(glm::dot(skinning[0], skinning[0]),
+          std::max(glm::dot(skinning[1], skinning[1]),
+              glm::dot(skinning[2], skinning[2]))));
+    }
+    min_corner = glm::min(min_corner, center - radius);
+    max_corner = glm::max(max_corner, center + radius);
+  }
 
-  return image;
+  // Sphere around the box in world space.
+  float scale = std::sqrt(std::max(glm::dot(model_mat_[0], model_mat_[0]),
+      std::max(glm::dot(model_mat_[1], model_mat_[1]),
+          glm::dot(model_mat_[2], model_mat_[2]))));
+  glm::vec4 center =
+      model_mat_ * glm::vec4(0.5f * (min_corner + max_corner), 1.f);
+  float radius = 0.5f * glm::length(max_corner - min_corner) * scale;
+
+  // Frustum planes from the rows of proj * view (Gribb/Hartmann); the
+  // sphere is culled when it lies fully outside one of them.
+  glm::mat4 clip = camera_->getProjMatrix() * camera_->getViewMatrix();
+  glm::vec4 row[4];
+  for (int r = 0; r < 4; r++)
+    row[r] = glm::vec4(clip[0][r], clip[1][r], clip[2][r], clip[3][r]);
+  for (int axis = 0; axis < 3; axis++)
+  {
+    for (float sign = -1.f; sign <= 1.f; sign += 2.f)
+    {
+      glm::vec4 plane = row[3] + sign * row[axis];
+      float distance = glm::dot(plane, center);
+      if (distance < -radius * glm::length(glm::vec3(plane)))
+        return false;
+    }
+  }
+  return true;
 }
 
-void ModelDrawer::exportJointTransformations(const std::string& filename)
+void ModelDrawer::calcVertexTriangleAdjacency(const Mesh& mesh,
+    std::vector<size_t>& offsets,
+    std::vector<size_t>& triangles)
 {
-  std::ofstream file;
-
-  file.open(filename.c_str(), std::ios::out | std::ios::binary);
-
-  if (!file.is_open())
+  const std::vector<glm::ivec3>& mesh_triangles = mesh.getTriangles();
+  offsets.assign(mesh.getVertexCount() + 1, 0);
+  for (const glm::ivec3& triangle : mesh_triangles)
   {
-    cerr << "Could not open output file for exporting joint transformations."
-         << endl;
+    for (int corner = 0; corner < 3; corner++)
+      offsets[triangle[corner] + 1]++;
   }
+  for (size_t v_idx = 1; v_idx < offsets.size(); v_idx++)
+    offsets[v_idx] += offsets[v_idx - 1];
 
-  for (size_t joint_index = 0; joint_index < joint_transformations_.size();
-       joint_index++)
+  std::vector<size_t> fill(offsets.begin(), offsets.end() - 1);
+  triangles.resize(offsets.back());
+  for (size_t t_idx = 0; t_idx < mesh_triangles.size(); t_idx++)
   {
-    int joint_id = static_cast<int>(joint_index);
-    file.write(reinterpret_cast<const char*>(&joint_id), sizeof(joint_id));
-    file.write(reinterpret_cast<char*>(&joint_transformations_[joint_index]),
-        sizeof(glm::mat4));
+    for (int corner = 0; corner < 3; corner++)
+      triangles[fill[mesh_triangles[t_idx][corner]]++] = t_idx;
   }
-  file.close();
 }
 
-void ModelDrawer::importJointTransformations(const std::string& filename)
+Image ModelDrawer::makeScreenshot()
 {
-  std::ifstream file;
+  PROFILE_ZONE("makeScreenshot");
 
-  file.open(filename.c_str(), std::ios::in | std::ios::binary);
+  // Get the viewport size.
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
 
-  if (!file.is_open())
-  {
-    cerr << "Could not open input file for importing joint transformations."
-         << endl;
-  }
+  Image image(viewport[2], viewport[3], Image::Format::RGB);
 
-  while (!file.eof())
-  {
-    int joint_id;
-    glm::mat4 transformation;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, image.getWidth(), image.getHeight(), GL_RGB,
+      GL_UNSIGNED_BYTE, image.getDataPointer());
 
-    file.read(reinterpret_cast<char*>(&joint_id), sizeof(joint_id));
-    file.read(reinterpret_cast<char*>(&transformation), sizeof(glm::mat4));
+  image.flip(true, false);
 
-    joint_transformations_[static_cast<size_t>(joint_id)] = transformation;
-  }
-  file.close();
+  return image;
 }
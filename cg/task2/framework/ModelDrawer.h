@@ -14,7 +14,11 @@
 #include <string>
 #include "IModelDrawer.h"
 #include "GLBuffer.h"
+#include "VertexArray.h"
+#include "MeshBatch.h"
+#include "Shader.h"
 #include "Mesh.h"
+#include "VertexPacking.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
@@ -32,39 +36,103 @@ public:
   void draw();
   void drawJoints();
   void drawBones();
-  void startAction(size_t action);
-  void update(float time);
   Image makeScreenshot();
 
-  void importJointTransformations(const std::string& filename);
-
 private:
-  std::map<size_t, GLBuffer*> vertex_vbos_;
-  std::map<size_t, GLBuffer*> normal_vbos_;
-  std::map<size_t, GLBuffer*> triangle_ibos_;
+  // Screen-space size, as a fraction of half the viewport height, below
+  // which the model drops to the next coarser LOD.
+  const static float LOD_FULL_DETAIL_SIZE;
+
+  // Batch ranges and skinning state exist once per mesh LOD ("slot");
+  // lod_slots_[mesh][level] maps a mesh LOD to its slot.
+  std::vector<std::vector<size_t>> lod_slots_;
+  size_t lod_level_;
+  size_t max_lod_level_;
+  // Bind-pose sphere around the vertices one joint influences. Skinning
+  // blends the joints' transforms, so the transformed spheres of a mesh
+  // bound its animated vertices.
+  struct JointSphere
+  {
+    size_t joint;
+    glm::vec3 center;
+    float radius;
+  };
+  // Per mesh, from its full-detail LOD which holds every vertex of the
+  // coarser ones.
+  std::vector<std::vector<JointSphere>> joint_spheres_;
+  std::vector<bool> mesh_culled_;
+
+  // All mesh LODs in one vertex and index pool, drawn by material.
+  MeshBatch batch_;
+  // One vertex layout per ring slot of the pool, since the slot offset is
+  // baked into the attribute pointers. Empty when VAOs aren't available.
+  std::vector<VertexArray*> vertex_arrays_;
+  // Per-frame glyph streams. With instancing they hold one GlyphInstance per
+  // joint/bone, otherwise the glyphs expanded on the CPU.
   GLBuffer* joints_vbo_;
   GLBuffer* bones_vbo_;
-  glm::mat4 model_mat_;
-  glm::mat4 normal_mat_;
+  GLBuffer* joint_glyph_vbo_;
+  GLBuffer* bone_glyph_vbo_;
+  bool use_instancing_;
 
-  std::vector<glm::mat4> joint_transformations_;
   std::vector<glm::mat4> joint_translations_;
   size_t bone_count_;
 
+  // Skinned positions stay in client memory because the normal pass reads
+  // them back; the interleaved position/normal stream is written straight
+  // into the mapped ring buffer slot.
   std::vector<std::vector<glm::vec3>> vertices_;
-  std::vector<std::vector<glm::vec3>> normals_;
+  std::vector<std::vector<glm::vec3>> face_normals_;
+  std::vector<std::vector<size_t>> vertex_triangle_offsets_;
+  std::vector<std::vector<size_t>> vertex_triangles_;
+  // Draw at which a slot's face normals were last computed, see
+  // AnimationQuality::normal_interval.
+  std::vector<size_t> normals_draw_;
+  size_t draw_cnt_;
 
-  bool action_started_;
-  size_t curr_action_;
+  // The mesh stream holds PackedVertex when mesh_shader_ is available, and
+  // interleaved float positions/normals through shader_ otherwise.
+  bool use_packed_vertices_;
+  Shader* mesh_program_;
+  Shader::Attrib mesh_position_attrib_;
+  Shader::Attrib mesh_normal_attrib_;
+  Shader::Uniform mesh_model_mat_uniform_;
+  Shader::Uniform mesh_normal_mat_uniform_;
+  Shader::Uniform mesh_diffuse_uniform_;
+  Shader::Uniform position_center_uniform_;
+  Shader::Uniform position_extent_uniform_;
 
-  GLBuffer* genVertexVBO(const Mesh& mesh);
-  GLBuffer* genNormalVBO(const Mesh& mesh);
-  GLBuffer* genTriangleIBO(const Mesh& mesh);
-  GLBuffer* genJointsVBO();
-  GLBuffer* genBonesVBO();
-  size_t calcBoneCount();
+  Shader::Attrib position_attrib_;
+  Shader::Attrib normal_attrib_;
+  Shader::Uniform model_mat_uniform_;
+  Shader::Uniform normal_mat_uniform_;
+  Shader::Uniform mat_diffuse_uniform_;
+  Shader::Attrib glyph_position_attrib_;
+  Shader::Attrib glyph_normal_attrib_;
+  Shader::Attrib instance_mat_attrib_;
+  Shader::Attrib instance_normal_mat_attrib_;
+  Shader::Uniform glyph_model_mat_uniform_;
+  Shader::Uniform glyph_normal_mat_uniform_;
+  Shader::Uniform glyph_mat_diffuse_uniform_;
 
-  void exportJointTransformations(const std::string& filename);
+  size_t getStreamStride() const;
+  void setMeshAttribPointers(size_t stream_offset);
+  std::vector<VertexArray*> genVertexArrays(GLBuffer* stream_vbo,
+      GLBuffer* triangle_ibo);
+  GLBuffer* genGlyphStreamVBO(size_t instance_cnt, size_t vertex_cnt);
+  GLBuffer* genGlyphVBO(const std::vector<glm::vec3>& vertices);
+  void drawGlyphs(GLBuffer* glyph_vbo,
+      GLBuffer* stream_vbo,
+      size_t stream_offset,
+      size_t vertex_cnt,
+      size_t instance_cnt);
+  size_t calcBoneCount();
+  size_t calcLodLevel() const;
+  void calcJointSpheres(const Mesh& mesh, std::vector<JointSphere>& spheres);
+  bool isMeshVisible(size_t mesh_idx) const;
+  void calcVertexTriangleAdjacency(const Mesh& mesh,
+      std::vector<size_t>& offsets,
+      std::vector<size_t>& triangles);
 };
 
 #endif /* MODELDRAWER_H_ */
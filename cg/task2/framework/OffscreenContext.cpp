@@ -0,0 +1,255 @@
+#include "OffscreenContext.h"
+#include <GL/gl3w.h>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_EGL
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+using std::cout;
+using std::endl;
+
+#ifdef HAVE_EGL
+namespace
+{
+bool hasEGLExtension(EGLDisplay display, const char* name)
+{
+  const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions)
+    return false;
+
+  size_t length = std::strlen(name);
+  for (const char* pos = std::strstr(extensions, name); pos;
+       pos = std::strstr(pos + length, name))
+  {
+    bool starts = pos == extensions || pos[-1] == ' ';
+    bool ends = pos[length] == ' ' || pos[length] == '\0';
+    if (starts && ends)
+      return true;
+  }
+  return false;
+}
+
+// Mesa's surfaceless platform needs neither X11 nor a DRM device; other
+// implementations get their default display.
+EGLDisplay openDisplay()
+{
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+  if (hasEGLExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless"))
+  {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+            eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display)
+    {
+      EGLDisplay display = get_platform_display(
+          EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+      if (display != EGL_NO_DISPLAY)
+        return display;
+    }
+  }
+#endif
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+}
+#endif
+
+OffscreenContext::OffscreenContext()
+    : display_(0)
+    , context_(0)
+    , surface_(0)
+    , framebuffer_(0)
+    , color_buffer_(0)
+    , depth_buffer_(0)
+    , width_(0)
+    , height_(0)
+{
+}
+
+OffscreenContext::~OffscreenContext()
+{
+  destroy();
+}
+
+bool OffscreenContext::create(int width, int height)
+{
+  destroy();
+  width_ = width;
+  height_ = height;
+
+  if (!createContext())
+  {
+    destroy();
+    return false;
+  }
+
+  if (gl3wInit())
+  {
+    error_ = "could not load the GL functions";
+    destroy();
+    return false;
+  }
+  cout << "Offscreen context: " << glGetString(GL_RENDERER) << ", OpenGL "
+       << glGetString(GL_VERSION) << "." << endl;
+
+  if (!createFramebuffer())
+  {
+    destroy();
+    return false;
+  }
+  return true;
+}
+
+void OffscreenContext::destroy()
+{
+#ifdef HAVE_EGL
+  if (!display_)
+    return;
+
+  if (context_)
+  {
+    if (framebuffer_)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, 0);
+      glDeleteFramebuffers(1, &framebuffer_);
+      glDeleteRenderbuffers(1, &color_buffer_);
+      glDeleteRenderbuffers(1, &depth_buffer_);
+    }
+    eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display_, context_);
+  }
+  if (surface_)
+    eglDestroySurface(display_, surface_);
+  eglTerminate(display_);
+#endif
+
+  display_ = 0;
+  context_ = 0;
+  surface_ = 0;
+  framebuffer_ = 0;
+  color_buffer_ = 0;
+  depth_buffer_ = 0;
+}
+
+int OffscreenContext::getWidth() const
+{
+  return width_;
+}
+
+int OffscreenContext::getHeight() const
+{
+  return height_;
+}
+
+const std::string& OffscreenContext::getError() const
+{
+  return error_;
+}
+
+bool OffscreenContext::createContext()
+{
+#ifdef HAVE_EGL
+  EGLDisplay display = openDisplay();
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, 0, 0))
+  {
+    error_ = "no EGL display";
+    return false;
+  }
+  display_ = display;
+
+  if (!eglBindAPI(EGL_OPENGL_API))
+  {
+    error_ = "the EGL display does not support desktop OpenGL";
+    return false;
+  }
+
+  // The default framebuffer is never drawn to, the config only has to allow
+  // an OpenGL context and the pbuffer fallback below.
+  const EGLint config_attribs[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE};
+  EGLConfig config;
+  EGLint config_cnt = 0;
+  if (!eglChooseConfig(display, config_attribs, &config, 1, &config_cnt) ||
+      config_cnt == 0)
+  {
+    error_ = "no EGL config for OpenGL";
+    return false;
+  }
+
+  // No version is requested, which yields a compatibility profile like the
+  // 2.1 context of the window.
+  context_ = eglCreateContext(display, config, EGL_NO_CONTEXT, 0);
+  if (context_ == EGL_NO_CONTEXT)
+  {
+    context_ = 0;
+    error_ = "could not create the EGL context";
+    return false;
+  }
+
+  if (hasEGLExtension(display, "EGL_KHR_surfaceless_context") &&
+      eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context_))
+    return true;
+
+  // Without surfaceless contexts a tiny pbuffer stands in; the framebuffer
+  // object is still what gets rendered to.
+  const EGLint pbuffer_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+  surface_ = eglCreatePbufferSurface(display, config, pbuffer_attribs);
+  if (surface_ == EGL_NO_SURFACE)
+  {
+    surface_ = 0;
+    error_ = "could not create an EGL pbuffer";
+    return false;
+  }
+  if (!eglMakeCurrent(display, surface_, surface_, context_))
+  {
+    error_ = "could not make the EGL context current";
+    return false;
+  }
+  return true;
+#else
+  error_ = "built without EGL support";
+  return false;
+#endif
+}
+
+bool OffscreenContext::createFramebuffer()
+{
+  if (!glGenFramebuffers || !glRenderbufferStorage)
+  {
+    error_ = "framebuffer objects are not supported";
+    return false;
+  }
+
+  cout << "Creating offscreen framebuffer (" << width_ << "x" << height_
+       << ")." << endl;
+  glGenRenderbuffers(1, &color_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_buffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+  glGenRenderbuffers(1, &depth_buffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_buffer_);
+  glRenderbufferStorage(
+      GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer_);
+  glFramebufferRenderbuffer(
+      GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer_);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    error_ = "the offscreen framebuffer is incomplete";
+    return false;
+  }
+
+  // Reads (screenshots) and draws both go to the color attachment.
+  glDrawBuffer(GL_COLOR_ATTACHMENT0);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glViewport(0, 0, width_, height_);
+  return true;
+}
@@ -0,0 +1,44 @@
+#ifndef OFFSCREENCONTEXT_H
+#define OFFSCREENCONTEXT_H
+
+#include <string>
+
+// GL context without a window for batch rendering. It runs on an EGL display
+// of Mesa's surfaceless platform when available (llvmpipe when no GPU is
+// present) and renders into a framebuffer object of a fixed size, so there is
+// no swap interval and no event queue. Only built with EGL support
+// (HAVE_EGL); create() fails otherwise.
+class OffscreenContext
+{
+public:
+  OffscreenContext();
+  ~OffscreenContext();
+
+  // Creates the context, makes it current, loads the GL functions and binds
+  // a width x height RGBA8 / DEPTH24 framebuffer.
+  bool create(int width, int height);
+  void destroy();
+
+  int getWidth() const;
+  int getHeight() const;
+  const std::string& getError() const;
+
+private:
+  void* display_;
+  void* context_;
+  void* surface_;
+  unsigned framebuffer_;
+  unsigned color_buffer_;
+  unsigned depth_buffer_;
+  int width_;
+  int height_;
+  std::string error_;
+
+  bool createContext();
+  bool createFramebuffer();
+
+  OffscreenContext(const OffscreenContext&);
+  OffscreenContext& operator=(const OffscreenContext&);
+};
+
+#endif // OFFSCREENCONTEXT_H
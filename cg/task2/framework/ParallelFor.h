@@ -0,0 +1,38 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Runs task(0) .. task(count - 1) on up to thread_count threads, the calling
+// thread included. Indices are handed out one at a time, so uneven tasks
+// balance themselves.
+template <typename Task>
+void parallelFor(size_t count, unsigned thread_count, const Task& task)
+{
+  thread_count = static_cast<unsigned>(
+      std::min<size_t>(std::max(thread_count, 1u), count));
+  if (thread_count <= 1)
+  {
+    for (size_t i = 0; i < count; i++)
+      task(i);
+    return;
+  }
+
+  std::atomic<size_t> next(0);
+  auto worker = [&]()
+  {
+    for (size_t i = next++; i < count; i = next++)
+      task(i);
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < thread_count; i++)
+    threads.push_back(std::thread(worker));
+  worker();
+  for (std::thread& thread : threads)
+    thread.join();
+}
+
+#endif // PARALLELFOR_H
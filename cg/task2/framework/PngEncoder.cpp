@@ -0,0 +1,394 @@
+#include "PngEncoder.h"
+#include "ParallelFor.h"
+#include <zlib.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+const size_t DICTIONARY_SIZE = 32768;
+// Below this many filtered bytes per chunk the lost matches at the chunk
+// seams cost more than the parallelism gains.
+const size_t MIN_CHUNK_SIZE = 256 * 1024;
+
+const unsigned char SIGNATURE[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+enum FilterType
+{
+  FILTER_NONE, FILTER_SUB, FILTER_UP, FILTER_AVERAGE, FILTER_PAETH,
+  FILTER_TYPE_CNT
+};
+
+struct Throughput
+{
+  double byte_count;
+  double seconds;
+};
+
+const int PROFILE_CNT = 3;
+Throughput throughput[PROFILE_CNT] = {{0, 0}, {0, 0}, {0, 0}};
+std::mutex throughput_mutex;
+
+unsigned char paeth(int a, int b, int c)
+{
+  int p = a + b - c;
+  int pa = std::abs(p - a);
+  int pb = std::abs(p - b);
+  int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return static_cast<unsigned char>(a);
+  if (pb <= pc)
+    return static_cast<unsigned char>(b);
+  return static_cast<unsigned char>(c);
+}
+
+// Filters one scanline into out (row_size bytes, without the type byte).
+// prev is the unfiltered previous row, or null for the first row.
+void filterRow(FilterType type,
+    const unsigned char* row,
+    const unsigned char* prev,
+    size_t row_size,
+    int bpp,
+    unsigned char* out)
+{
+  for (size_t i = 0; i < row_size; i++)
+  {
+    int a = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+    int b = prev ? prev[i] : 0;
+    int c = prev && i >= static_cast<size_t>(bpp) ? prev[i - bpp] : 0;
+    switch (type)
+    {
+    case FILTER_SUB:
+      out[i] = static_cast<unsigned char>(row[i] - a);
+      break;
+    case FILTER_UP:
+      out[i] = static_cast<unsigned char>(row[i] - b);
+      break;
+    case FILTER_AVERAGE:
+      out[i] = static_cast<unsigned char>(row[i] - ((a + b) >> 1));
+      break;
+    case FILTER_PAETH:
+      out[i] = static_cast<unsigned char>(row[i] - paeth(a, b, c));
+      break;
+    case FILTER_NONE:
+    default:
+      out[i] = row[i];
+      break;
+    }
+  }
+}
+
+// Sum of the filtered bytes read as signed values, the usual heuristic for
+// how well a row will compress.
+size_t filterCost(const unsigned char* data, size_t size)
+{
+  size_t cost = 0;
+  for (size_t i = 0; i < size; i++)
+    cost += std::abs(static_cast<signed char>(data[i]));
+  return cost;
+}
+
+void filterRow(Image::FilterStrategy strategy,
+    const unsigned char* row,
+    const unsigned char* prev,
+    size_t row_size,
+    int bpp,
+    unsigned char* out,
+    std::vector<unsigned char>& scratch)
+{
+  FilterType type = FILTER_NONE;
+  switch (strategy)
+  {
+  case Image::FilterStrategy::SUB:
+    type = FILTER_SUB;
+    break;
+  case Image::FilterStrategy::UP:
+    type = FILTER_UP;
+    break;
+  case Image::FilterStrategy::AVERAGE:
+    type = FILTER_AVERAGE;
+    break;
+  case Image::FilterStrategy::PAETH:
+    type = FILTER_PAETH;
+    break;
+  case Image::FilterStrategy::ADAPTIVE:
+  {
+    scratch.resize(row_size);
+    size_t best_cost = ~static_cast<size_t>(0);
+    for (int candidate = 0; candidate < FILTER_TYPE_CNT; candidate++)
+    {
+      filterRow(static_cast<FilterType>(candidate), row, prev, row_size, bpp,
+          &scratch[0]);
+      size_t cost = filterCost(&scratch[0], row_size);
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        type = static_cast<FilterType>(candidate);
+      }
+    }
+    break;
+  }
+  case Image::FilterStrategy::NONE:
+  default:
+    break;
+  }
+
+  out[0] = static_cast<unsigned char>(type);
+  filterRow(type, row, prev, row_size, bpp, out + 1);
+}
+
+struct DeflateChunk
+{
+  std::vector<unsigned char> data;
+  uLong adler;
+  size_t input_size;
+  int result;
+};
+
+void deflateChunk(const unsigned char* filtered,
+    size_t begin,
+    size_t end,
+    bool last,
+    int level,
+    DeflateChunk& chunk)
+{
+  chunk.input_size = end - begin;
+  chunk.adler = adler32(0L, Z_NULL, 0);
+  chunk.adler = adler32(chunk.adler, filtered + begin,
+      static_cast<uInt>(chunk.input_size));
+
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  chunk.result = deflateInit2(
+      &stream, level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+  if (chunk.result != Z_OK)
+    return;
+
+  if (begin > 0 && level > 0)
+  {
+    size_t dictionary_size = std::min(begin, DICTIONARY_SIZE);
+    deflateSetDictionary(&stream, filtered + begin - dictionary_size,
+        static_cast<uInt>(dictionary_size));
+  }
+
+  // The bound covers the finishing block, the extra bytes the empty stored
+  // block of a sync flush.
+  chunk.data.resize(deflateBound(&stream, static_cast<uLong>(chunk.input_size))
+      + 16);
+  stream.next_in = const_cast<Bytef*>(filtered + begin);
+  stream.avail_in = static_cast<uInt>(chunk.input_size);
+  stream.next_out = &chunk.data[0];
+  stream.avail_out = static_cast<uInt>(chunk.data.size());
+
+  chunk.result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH);
+  if (chunk.result == Z_STREAM_END || (chunk.result == Z_OK && !last))
+    chunk.result = stream.avail_in == 0 ? Z_OK : Z_BUF_ERROR;
+  else if (chunk.result == Z_OK)
+    chunk.result = Z_BUF_ERROR;
+  chunk.data.resize(chunk.data.size() - stream.avail_out);
+  deflateEnd(&stream);
+}
+
+void putUint32(unsigned char* out, uLong value)
+{
+  out[0] = static_cast<unsigned char>((value >> 24) & 0xff);
+  out[1] = static_cast<unsigned char>((value >> 16) & 0xff);
+  out[2] = static_cast<unsigned char>((value >> 8) & 0xff);
+  out[3] = static_cast<unsigned char>(value & 0xff);
+}
+
+void writePngChunk(std::ofstream& file,
+    const char* type,
+    const unsigned char* data,
+    size_t size)
+{
+  unsigned char header[8];
+  putUint32(header, static_cast<uLong>(size));
+  std::memcpy(header + 4, type, 4);
+
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, header + 4, 4);
+  if (size)
+    crc = crc32(crc, data, static_cast<uInt>(size));
+  unsigned char footer[4];
+  putUint32(footer, crc);
+
+  file.write(reinterpret_cast<const char*>(header), 8);
+  if (size)
+    file.write(reinterpret_cast<const char*>(data), size);
+  file.write(reinterpret_cast<const char*>(footer), 4);
+}
+}
+
+PngEncoder::Settings PngEncoder::getProfileSettings(
+    Image::EncoderProfile profile)
+{
+  Settings settings;
+  settings.thread_count = 0;
+  switch (profile)
+  {
+  case Image::EncoderProfile::STORE:
+    settings.level = 0;
+    settings.filter = Image::FilterStrategy::NONE;
+    break;
+  case Image::EncoderProfile::BEST:
+    settings.level = 9;
+    settings.filter = Image::FilterStrategy::ADAPTIVE;
+    break;
+  case Image::EncoderProfile::FAST:
+  default:
+    settings.level = 1;
+    settings.filter = Image::FilterStrategy::SUB;
+    break;
+  }
+  return settings;
+}
+
+bool PngEncoder::encode(const std::string& file_name,
+    const unsigned char* pixels,
+    int width,
+    int height,
+    int component_count,
+    const Settings& settings,
+    std::string& error)
+{
+  if (width <= 0 || height <= 0 ||
+      (component_count != 3 && component_count != 4))
+  {
+    error = "Unsupported image layout.";
+    return false;
+  }
+
+  unsigned thread_count = settings.thread_count;
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+
+  const size_t row_size = static_cast<size_t>(width) * component_count;
+  const size_t filtered_row_size = row_size + 1;
+  std::vector<unsigned char> filtered(filtered_row_size * height);
+
+  // Rows only depend on the unfiltered previous row, so they filter in any
+  // order.
+  const size_t rows_per_band = 64;
+  const size_t band_count = (height + rows_per_band - 1) / rows_per_band;
+  parallelFor(band_count, thread_count, [&](size_t band)
+  {
+    std::vector<unsigned char> scratch;
+    size_t row_end = std::min((band + 1) * rows_per_band,
+        static_cast<size_t>(height));
+    for (size_t row = band * rows_per_band; row < row_end; row++)
+    {
+      const unsigned char* prev = row ? pixels + (row - 1) * row_size : 0;
+      filterRow(settings.filter, pixels + row * row_size, prev, row_size,
+          component_count, &filtered[row * filtered_row_size], scratch);
+    }
+  });
+
+  size_t chunk_count = 1;
+  if (thread_count > 1)
+    chunk_count = std::max<size_t>(filtered.size() / MIN_CHUNK_SIZE, 1);
+  size_t rows_per_chunk = (height + chunk_count - 1) / chunk_count;
+  chunk_count = (height + rows_per_chunk - 1) / rows_per_chunk;
+
+  std::vector<DeflateChunk> chunks(chunk_count);
+  parallelFor(chunk_count, thread_count, [&](size_t index)
+  {
+    size_t begin = index * rows_per_chunk * filtered_row_size;
+    size_t end = std::min(begin + rows_per_chunk * filtered_row_size,
+        filtered.size());
+    deflateChunk(&filtered[0], begin, end, index + 1 == chunk_count,
+        settings.level, chunks[index]);
+  });
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (const DeflateChunk& chunk : chunks)
+  {
+    if (chunk.result != Z_OK)
+    {
+      std::stringstream ss;
+      ss << "Deflate error (" << chunk.result << ").";
+      error = ss.str();
+      return false;
+    }
+    adler = adler32_combine(adler, chunk.adler,
+        static_cast<z_off_t>(chunk.input_size));
+  }
+
+  std::ofstream file(file_name.c_str(), std::ios::out | std::ios::binary);
+  if (!file.is_open())
+  {
+    error = "Could not open " + file_name + " for writing.";
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(SIGNATURE), sizeof(SIGNATURE));
+
+  unsigned char ihdr[13];
+  putUint32(ihdr, width);
+  putUint32(ihdr + 4, height);
+  ihdr[8] = 8;
+  ihdr[9] = component_count == 4 ? 6 : 2;
+  ihdr[10] = 0;
+  ihdr[11] = 0;
+  ihdr[12] = 0;
+  writePngChunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+  // zlib header with the level hint, padded to a multiple of 31.
+  int level_hint = settings.level < 2 ? 0 : settings.level < 6 ? 1
+                 : settings.level == 6 ? 2 : 3;
+  unsigned char zlib_header[2] = {0x78,
+      static_cast<unsigned char>(level_hint << 6)};
+  zlib_header[1] += 31 - ((zlib_header[0] << 8) + zlib_header[1]) % 31;
+  writePngChunk(file, "IDAT", zlib_header, sizeof(zlib_header));
+
+  for (const DeflateChunk& chunk : chunks)
+    writePngChunk(file, "IDAT", chunk.data.empty() ? 0 : &chunk.data[0],
+        chunk.data.size());
+
+  unsigned char zlib_footer[4];
+  putUint32(zlib_footer, adler);
+  writePngChunk(file, "IDAT", zlib_footer, sizeof(zlib_footer));
+  writePngChunk(file, "IEND", 0, 0);
+
+  if (!file)
+  {
+    error = "Could not write " + file_name + ".";
+    return false;
+  }
+  return true;
+}
+
+void PngEncoder::recordThroughput(Image::EncoderProfile profile,
+    size_t byte_count,
+    double seconds)
+{
+  std::lock_guard<std::mutex> lock(throughput_mutex);
+  Throughput& entry = throughput[static_cast<int>(profile)];
+  entry.byte_count += byte_count;
+  entry.seconds += seconds;
+}
+
+std::string PngEncoder::getStatistics()
+{
+  static const char* PROFILE_NAMES[PROFILE_CNT] = {"store", "fast", "best"};
+
+  std::lock_guard<std::mutex> lock(throughput_mutex);
+  std::stringstream ss;
+  for (int profile = 0; profile < PROFILE_CNT; profile++)
+  {
+    const Throughput& entry = throughput[profile];
+    if (entry.seconds <= 0.0)
+      continue;
+    ss << "PNG " << PROFILE_NAMES[profile] << ": "
+       << entry.byte_count / (1024.0 * 1024.0) / entry.seconds << " MB/s ("
+       << entry.byte_count / (1024.0 * 1024.0) << " MB in " << entry.seconds
+       << " s)" << std::endl;
+  }
+  return ss.str();
+}
@@ -0,0 +1,41 @@
+#ifndef PNGENCODER_H
+#define PNGENCODER_H
+
+#include <string>
+#include "Image.h"
+
+// Writes 8 bit RGB/RGBA PNGs through zlib. Large images are split into row
+// chunks that are deflated on separate threads; every chunk ends on a byte
+// boundary (sync flush) and is primed with the 32 KiB preceding it, so the
+// concatenation is one ordinary zlib stream and the file stays standard PNG.
+class PngEncoder
+{
+public:
+  struct Settings
+  {
+    int level;
+    Image::FilterStrategy filter;
+    unsigned thread_count;
+  };
+
+  static Settings getProfileSettings(Image::EncoderProfile profile);
+
+  static bool encode(const std::string& file_name,
+      const unsigned char* pixels,
+      int width,
+      int height,
+      int component_count,
+      const Settings& settings,
+      std::string& error);
+
+  // Throughput of every encode so far, in uncompressed MB/s per profile.
+  static void recordThroughput(Image::EncoderProfile profile,
+      size_t byte_count,
+      double seconds);
+  static std::string getStatistics();
+
+private:
+  PngEncoder();
+};
+
+#endif // PNGENCODER_H
@@ -0,0 +1,214 @@
+#include "Profiler.h"
+#include "GLCapabilities.h"
+#include <GL/gl3w.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <set>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+const size_t RING_SIZE = 1 << 16;
+// Chrome trace thread id of the GPU timeline, CPU threads count from 1.
+const unsigned GPU_THREAD = 0;
+
+struct Event
+{
+  const char* name;
+  long long start_ns;
+  long long duration_ns;
+  unsigned thread;
+};
+
+struct GpuZone
+{
+  const char* name;
+  GLuint queries[2];
+};
+
+std::vector<Event> ring;
+std::atomic<size_t> next_event(0);
+std::atomic<unsigned> next_thread(1);
+const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+// GPU zones are only touched on the GL thread.
+bool timer_queries_checked = false;
+bool timer_queries_available = false;
+long long gpu_offset_ns = 0;
+std::vector<GpuZone> open_gpu_zones;
+std::deque<GpuZone> pending_gpu_zones;
+std::vector<GLuint> free_queries;
+
+unsigned threadId()
+{
+  static thread_local unsigned id = next_thread++;
+  return id;
+}
+
+void record(const char* name,
+    long long start_ns,
+    long long duration_ns,
+    unsigned thread)
+{
+  Event& event = ring[next_event++ % RING_SIZE];
+  event.name = name;
+  event.start_ns = start_ns;
+  event.duration_ns = duration_ns;
+  event.thread = thread;
+}
+
+bool hasTimerQueries()
+{
+  if (!timer_queries_checked)
+  {
+    timer_queries_checked = true;
+    timer_queries_available =
+        (GLCapabilities::hasVersion(3, 3) ||
+            GLCapabilities::hasExtension("GL_ARB_timer_query")) &&
+        glQueryCounter && glGetQueryObjectui64v && glGetInteger64v;
+    if (timer_queries_available)
+    {
+      // Maps GL timestamps onto the CPU timeline of the trace.
+      GLint64 gpu_now = 0;
+      glGetInteger64v(GL_TIMESTAMP, &gpu_now);
+      gpu_offset_ns = Profiler::now() - gpu_now;
+    }
+    cout << "GPU profiling zones "
+         << (timer_queries_available ? "use timer queries."
+                                     : "are unavailable.")
+         << endl;
+  }
+  return timer_queries_available;
+}
+
+GLuint allocateQuery()
+{
+  if (free_queries.empty())
+  {
+    GLuint queries[16];
+    glGenQueries(16, queries);
+    free_queries.insert(free_queries.end(), queries, queries + 16);
+  }
+  GLuint query = free_queries.back();
+  free_queries.pop_back();
+  return query;
+}
+}
+
+bool Profiler::enabled_ = false;
+
+void Profiler::setEnabled(bool enabled)
+{
+  if (enabled && ring.empty())
+  {
+    cout << "Allocating profiler ring for " << RING_SIZE << " zones." << endl;
+    ring.resize(RING_SIZE);
+  }
+  enabled_ = enabled;
+}
+
+void Profiler::beginFrame()
+{
+  // Zones finish in submission order, so the first one still in flight ends
+  // the collection.
+  while (!pending_gpu_zones.empty())
+  {
+    GpuZone& zone = pending_gpu_zones.front();
+    GLuint available = 0;
+    glGetQueryObjectuiv(zone.queries[1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+
+    GLuint64 start = 0;
+    GLuint64 end = 0;
+    glGetQueryObjectui64v(zone.queries[0], GL_QUERY_RESULT, &start);
+    glGetQueryObjectui64v(zone.queries[1], GL_QUERY_RESULT, &end);
+    if (enabled_)
+      record(zone.name, static_cast<long long>(start) + gpu_offset_ns,
+          static_cast<long long>(end - start), GPU_THREAD);
+
+    free_queries.push_back(zone.queries[0]);
+    free_queries.push_back(zone.queries[1]);
+    pending_gpu_zones.pop_front();
+  }
+}
+
+void Profiler::beginZone(const char* name, bool gpu)
+{
+  if (!gpu || !hasTimerQueries())
+    return;
+
+  GpuZone zone;
+  zone.name = name;
+  zone.queries[0] = allocateQuery();
+  zone.queries[1] = allocateQuery();
+  glQueryCounter(zone.queries[0], GL_TIMESTAMP);
+  open_gpu_zones.push_back(zone);
+}
+
+void Profiler::endZone(const char* name, bool gpu, long long start_ns)
+{
+  record(name, start_ns, now() - start_ns, threadId());
+
+  if (!gpu || open_gpu_zones.empty())
+    return;
+
+  GpuZone zone = open_gpu_zones.back();
+  open_gpu_zones.pop_back();
+  glQueryCounter(zone.queries[1], GL_TIMESTAMP);
+  pending_gpu_zones.push_back(zone);
+}
+
+long long Profiler::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - epoch).count();
+}
+
+bool Profiler::writeChromeTrace(const std::string& file_name)
+{
+  std::ofstream out(file_name.c_str());
+  if (!out)
+    return false;
+
+  size_t end = next_event;
+  size_t count = std::min(end, ring.size());
+  std::set<unsigned> threads;
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [" << std::fixed
+      << std::setprecision(3);
+  for (size_t i = end - count; i < end; i++)
+  {
+    const Event& event = ring[i % RING_SIZE];
+    threads.insert(event.thread);
+    out << (i != end - count ? ",\n" : "\n") << "{\"name\": \"" << event.name
+        << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << event.thread
+        << ", \"ts\": " << event.start_ns / 1000.0
+        << ", \"dur\": " << event.duration_ns / 1000.0 << "}";
+  }
+  for (unsigned thread : threads)
+  {
+    out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+           "\"tid\": "
+        << thread << ", \"args\": {\"name\": \"";
+    if (thread == GPU_THREAD)
+      out << "GPU";
+    else
+      out << "Thread " << thread;
+    out << "\"}}";
+  }
+  out << "\n]}\n";
+
+  cout << "Wrote " << count << " profiling zones to " << file_name << "."
+       << endl;
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,79 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+
+// Scoped timing zones for finding frame spikes. Finished zones go into a
+// fixed-size ring of events, the oldest are overwritten once it is full, and
+// can be written out as a Chrome trace (chrome://tracing, Perfetto). While
+// the profiler is disabled a zone costs a single branch.
+//
+// GPU zones additionally place GL timestamp queries around their commands.
+// The results are collected a few frames later in beginFrame(), so reading
+// them never stalls the pipeline; without timer queries (GL < 3.3 and no
+// ARB_timer_query) GPU zones only time the CPU side.
+class Profiler
+{
+public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  // Call once per frame on the GL thread to collect finished GPU zones.
+  static void beginFrame();
+
+  // Zone names must outlive the profiler, string literals are expected.
+  static void beginZone(const char* name, bool gpu);
+  static void endZone(const char* name, bool gpu, long long start_ns);
+  static long long now();
+
+  static bool writeChromeTrace(const std::string& file_name);
+
+private:
+  static bool enabled_;
+
+  Profiler();
+};
+
+class ProfileZone
+{
+public:
+  explicit ProfileZone(const char* name, bool gpu = false)
+      : name_(name)
+      , gpu_(gpu)
+      , start_ns_(-1)
+  {
+    if (Profiler::isEnabled())
+    {
+      Profiler::beginZone(name_, gpu_);
+      start_ns_ = Profiler::now();
+    }
+  }
+
+  ~ProfileZone()
+  {
+    if (start_ns_ >= 0)
+      Profiler::endZone(name_, gpu_, start_ns_);
+  }
+
+private:
+  const char* name_;
+  bool gpu_;
+  long long start_ns_;
+
+  ProfileZone(const ProfileZone&);
+  ProfileZone& operator=(const ProfileZone&);
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_ZONE(name) \
+  ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define PROFILE_GPU_ZONE(name) \
+  ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(name, true)
+
+inline bool Profiler::isEnabled()
+{
+  return enabled_;
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,142 @@
+#include "ScreenshotCapture.h"
+#include "GLBuffer.h"
+#include "GLState.h"
+#include "Profiler.h"
+#include "Image.h"
+#include "ImageEncoderPool.h"
+#include "VideoSink.h"
+#include <GL/gl3w.h>
+#include <iostream>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+ScreenshotCapture::ScreenshotCapture(ImageEncoderPool& encoder)
+    : encoder_(encoder)
+    , encoder_profile_(Image::EncoderProfile::FAST)
+    , video_sink_(0)
+    , next_(0)
+    , width_(0)
+    , height_(0)
+{
+  for (unsigned i = 0; i < READBACK_COUNT; i++)
+  {
+    readbacks_[i].pbo = 0;
+    readbacks_[i].pending = false;
+  }
+}
+
+ScreenshotCapture::~ScreenshotCapture()
+{
+  for (unsigned i = 0; i < READBACK_COUNT; i++)
+    delete readbacks_[i].pbo;
+}
+
+void ScreenshotCapture::capture(const std::string& file_name)
+{
+  PROFILE_ZONE("ScreenshotCapture::capture");
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLState::countCall();
+  if (viewport[2] != width_ || viewport[3] != height_)
+    resize(viewport[2], viewport[3]);
+
+  Readback& readback = readbacks_[next_];
+  readback.pbo->bind();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width_, height_, GL_RGB, GL_UNSIGNED_BYTE, 0);
+  GLState::countCall(2);
+  readback.pbo->unbind();
+  readback.file_name = file_name;
+  readback.pending = true;
+
+  // The previous frame's transfer has had a whole frame to complete.
+  next_ = (next_ + 1) % READBACK_COUNT;
+  if (readbacks_[next_].pending)
+    resolve(readbacks_[next_]);
+}
+
+void ScreenshotCapture::setEncoderProfile(Image::EncoderProfile profile)
+{
+  encoder_profile_ = profile;
+}
+
+void ScreenshotCapture::setVideoSink(VideoSink* sink)
+{
+  flush();
+  video_sink_ = sink;
+}
+
+void ScreenshotCapture::flush()
+{
+  for (unsigned i = 0; i < READBACK_COUNT; i++)
+  {
+    Readback& readback = readbacks_[(next_ + i) % READBACK_COUNT];
+    if (readback.pending)
+      resolve(readback);
+  }
+  encoder_.wait();
+}
+
+void ScreenshotCapture::resize(int width, int height)
+{
+  flush();
+
+  width_ = width;
+  height_ = height;
+  size_t byte_count = static_cast<size_t>(width_) * height_ * 3;
+  cout << "Allocating screenshot readback buffers (" << width_ << "x"
+       << height_ << ")." << endl;
+  for (unsigned i = 0; i < READBACK_COUNT; i++)
+  {
+    if (!readbacks_[i].pbo)
+    {
+      readbacks_[i].pbo = new GLBuffer(GLBuffer::BufferType::PIXEL_PACK_BUFFER);
+      readbacks_[i].pbo->create();
+    }
+    readbacks_[i].pbo->bind();
+    readbacks_[i].pbo->allocate(byte_count, GLBuffer::Usage::STREAM_READ);
+    readbacks_[i].pbo->unbind();
+  }
+}
+
+void ScreenshotCapture::resolve(Readback& readback)
+{
+  PROFILE_ZONE("ScreenshotCapture::resolve");
+
+  readback.pending = false;
+
+  readback.pbo->bind();
+  void* data = 0;
+  readback.pbo->map(&data, GLBuffer::BufferAccessType::READ);
+  if (!data)
+  {
+    cerr << "Could not map screenshot readback for " << readback.file_name
+         << "." << endl;
+    readback.pbo->unbind();
+    return;
+  }
+
+  if (video_sink_)
+  {
+    if (!video_sink_->writeFrame(
+            static_cast<const unsigned char*>(data), width_, height_, true))
+      cerr << "Could not write video frame: " << video_sink_->getError()
+           << "." << endl;
+    readback.pbo->unmap();
+    readback.pbo->unbind();
+    return;
+  }
+
+  Image* image = new Image(width_, height_, Image::Format::RGB);
+  image->copyRows(static_cast<const unsigned char*>(data), true);
+  // The pool already encodes one image per thread.
+  image->setEncoderProfile(encoder_profile_);
+  image->setEncoderThreadCount(1);
+  readback.pbo->unmap();
+  readback.pbo->unbind();
+
+  encoder_.submit(image, readback.file_name);
+}
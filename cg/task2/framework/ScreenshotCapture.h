@@ -0,0 +1,52 @@
+#ifndef SCREENSHOTCAPTURE_H
+#define SCREENSHOTCAPTURE_H
+
+#include <string>
+#include "Image.h"
+
+class GLBuffer;
+class ImageEncoderPool;
+class VideoSink;
+
+// Reads the framebuffer back through two pixel pack buffers. A frame's
+// glReadPixels only queues the transfer; its pixels are mapped one capture
+// later, when the GPU is done with them, copied bottom-up into an Image and
+// handed to the encoder pool, or written straight from the mapping into a
+// video sink.
+class ScreenshotCapture
+{
+public:
+  ScreenshotCapture(ImageEncoderPool& encoder);
+  ~ScreenshotCapture();
+
+  // Queues a readback of the current viewport to be saved as file_name.
+  void capture(const std::string& file_name);
+  void setEncoderProfile(Image::EncoderProfile profile);
+  // Frames go to the sink instead of image files while it is set.
+  void setVideoSink(VideoSink* sink);
+  // Resolves pending readbacks and waits until all images are written.
+  void flush();
+
+private:
+  static const unsigned READBACK_COUNT = 2;
+
+  struct Readback
+  {
+    GLBuffer* pbo;
+    std::string file_name;
+    bool pending;
+  };
+
+  ImageEncoderPool& encoder_;
+  Readback readbacks_[READBACK_COUNT];
+  Image::EncoderProfile encoder_profile_;
+  VideoSink* video_sink_;
+  unsigned next_;
+  int width_;
+  int height_;
+
+  void resize(int width, int height);
+  void resolve(Readback& readback);
+};
+
+#endif // SCREENSHOTCAPTURE_H
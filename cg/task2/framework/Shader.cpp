@@ -1,7 +1,21 @@
 #include <GL/gl3w.h>
 #include "Shader.h"
+#include "GLState.h"
+#include "GLCapabilities.h"
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 using std::string;
 using std::endl;
@@ -10,6 +24,73 @@ using std::cerr;
 using std::map;
 using std::pair;
 
+namespace
+{
+const char BINARY_MAGIC[4] = {'C', 'G', 'P', 'B'};
+const uint32_t BINARY_VERSION = 1;
+
+struct BinaryHeader
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t format;
+  uint32_t length;
+};
+
+void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 1099511628211ull;
+  }
+}
+
+void hashString(uint64_t& hash, const GLubyte* str)
+{
+  // The terminator keeps "ab" + "c" apart from "a" + "bc".
+  const char* chars = str ? reinterpret_cast<const char*>(str) : "";
+  hashBytes(hash, chars, strlen(chars) + 1);
+}
+}
+
+string Shader::cache_directory_;
+
+Shader::Uniform::Uniform()
+    : location_(-1)
+    , cache_slot_(-1)
+{
+}
+
+bool Shader::Uniform::isValid() const
+{
+  return location_ >= 0;
+}
+
+Shader::Attrib::Attrib()
+    : location_(-1)
+{
+}
+
+bool Shader::Attrib::isValid() const
+{
+  return location_ >= 0;
+}
+
+unsigned int Shader::Attrib::getLocation() const
+{
+  return static_cast<unsigned int>(location_);
+}
+
+Shader::Attrib Shader::Attrib::column(unsigned int index) const
+{
+  Attrib attrib;
+  if (isValid())
+    attrib.location_ = location_ + static_cast<int>(index);
+  return attrib;
+}
+
 Shader::Shader()
     : program_(0)
 {
@@ -20,6 +101,11 @@ Shader::~Shader()
   destroy();
 }
 
+void Shader::setCacheDirectory(const std::string& directory)
+{
+  cache_directory_ = directory;
+}
+
 bool Shader::create()
 {
   program_ = glCreateProgram();
@@ -34,6 +120,16 @@ bool Shader::create()
 }
 
 bool Shader::addShader(Shader::ShaderType type, const std::string& source)
+{
+  if (!cache_directory_.empty() && GLCapabilities::hasProgramBinary())
+  {
+    sources_.push_back(std::make_pair(type, source));
+    return true;
+  }
+  return compileShader(type, source);
+}
+
+bool Shader::compileShader(Shader::ShaderType type, const std::string& source)
 {
   int shaderType = GL_VERTEX_SHADER;
   if (type == FRAGMENT_SHADER)
@@ -58,12 +154,37 @@ bool Shader::addShader(Shader::ShaderType type, const std::string& source)
 
 bool Shader::link()
 {
+  string cache_file;
+  if (!sources_.empty())
+  {
+    cache_file = getCacheFileName();
+    bool loaded = loadProgramBinary(cache_file);
+    bool compiled = true;
+    for (size_t i = 0; i < sources_.size() && !loaded && compiled; i++)
+      compiled = compileShader(sources_[i].first, sources_[i].second);
+    sources_.clear();
+    if (!compiled)
+      return false;
+    if (loaded)
+    {
+      resolveLocations();
+      return true;
+    }
+    glProgramParameteri(program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  }
+
   glLinkProgram(program_);
   if (!checkShaderLink(program_))
   {
+    // destroy() would delete the name a second time.
     glDeleteProgram(program_);
+    program_ = 0;
     return false;
   }
+  // Only a linked program reaches the cache.
+  if (!cache_file.empty())
+    saveProgramBinary(cache_file);
+  resolveLocations();
   return true;
 }
 
@@ -80,58 +201,144 @@ void Shader::destroy()
   {
     glDeleteProgram(program_);
     cout << "Shader Program (" << program_ << ") deleted." << endl;
+    GLState::invalidate();
   }
+  program_ = 0;
 }
 
 void Shader::bind()
 {
-  glUseProgram(program_);
+  GLState::useProgram(program_);
 }
 
 void Shader::unbind()
 {
-  glUseProgram(0);
+  GLState::useProgram(0);
+}
+
+Shader::Uniform Shader::getUniform(const std::string& name) const
+{
+  uniform_map_iter it = uniforms_.find(name);
+  if (it == uniforms_.end())
+    return Uniform();
+  return it->second;
+}
+
+Shader::Attrib Shader::getAttrib(const std::string& name) const
+{
+  attrib_map_iter it = attribs_.find(name);
+  if (it == attribs_.end())
+    return Attrib();
+  return it->second;
+}
+
+void Shader::setUniformMatrix4f(const Uniform& uniform, const glm::mat4& matrix)
+{
+  if (!uniformChanged(uniform, &matrix[0][0], 16))
+    return;
+  glUniformMatrix4fv(uniform.location_, 1, false, &matrix[0][0]);
+  GLState::countCall();
+}
+
+void Shader::setUniform3f(const Uniform& uniform, const glm::vec3& data)
+{
+  if (!uniformChanged(uniform, &data[0], 3))
+    return;
+  glUniform3fv(uniform.location_, 1, &data[0]);
+  GLState::countCall();
+}
+
+void Shader::setUniform4f(const Uniform& uniform, const glm::vec4& data)
+{
+  if (!uniformChanged(uniform, &data[0], 4))
+    return;
+  glUniform4fv(uniform.location_, 1, &data[0]);
+  GLState::countCall();
+}
+
+void Shader::setUniform1i(const Uniform& uniform, int data)
+{
+  float value = static_cast<float>(data);
+  if (!uniformChanged(uniform, &value, 1))
+    return;
+  glUniform1i(uniform.location_, data);
+  GLState::countCall();
+}
+
+void Shader::setAttribPointer(const Attrib& attrib,
+    unsigned int type,
+    int size,
+    int stride,
+    size_t offset,
+    bool normalized)
+{
+  if (!attrib.isValid())
+    return;
+  glVertexAttribPointer(attrib.getLocation(), size, type,
+      normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+  GLState::countCall();
+}
+
+void Shader::enableAttribArray(const Attrib& attrib)
+{
+  if (!attrib.isValid())
+    return;
+  GLState::enableVertexAttribArray(attrib.getLocation());
+}
+
+void Shader::disableAttribArray(const Attrib& attrib)
+{
+  if (!attrib.isValid())
+    return;
+  GLState::disableVertexAttribArray(attrib.getLocation());
+}
+
+void Shader::setAttribDivisor(const Attrib& attrib, unsigned int divisor)
+{
+  if (!attrib.isValid())
+    return;
+  glVertexAttribDivisor(attrib.getLocation(), divisor);
+  GLState::countCall();
 }
 
 void Shader::setUniformMatrix4f(const std::string& name, const float* matrix)
 {
-  unsigned int loc = getUniformLocation(name);
-  glUniformMatrix4fv(loc, 1, false, matrix);
+  setUniformMatrix4f(getUniform(name), glm::mat4(
+      matrix[0], matrix[1], matrix[2], matrix[3],
+      matrix[4], matrix[5], matrix[6], matrix[7],
+      matrix[8], matrix[9], matrix[10], matrix[11],
+      matrix[12], matrix[13], matrix[14], matrix[15]));
 }
 
 void Shader::setUniformMatrix4f(const std::string& name,
     const glm::mat4& matrix)
 {
-  unsigned int loc = getUniformLocation(name);
-  glUniformMatrix4fv(loc, 1, false, &matrix[0][0]);
+  setUniformMatrix4f(getUniform(name), matrix);
 }
 
 void Shader::setUniform3f(const std::string& name, const float* data)
 {
-  unsigned int loc = getUniformLocation(name);
-  glUniform3fv(loc, 1, data);
+  setUniform3f(getUniform(name), glm::vec3(data[0], data[1], data[2]));
 }
 
 void Shader::setUniform3f(const std::string& name, const glm::vec3& data)
 {
-  setUniform3f(name, &data[0]);
+  setUniform3f(getUniform(name), data);
 }
 
 void Shader::setUniform4f(const std::string& name, const float* data)
 {
-  unsigned int loc = getUniformLocation(name);
-  glUniform4fv(loc, 1, data);
+  setUniform4f(getUniform(name), glm::vec4(data[0], data[1], data[2], data[3]));
 }
 
 void Shader::setUniform4f(const std::string& name, const glm::vec4& data)
 {
-  setUniform4f(name, &data[0]);
+  setUniform4f(getUniform(name), data);
 }
 
 void Shader::setUniform1i(const std::string& name, int data)
 {
-  unsigned int loc = getUniformLocation(name);
-  glUniform1i(loc, data);
+  setUniform1i(getUniform(name), data);
 }
 
 void Shader::setAttribPointer(const std::string& name,
@@ -140,14 +347,12 @@ void Shader::setAttribPointer(const std::string& name,
     int stride,
     size_t offset)
 {
-  unsigned int loc = getAttribLocation(name);
-  glVertexAttribPointer(loc, size, type, GL_FALSE, stride, (void*)offset);
+  setAttribPointer(getAttrib(name), type, size, stride, offset);
 }
 
 void Shader::enableAttribArray(const std::string& name)
 {
-  unsigned int loc = getAttribLocation(name);
-  glEnableVertexAttribArray(loc);
+  enableAttribArray(getAttrib(name));
 }
 
 std::string Shader::getShaderLog(int shader)
@@ -163,6 +368,110 @@ std::string Shader::getShaderLog(int shader)
   return string();
 }
 
+string Shader::getCacheFileName() const
+{
+  // Binaries are only valid for the driver that produced them.
+  uint64_t hash = 14695981039346656037ull;
+  hashString(hash, glGetString(GL_VENDOR));
+  hashString(hash, glGetString(GL_RENDERER));
+  hashString(hash, glGetString(GL_VERSION));
+  for (const pair<ShaderType, string>& source : sources_)
+  {
+    hashBytes(hash, &source.first, sizeof(source.first));
+    hashBytes(hash, source.second.c_str(), source.second.size() + 1);
+  }
+
+  std::stringstream ss;
+  ss << cache_directory_ << "/" << std::hex << std::setw(16)
+     << std::setfill('0') << hash << ".bin";
+  return ss.str();
+}
+
+bool Shader::loadProgramBinary(const std::string& file_name)
+{
+  std::ifstream file(file_name.c_str(), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  BinaryHeader header;
+  std::vector<char> binary;
+  if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) &&
+      memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0 &&
+      header.version == BINARY_VERSION && header.length > 0)
+  {
+    binary.resize(header.length);
+    file.read(&binary[0], binary.size());
+  }
+  if (binary.empty() || !file)
+  {
+    cerr << "Ignoring damaged shader cache file " << file_name << "." << endl;
+    return false;
+  }
+
+  // Drivers reject binaries of other versions or hardware; the sources are
+  // compiled then and the entry replaced.
+  glProgramBinary(program_, header.format, &binary[0], header.length);
+  GLint linked = 0;
+  glGetProgramiv(program_, GL_LINK_STATUS, &linked);
+  if (!linked)
+  {
+    cout << "Driver rejected cached shader program " << file_name
+         << ", compiling." << endl;
+    return false;
+  }
+  cout << "Shader program (" << program_ << ") loaded from " << file_name
+       << "." << endl;
+  return true;
+}
+
+void Shader::saveProgramBinary(const std::string& file_name)
+{
+  GLint length = 0;
+  glGetProgramiv(program_, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  BinaryHeader header;
+  memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+  header.version = BINARY_VERSION;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program_, length, &length, &format, &binary[0]);
+  if (length <= 0)
+    return;
+  header.format = format;
+  header.length = static_cast<uint32_t>(length);
+
+#ifdef _WIN32
+  _mkdir(cache_directory_.c_str());
+#else
+  mkdir(cache_directory_.c_str(), 0755);
+#endif
+  // Written aside and renamed, so a concurrent start never reads half a
+  // binary.
+  string temp_name = file_name + ".tmp";
+  {
+    std::ofstream file(temp_name.c_str(), std::ios::out | std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(&binary[0], length);
+    if (!file)
+    {
+      cerr << "Could not write shader cache file " << temp_name << "."
+           << endl;
+      return;
+    }
+  }
+  std::remove(file_name.c_str());
+  if (std::rename(temp_name.c_str(), file_name.c_str()) != 0)
+  {
+    cerr << "Could not write shader cache file " << file_name << "." << endl;
+    std::remove(temp_name.c_str());
+    return;
+  }
+  cout << "Shader program (" << program_ << ") cached in " << file_name
+       << "." << endl;
+}
+
 bool Shader::checkShaderCompile(int shader)
 {
   GLint compiled;
@@ -196,34 +505,75 @@ bool Shader::checkShaderLink(int shader)
   return false;
 }
 
-unsigned int Shader::getAttribLocation(const std::string& name)
+void Shader::resolveLocations()
 {
-  int loc;
-  attrib_map_iter it = attribs_.find(name);
-  if (it == attribs_.end())
+  uniforms_.clear();
+  attribs_.clear();
+
+  const GLsizei max_name_len = 256;
+  char name[max_name_len];
+
+  GLint uniform_cnt = 0;
+  glGetProgramiv(program_, GL_ACTIVE_UNIFORMS, &uniform_cnt);
+  for (GLint i = 0; i < uniform_cnt; i++)
   {
-    loc = glGetAttribLocation(program_, name.c_str());
-    attribs_.insert(attrib_map_pair(name, loc));
+    GLint size;
+    GLenum type;
+    glGetActiveUniform(program_, i, max_name_len, 0, &size, &type, name);
+
+    Uniform uniform;
+    uniform.location_ = glGetUniformLocation(program_, name);
+    uniform.cache_slot_ = static_cast<int>(uniforms_.size());
+    if (uniform.location_ < 0)
+      continue;
+
+    // Arrays are reported as "name[0]", make them reachable as "name" too.
+    string uniform_name(name);
+    size_t bracket = uniform_name.find('[');
+    if (bracket != string::npos)
+      uniform_name = uniform_name.substr(0, bracket);
+    uniforms_[uniform_name] = uniform;
   }
-  else
+
+  GLint attrib_cnt = 0;
+  glGetProgramiv(program_, GL_ACTIVE_ATTRIBUTES, &attrib_cnt);
+  for (GLint i = 0; i < attrib_cnt; i++)
   {
-    loc = it->second;
+    GLint size;
+    GLenum type;
+    glGetActiveAttrib(program_, i, max_name_len, 0, &size, &type, name);
+
+    Attrib attrib;
+    attrib.location_ = glGetAttribLocation(program_, name);
+    if (attrib.location_ >= 0)
+      attribs_[name] = attrib;
   }
-  return loc;
+
+  uniform_values_.assign(uniforms_.size() * 16, 0.f);
+  uniform_values_valid_.assign(uniforms_.size(), false);
+
+  cout << "Shader program (" << program_ << ") has " << uniforms_.size()
+       << " active uniforms and " << attribs_.size() << " active attributes."
+       << endl;
 }
 
-unsigned int Shader::getUniformLocation(const std::string& name)
+bool Shader::uniformChanged(const Uniform& uniform,
+    const float* data,
+    size_t count)
 {
-  int loc;
-  uniform_map_iter it = uniforms_.find(name);
-  if (it == uniforms_.end())
-  {
-    loc = glGetUniformLocation(program_, name.c_str());
-    uniforms_.insert(uniform_map_pair(name, loc));
-  }
-  else
+  if (!uniform.isValid())
+    return false;
+
+  size_t slot = static_cast<size_t>(uniform.cache_slot_);
+  float* cached = &uniform_values_[slot * 16];
+  if (uniform_values_valid_[slot] &&
+      std::memcmp(cached, data, count * sizeof(float)) == 0)
   {
-    loc = it->second;
+    GLState::countSkipped();
+    return false;
   }
-  return loc;
+
+  std::memcpy(cached, data, count * sizeof(float));
+  uniform_values_valid_[slot] = true;
+  return true;
 }
@@ -16,16 +16,69 @@ class Shader
     FRAGMENT_SHADER
   };
 
+  // Handle of an active uniform, resolved once when the program is linked.
+  // Default constructed handles are invalid and setting them is a no-op.
+  class Uniform
+  {
+   public:
+    Uniform();
+    bool isValid() const;
+
+   private:
+    friend class Shader;
+    int location_;
+    int cache_slot_;
+  };
+
+  // Handle of an active vertex attribute, resolved once at link time.
+  class Attrib
+  {
+   public:
+    Attrib();
+    bool isValid() const;
+    unsigned int getLocation() const;
+    // Matrix attributes occupy one location per column.
+    Attrib column(unsigned int index) const;
+
+   private:
+    friend class Shader;
+    int location_;
+  };
+
   Shader();
   virtual ~Shader();
 
+  // Linked programs are stored as binaries in this directory, keyed by
+  // their sources and the driver, and loaded instead of compiled when the
+  // driver accepts them. Empty (the default) disables the cache.
+  static void setCacheDirectory(const std::string& directory);
+
   bool create();
+  // With the cache, compiling is deferred to link() and only done on a miss.
   bool addShader(ShaderType type, const std::string& source);
   bool link();
   void destroy();
   void bind();
   void unbind();
 
+  Uniform getUniform(const std::string& name) const;
+  Attrib getAttrib(const std::string& name) const;
+
+  void setUniformMatrix4f(const Uniform& uniform, const glm::mat4& matrix);
+  void setUniform3f(const Uniform& uniform, const glm::vec3& data);
+  void setUniform4f(const Uniform& uniform, const glm::vec4& data);
+  void setUniform1i(const Uniform& uniform, int data);
+  // Integer types are read as [-1, 1] / [0, 1] floats when normalized.
+  void setAttribPointer(const Attrib& attrib,
+      unsigned int type,
+      int size,
+      int stride,
+      size_t offset = 0,
+      bool normalized = false);
+  void enableAttribArray(const Attrib& attrib);
+  void disableAttribArray(const Attrib& attrib);
+  void setAttribDivisor(const Attrib& attrib, unsigned int divisor);
+
   void setUniformMatrix4f(const std::string& name, const float* matrix);
   void setUniformMatrix4f(const std::string& name, const glm::mat4& matrix);
   void setUniform3f(const std::string& name, const float* data);
@@ -43,21 +96,33 @@ class Shader
  private:
   int program_;
   std::vector<int> shaders_;
+  // Sources waiting for link() while the cache is in use.
+  std::vector<std::pair<ShaderType, std::string> > sources_;
+
+  static std::string cache_directory_;
+
+  std::map<std::string, Uniform> uniforms_;
+  typedef std::map<std::string, Uniform>::const_iterator uniform_map_iter;
+
+  std::map<std::string, Attrib> attribs_;
+  typedef std::map<std::string, Attrib>::const_iterator attrib_map_iter;
 
-  std::map<std::string, int> uniforms_;
-  typedef std::map<std::string, int>::iterator uniform_map_iter;
-  typedef std::pair<std::string, int> uniform_map_pair;
+  // Last value uploaded per uniform (16 floats each), used to drop redundant
+  // glUniform* calls.
+  std::vector<float> uniform_values_;
+  std::vector<bool> uniform_values_valid_;
 
-  std::map<std::string, int> attribs_;
-  typedef std::map<std::string, int>::iterator attrib_map_iter;
-  typedef std::pair<std::string, int> attrib_map_pair;
+  bool compileShader(ShaderType type, const std::string& source);
+  std::string getCacheFileName() const;
+  bool loadProgramBinary(const std::string& file_name);
+  void saveProgramBinary(const std::string& file_name);
 
   std::string getShaderLog(int shader);
   bool checkShaderCompile(int shader);
   bool checkShaderLink(int shader);
 
-  unsigned int getUniformLocation(const std::string& name);
-  unsigned int getAttribLocation(const std::string& name);
+  void resolveLocations();
+  bool uniformChanged(const Uniform& uniform, const float* data, size_t count);
 };
 
 #endif // SHADER_H
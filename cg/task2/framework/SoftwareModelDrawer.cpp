@@ -0,0 +1,167 @@
+#include "SoftwareModelDrawer.h"
+#include "Model.h"
+#include "Material.h"
+#include "Joint.h"
+#include "Camera.h"
+#include "../task2.h"
+#include <cstring>
+#include <iostream>
+
+using std::cout;
+using std::endl;
+
+SoftwareModelDrawer::SoftwareModelDrawer(const Model* model,
+    int width,
+    int height)
+    : IModelDrawer(model)
+{
+  rasterizer_.resize(width, height);
+}
+
+SoftwareModelDrawer::~SoftwareModelDrawer()
+{
+}
+
+void SoftwareModelDrawer::init()
+{
+  cout << "Initializing the software model drawer ("
+       << rasterizer_.getWidth() << "x" << rasterizer_.getHeight() << ")."
+       << endl;
+
+  size_t mesh_cnt = model_->getMeshCount();
+  vertices_.resize(mesh_cnt);
+  normals_.resize(mesh_cnt);
+  for (size_t i = 0; i < mesh_cnt; i++)
+  {
+    size_t vertex_cnt = model_->getMesh(i).getVertexCount();
+    vertices_[i].resize(vertex_cnt);
+    normals_[i].resize(vertex_cnt);
+  }
+
+  initPose();
+}
+
+void SoftwareModelDrawer::draw()
+{
+  const glm::mat4 mv_mat = camera_->getViewMatrix() * model_mat_;
+  const glm::mat4 mvp_mat = camera_->getProjMatrix() * mv_mat;
+
+  size_t mesh_cnt = model_->getMeshCount();
+  for (size_t i = 0; i < mesh_cnt; i++)
+  {
+    const Mesh& mesh = model_->getMesh(i);
+    const Material& material = model_->getMaterial(mesh.getMaterial());
+
+    const std::vector<glm::vec3>* vertices = &mesh.getVertices();
+    const std::vector<glm::vec3>* normals = &mesh.getNormals();
+    if (action_started_)
+    {
+      calculateVertices(mesh.getVertices(), model_->getJoints(),
+          mesh.getJoints(), mesh.getWeights(), joint_transformations_,
+          vertices_[i]);
+      // calculateNormals accumulates into its output.
+      std::fill(normals_[i].begin(), normals_[i].end(), glm::vec3(0.f));
+      calculateNormals(vertices_[i], mesh.getTriangles(), normals_[i]);
+      vertices = &vertices_[i];
+      normals = &normals_[i];
+    }
+
+    raster_vertices_.resize(vertices->size());
+    for (size_t v_idx = 0; v_idx < vertices->size(); v_idx++)
+      shadeVertex(mvp_mat, mv_mat, (*vertices)[v_idx], (*normals)[v_idx],
+          raster_vertices_[v_idx]);
+
+    rasterizer_.drawTriangles(
+        raster_vertices_, mesh.getTriangles(), material.getDiffuse());
+  }
+}
+
+void SoftwareModelDrawer::drawJoints()
+{
+  instances_.clear();
+  for (size_t joint_index = 0; joint_index < model_->getJointCount();
+       joint_index++)
+    instances_.push_back(GlyphGeometry::jointInstance(
+        joint_transformations_[joint_index], joint_size_));
+
+  drawGlyphs(instances_, GlyphGeometry::getJointVertices());
+}
+
+void SoftwareModelDrawer::drawBones()
+{
+  instances_.clear();
+  for (const Joint& joint : model_->getJoints())
+  {
+    if (!joint.hasParent())
+      continue;
+    instances_.push_back(GlyphGeometry::boneInstance(
+        joint_transformations_[joint.getParent()],
+        joint_transformations_[joint.getID()], bone_size_));
+  }
+
+  drawGlyphs(instances_, GlyphGeometry::getBoneVertices());
+}
+
+Image SoftwareModelDrawer::makeScreenshot()
+{
+  Image image(
+      rasterizer_.getWidth(), rasterizer_.getHeight(), Image::Format::RGB);
+  // The rasterizer already keeps its rows top-down.
+  image.copyRows(rasterizer_.getPixels(), false);
+  return image;
+}
+
+void SoftwareModelDrawer::setThreadCount(unsigned thread_count)
+{
+  rasterizer_.setThreadCount(thread_count);
+}
+
+void SoftwareModelDrawer::setLight(const glm::vec3& position,
+    const glm::vec4& diffuse)
+{
+  rasterizer_.setLight(position, diffuse);
+}
+
+void SoftwareModelDrawer::setLightEnabled(bool enabled)
+{
+  rasterizer_.setLightEnabled(enabled);
+}
+
+void SoftwareModelDrawer::clear(const glm::vec3& color)
+{
+  rasterizer_.clear(color);
+}
+
+void SoftwareModelDrawer::drawGlyphs(
+    const std::vector<GlyphInstance>& instances,
+    const std::vector<glm::vec3>& glyph)
+{
+  const glm::mat4 mv_mat = camera_->getViewMatrix() * model_mat_;
+  const glm::mat4 mvp_mat = camera_->getProjMatrix() * mv_mat;
+
+  glyph_vertices_.resize(instances.size() * glyph.size());
+  raster_vertices_.resize(instances.size() * glyph.size() / 2);
+  for (size_t i = 0; i < instances.size(); i++)
+    GlyphGeometry::transform(
+        instances[i], glyph, &glyph_vertices_[i * glyph.size()]);
+  for (size_t v_idx = 0; v_idx < raster_vertices_.size(); v_idx++)
+    shadeVertex(mvp_mat, mv_mat, glyph_vertices_[2 * v_idx],
+        glyph_vertices_[2 * v_idx + 1], raster_vertices_[v_idx]);
+
+  rasterizer_.drawTriangles(
+      raster_vertices_, model_->getMaterial(0).getDiffuse());
+}
+
+void SoftwareModelDrawer::shadeVertex(const glm::mat4& mvp_mat,
+    const glm::mat4& mv_mat,
+    const glm::vec3& position,
+    const glm::vec3& normal,
+    RasterVertex& out)
+{
+  // Same as shader.vsh.
+  glm::vec4 pos(position, 1.f);
+  out.clip_position = mvp_mat * pos;
+  out.view_position = glm::vec3(mv_mat * pos);
+  out.view_normal =
+      glm::normalize(glm::vec3(normal_mat_ * glm::vec4(normal, 0.f)));
+}
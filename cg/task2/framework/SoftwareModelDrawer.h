@@ -0,0 +1,49 @@
+#ifndef SOFTWAREMODELDRAWER_H
+#define SOFTWAREMODELDRAWER_H
+
+#include <vector>
+#include "IModelDrawer.h"
+#include "SoftwareRasterizer.h"
+#include "GlyphGeometry.h"
+
+// IModelDrawer backend that renders on the CPU with the SoftwareRasterizer,
+// for machines without a GPU or display. It skins and shades like
+// ModelDrawer and shader.vsh/shader.fsh; it needs neither a window nor a GL
+// context.
+class SoftwareModelDrawer : public IModelDrawer
+{
+public:
+  SoftwareModelDrawer(const Model* model, int width, int height);
+  virtual ~SoftwareModelDrawer();
+
+  void init();
+  void draw();
+  void drawJoints();
+  void drawBones();
+  Image makeScreenshot();
+
+  // Tile threads per draw call, 0 for all hardware threads.
+  void setThreadCount(unsigned thread_count);
+  void setLight(const glm::vec3& position, const glm::vec4& diffuse);
+  void setLightEnabled(bool enabled);
+  void clear(const glm::vec3& color);
+
+private:
+  SoftwareRasterizer rasterizer_;
+
+  std::vector<std::vector<glm::vec3>> vertices_;
+  std::vector<std::vector<glm::vec3>> normals_;
+  std::vector<RasterVertex> raster_vertices_;
+  std::vector<GlyphInstance> instances_;
+  std::vector<glm::vec3> glyph_vertices_;
+
+  void drawGlyphs(const std::vector<GlyphInstance>& instances,
+      const std::vector<glm::vec3>& glyph);
+  void shadeVertex(const glm::mat4& mvp_mat,
+      const glm::mat4& mv_mat,
+      const glm::vec3& position,
+      const glm::vec3& normal,
+      RasterVertex& out);
+};
+
+#endif // SOFTWAREMODELDRAWER_H
@@ -0,0 +1,308 @@
+#include "SoftwareRasterizer.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+RasterVertex lerp(const RasterVertex& a, const RasterVertex& b, float t)
+{
+  RasterVertex v;
+  v.clip_position = glm::mix(a.clip_position, b.clip_position, t);
+  v.view_position = glm::mix(a.view_position, b.view_position, t);
+  v.view_normal = glm::mix(a.view_normal, b.view_normal, t);
+  return v;
+}
+
+// Distance to the near plane (z = -w) in clip space, positive inside.
+float nearDistance(const RasterVertex& v)
+{
+  return v.clip_position.z + v.clip_position.w;
+}
+
+float edge(const glm::vec2& a, const glm::vec2& b, float x, float y)
+{
+  return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+unsigned char toByte(float value)
+{
+  return static_cast<unsigned char>(
+      glm::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+}
+}
+
+SoftwareRasterizer::SoftwareRasterizer()
+    : width_(0)
+    , height_(0)
+    , tile_cols_(0)
+    , tile_rows_(0)
+    , thread_count_(0)
+    , light_position_(0.f)
+    , light_diffuse_(1.f)
+    , light_enabled_(true)
+    , diffuse_(1.f)
+    , bin_offsets_(0)
+    , bin_triangles_(0)
+{
+}
+
+void SoftwareRasterizer::resize(int width, int height)
+{
+  width_ = width;
+  height_ = height;
+  tile_cols_ = (width_ + TILE_SIZE - 1) / TILE_SIZE;
+  tile_rows_ = (height_ + TILE_SIZE - 1) / TILE_SIZE;
+  color_.assign(static_cast<size_t>(width_) * height_ * 3, 0);
+  depth_.assign(static_cast<size_t>(width_) * height_, 1.f);
+}
+
+void SoftwareRasterizer::setThreadCount(unsigned thread_count)
+{
+  thread_count_ = thread_count;
+}
+
+void SoftwareRasterizer::setLight(const glm::vec3& view_position,
+    const glm::vec4& diffuse)
+{
+  light_position_ = view_position;
+  light_diffuse_ = diffuse;
+}
+
+void SoftwareRasterizer::setLightEnabled(bool enabled)
+{
+  light_enabled_ = enabled;
+}
+
+void SoftwareRasterizer::clear(const glm::vec3& color)
+{
+  unsigned char rgb[3] = {toByte(color.r), toByte(color.g), toByte(color.b)};
+  for (size_t i = 0; i < color_.size(); i += 3)
+  {
+    color_[i] = rgb[0];
+    color_[i + 1] = rgb[1];
+    color_[i + 2] = rgb[2];
+  }
+  std::fill(depth_.begin(), depth_.end(), 1.f);
+  frame_arena_.reset();
+}
+
+void SoftwareRasterizer::drawTriangles(
+    const std::vector<RasterVertex>& vertices,
+    const std::vector<glm::ivec3>& triangles,
+    const glm::vec3& diffuse)
+{
+  diffuse_ = diffuse;
+  triangles_.clear();
+  for (const glm::ivec3& triangle : triangles)
+    clipAndSetup(vertices[triangle[0]], vertices[triangle[1]],
+        vertices[triangle[2]]);
+  rasterize();
+}
+
+void SoftwareRasterizer::drawTriangles(
+    const std::vector<RasterVertex>& vertices,
+    const glm::vec3& diffuse)
+{
+  diffuse_ = diffuse;
+  triangles_.clear();
+  for (size_t i = 0; i + 2 < vertices.size(); i += 3)
+    clipAndSetup(vertices[i], vertices[i + 1], vertices[i + 2]);
+  rasterize();
+}
+
+int SoftwareRasterizer::getWidth() const
+{
+  return width_;
+}
+
+int SoftwareRasterizer::getHeight() const
+{
+  return height_;
+}
+
+const unsigned char* SoftwareRasterizer::getPixels() const
+{
+  return color_.empty() ? 0 : &color_[0];
+}
+
+void SoftwareRasterizer::clipAndSetup(const RasterVertex& v0,
+    const RasterVertex& v1,
+    const RasterVertex& v2)
+{
+  const RasterVertex* input[3] = {&v0, &v1, &v2};
+  float distance[3] = {
+      nearDistance(v0), nearDistance(v1), nearDistance(v2)};
+  if (distance[0] >= 0.f && distance[1] >= 0.f && distance[2] >= 0.f)
+  {
+    setupTriangle(v0, v1, v2);
+    return;
+  }
+
+  // Sutherland-Hodgman against the near plane; the other planes are handled
+  // by the screen bounds and the depth range test per pixel.
+  RasterVertex polygon[4];
+  int vertex_cnt = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    int j = (i + 1) % 3;
+    if (distance[i] >= 0.f)
+      polygon[vertex_cnt++] = *input[i];
+    if ((distance[i] >= 0.f) != (distance[j] >= 0.f))
+      polygon[vertex_cnt++] = lerp(*input[i], *input[j],
+          distance[i] / (distance[i] - distance[j]));
+  }
+
+  for (int i = 1; i + 1 < vertex_cnt; i++)
+    setupTriangle(polygon[0], polygon[i], polygon[i + 1]);
+}
+
+void SoftwareRasterizer::setupTriangle(const RasterVertex& v0,
+    const RasterVertex& v1,
+    const RasterVertex& v2)
+{
+  const RasterVertex* vertices[3] = {&v0, &v1, &v2};
+  SetupTriangle triangle;
+  for (int i = 0; i < 3; i++)
+  {
+    const glm::vec4& clip = vertices[i]->clip_position;
+    float inv_w = 1.f / clip.w;
+    triangle.screen[i] = glm::vec2((clip.x * inv_w * 0.5f + 0.5f) * width_,
+        (0.5f - clip.y * inv_w * 0.5f) * height_);
+    triangle.depth[i] = clip.z * inv_w * 0.5f + 0.5f;
+    triangle.inv_w[i] = inv_w;
+    triangle.view_position[i] = vertices[i]->view_position * inv_w;
+    triangle.view_normal[i] = vertices[i]->view_normal * inv_w;
+  }
+
+  float area = edge(triangle.screen[0], triangle.screen[1],
+      triangle.screen[2].x, triangle.screen[2].y);
+  if (area == 0.f || !std::isfinite(area))
+    return;
+  triangle.inv_area = 1.f / area;
+
+  glm::vec2 lo = glm::min(triangle.screen[0],
+      glm::min(triangle.screen[1], triangle.screen[2]));
+  glm::vec2 hi = glm::max(triangle.screen[0],
+      glm::max(triangle.screen[1], triangle.screen[2]));
+  triangle.min_x = std::max(static_cast<int>(std::floor(lo.x)), 0);
+  triangle.min_y = std::max(static_cast<int>(std::floor(lo.y)), 0);
+  triangle.max_x = std::min(static_cast<int>(std::ceil(hi.x)), width_ - 1);
+  triangle.max_y = std::min(static_cast<int>(std::ceil(hi.y)), height_ - 1);
+  if (triangle.min_x > triangle.max_x || triangle.min_y > triangle.max_y)
+    return;
+
+  triangles_.push_back(triangle);
+}
+
+void SoftwareRasterizer::rasterize()
+{
+  if (triangles_.empty())
+    return;
+
+  // Counting sort into flat bins: count per tile, prefix sum, then fill.
+  // Triangles stay in submission order within a bin.
+  const size_t tile_cnt = static_cast<size_t>(tile_cols_) * tile_rows_;
+  bin_offsets_ = frame_arena_.allocate<unsigned>(tile_cnt + 1);
+  std::fill(bin_offsets_, bin_offsets_ + tile_cnt + 1, 0u);
+  for (const SetupTriangle& triangle : triangles_)
+  {
+    for (int row = triangle.min_y / TILE_SIZE;
+         row <= triangle.max_y / TILE_SIZE; row++)
+    {
+      for (int col = triangle.min_x / TILE_SIZE;
+           col <= triangle.max_x / TILE_SIZE; col++)
+        bin_offsets_[row * tile_cols_ + col + 1]++;
+    }
+  }
+  for (size_t tile = 0; tile < tile_cnt; tile++)
+    bin_offsets_[tile + 1] += bin_offsets_[tile];
+
+  bin_triangles_ = frame_arena_.allocate<unsigned>(bin_offsets_[tile_cnt]);
+  unsigned* bin_fill = frame_arena_.allocate<unsigned>(tile_cnt);
+  std::copy(bin_offsets_, bin_offsets_ + tile_cnt, bin_fill);
+  for (size_t t_idx = 0; t_idx < triangles_.size(); t_idx++)
+  {
+    const SetupTriangle& triangle = triangles_[t_idx];
+    for (int row = triangle.min_y / TILE_SIZE;
+         row <= triangle.max_y / TILE_SIZE; row++)
+    {
+      for (int col = triangle.min_x / TILE_SIZE;
+           col <= triangle.max_x / TILE_SIZE; col++)
+        bin_triangles_[bin_fill[row * tile_cols_ + col]++] =
+            static_cast<unsigned>(t_idx);
+    }
+  }
+
+  unsigned thread_count = thread_count_;
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1u);
+  parallelFor(tile_cnt, thread_count,
+      [this](size_t tile) { rasterizeTile(static_cast<int>(tile)); });
+}
+
+void SoftwareRasterizer::rasterizeTile(int tile)
+{
+  const unsigned bin_begin = bin_offsets_[tile];
+  const unsigned bin_end = bin_offsets_[tile + 1];
+  if (bin_begin == bin_end)
+    return;
+
+  const int tile_x = (tile % tile_cols_) * TILE_SIZE;
+  const int tile_y = (tile / tile_cols_) * TILE_SIZE;
+  const glm::vec3 light_diffuse(light_diffuse_);
+
+  for (unsigned bin_idx = bin_begin; bin_idx < bin_end; bin_idx++)
+  {
+    const SetupTriangle& triangle = triangles_[bin_triangles_[bin_idx]];
+    const int x_begin = std::max(triangle.min_x, tile_x);
+    const int x_end = std::min(triangle.max_x, tile_x + TILE_SIZE - 1);
+    const int y_begin = std::max(triangle.min_y, tile_y);
+    const int y_end = std::min(triangle.max_y, tile_y + TILE_SIZE - 1);
+
+    for (int y = y_begin; y <= y_end; y++)
+    {
+      const float py = y + 0.5f;
+      for (int x = x_begin; x <= x_end; x++)
+      {
+        const float px = x + 0.5f;
+        // Barycentrics, positive inside for either winding.
+        float b0 = edge(triangle.screen[1], triangle.screen[2], px, py) *
+                   triangle.inv_area;
+        float b1 = edge(triangle.screen[2], triangle.screen[0], px, py) *
+                   triangle.inv_area;
+        float b2 = 1.f - b0 - b1;
+        if (b0 < 0.f || b1 < 0.f || b2 < 0.f)
+          continue;
+
+        float depth = b0 * triangle.depth[0] + b1 * triangle.depth[1] +
+                      b2 * triangle.depth[2];
+        size_t pixel = static_cast<size_t>(y) * width_ + x;
+        if (depth < 0.f || depth > 1.f || depth >= depth_[pixel])
+          continue;
+        depth_[pixel] = depth;
+
+        glm::vec3 color = diffuse_;
+        if (light_enabled_)
+        {
+          float w = 1.f / (b0 * triangle.inv_w[0] + b1 * triangle.inv_w[1] +
+                           b2 * triangle.inv_w[2]);
+          glm::vec3 v = (b0 * triangle.view_position[0] +
+                         b1 * triangle.view_position[1] +
+                         b2 * triangle.view_position[2]) * w;
+          glm::vec3 n = (b0 * triangle.view_normal[0] +
+                         b1 * triangle.view_normal[1] +
+                         b2 * triangle.view_normal[2]) * w;
+          float lambert = glm::dot(n, glm::normalize(light_position_ - v));
+          color = lambert > 0.f ? diffuse_ * light_diffuse * lambert
+                                : glm::vec3(0.f);
+        }
+
+        unsigned char* out = &color_[pixel * 3];
+        out[0] = toByte(color.r);
+        out[1] = toByte(color.g);
+        out[2] = toByte(color.b);
+      }
+    }
+  }
+}
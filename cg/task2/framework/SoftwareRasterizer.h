@@ -0,0 +1,95 @@
+#ifndef SOFTWARERASTERIZER_H
+#define SOFTWARERASTERIZER_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "FrameArena.h"
+
+// Output of the vertex stage, matching the varyings of shader.vsh.
+struct RasterVertex
+{
+  glm::vec4 clip_position;
+  glm::vec3 view_position;
+  glm::vec3 view_normal;
+};
+
+// Tile-based CPU rasterizer with a depth buffer. Each draw call clips its
+// triangles against the near plane, bins them into screen tiles and then
+// rasterizes the tiles in parallel; a tile is only ever touched by one
+// thread, so no pixel needs synchronization. Shading is the Lambert term of
+// shader.fsh. Rows are stored top-down, like the screenshot images.
+//
+// clear() starts a frame: the tile bins of all draws until the next clear()
+// come from a frame arena.
+class SoftwareRasterizer
+{
+public:
+  static const int TILE_SIZE = 32;
+
+  SoftwareRasterizer();
+
+  void resize(int width, int height);
+  // 0 uses all hardware threads.
+  void setThreadCount(unsigned thread_count);
+  void setLight(const glm::vec3& view_position, const glm::vec4& diffuse);
+  void setLightEnabled(bool enabled);
+
+  void clear(const glm::vec3& color);
+  // Indexed triangle list.
+  void drawTriangles(const std::vector<RasterVertex>& vertices,
+      const std::vector<glm::ivec3>& triangles,
+      const glm::vec3& diffuse);
+  // Every three consecutive vertices form a triangle.
+  void drawTriangles(const std::vector<RasterVertex>& vertices,
+      const glm::vec3& diffuse);
+
+  int getWidth() const;
+  int getHeight() const;
+  // Tightly packed RGB rows, top row first.
+  const unsigned char* getPixels() const;
+
+private:
+  struct SetupTriangle
+  {
+    glm::vec2 screen[3];
+    float depth[3];
+    float inv_w[3];
+    // Attributes pre-divided by w for perspective correct interpolation.
+    glm::vec3 view_position[3];
+    glm::vec3 view_normal[3];
+    float inv_area;
+    int min_x, min_y, max_x, max_y;
+  };
+
+  int width_;
+  int height_;
+  int tile_cols_;
+  int tile_rows_;
+  unsigned thread_count_;
+
+  glm::vec3 light_position_;
+  glm::vec4 light_diffuse_;
+  bool light_enabled_;
+  glm::vec3 diffuse_;
+
+  std::vector<unsigned char> color_;
+  std::vector<float> depth_;
+
+  // Reused between draws to keep the steady state free of allocations.
+  std::vector<SetupTriangle> triangles_;
+  FrameArena frame_arena_;
+  // Triangles of tile t are bin_triangles_[bin_offsets_[t], [t + 1]).
+  unsigned* bin_offsets_;
+  unsigned* bin_triangles_;
+
+  void setupTriangle(const RasterVertex& v0,
+      const RasterVertex& v1,
+      const RasterVertex& v2);
+  void clipAndSetup(const RasterVertex& v0,
+      const RasterVertex& v1,
+      const RasterVertex& v2);
+  void rasterize();
+  void rasterizeTile(int tile);
+};
+
+#endif // SOFTWARERASTERIZER_H
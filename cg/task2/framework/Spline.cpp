@@ -74,8 +74,12 @@ void Spline::addPoint(float time, const glm::vec3& point)
 {
   SplinePoint p;
   p.setPoint(time, point);
-  points_.push_back(p);
-  std::sort(points_.begin(), points_.end(), SplinePoint::compare);
+  // Insert behind all points with the same time, which keeps the order a
+  // stable sort would produce.
+  points_.insert(std::upper_bound(points_.begin(), points_.end(), p,
+                     SplinePoint::compare),
+      p);
+  revision_++;
 }
 
 void Spline::calculateAndStoreTangents()
@@ -92,20 +96,23 @@ void Spline::calculateAndStoreTangents()
 
     p.setTangent(tangent);
   }
+  revision_++;
 }
 
-bool SplinePoint::compare(SplinePoint a, SplinePoint b)
+bool SplinePoint::compare(const SplinePoint& a, const SplinePoint& b)
 {
   return a.getTime() < b.getTime();
 }
 
 Spline::Spline()
     : points_()
+    , revision_(0)
 {
 }
 
 Spline::Spline(const Spline& instance)
     : points_(instance.points_)
+    , revision_(instance.revision_)
 {
 }
 
@@ -135,6 +142,16 @@ glm::quat Spline::lookAtToOrientation(const glm::vec3& look_at_direction) const
   return orientation;
 }
 
+const std::vector<SplinePoint>& Spline::getPoints() const
+{
+  return points_;
+}
+
+unsigned Spline::getRevision() const
+{
+  return revision_;
+}
+
 float Spline::getStartTime() const
 {
   return points_[1].getTime();
@@ -63,7 +63,7 @@ class SplinePoint
    * @return bool Whether the first value should be before the second value
    *  when sorted.
    */
-  static bool compare(SplinePoint a, SplinePoint b);
+  static bool compare(const SplinePoint& a, const SplinePoint& b);
 
  private:
   /**
@@ -169,6 +169,20 @@ class Spline
    */
   SplineInterpolationResult interpolate(float time) const;
 
+  /**
+   * Returns the points sorted by time, including the two outer points
+   * that only shape the tangents.
+   * @return const std::vector<SplinePoint>& The points.
+   */
+  const std::vector<SplinePoint>& getPoints() const;
+
+  /**
+   * Returns a number that changes whenever points or tangents change, so
+   * that derived data can be rebuilt lazily.
+   * @return unsigned The revision.
+   */
+  unsigned getRevision() const;
+
   /**
    * Returns the time of the first point.
    * @return float Time of the first point. 
@@ -187,6 +201,11 @@ class Spline
    */
   std::vector<SplinePoint> points_;
 
+  /**
+   * Incremented on every change of the points or tangents.
+   */
+  unsigned revision_;
+
   /**
    * Calculates an orientation that rotates an object so that it looks to the
    * point specified by the look_at parameter.
@@ -2,6 +2,29 @@
 #include "GLBuffer.h"
 #include "Spline.h"
 #include "Shader.h"
+#include "GLState.h"
+#include <iostream>
+
+namespace
+{
+// Every segment is split at least once, so an S-shaped segment whose
+// midpoint lies on its chord is still refined; MAX_DEPTH bounds a segment
+// to 2^MAX_DEPTH lines.
+const unsigned MIN_DEPTH = 1;
+const unsigned MAX_DEPTH = 10;
+const float DEFAULT_TOLERANCE = 0.01f;
+
+float distanceToSegment(const glm::vec3& point,
+    const glm::vec3& start,
+    const glm::vec3& end)
+{
+  glm::vec3 chord = end - start;
+  float length_sq = glm::dot(chord, chord);
+  float t = length_sq > 0.f ? glm::dot(point - start, chord) / length_sq : 0.f;
+  t = glm::clamp(t, 0.f, 1.f);
+  return glm::length(point - (start + t * chord));
+}
+}
 
 SplineDrawer::SplineDrawer(const Spline& spline, Shader& shader)
     : spline_(spline)
@@ -9,59 +32,120 @@ SplineDrawer::SplineDrawer(const Spline& spline, Shader& shader)
     , shader_(shader)
     , point_count_(0)
     , tangent_count_(0)
+    , tolerance_(DEFAULT_TOLERANCE)
+    , tessellated_revision_(0)
+    , tessellated_tolerance_(0.f)
+    , tessellated_(false)
 {
 }
 
 void SplineDrawer::init()
 {
-  std::vector<glm::vec3> points, tangents;
-  calculateInterpolatedPointsAndTangents(points, tangents);
-  fillVBO(points, tangents);
+  position_attrib_ = shader_.getAttrib("position");
+  model_mat_uniform_ = shader_.getUniform("model_mat");
+  mat_diffuse_uniform_ = shader_.getUniform("mat_diffuse");
+
+  vbo_.create();
 }
 
 void SplineDrawer::draw()
 {
+  if (!tessellated_ || tessellated_revision_ != spline_.getRevision() ||
+      tessellated_tolerance_ != tolerance_)
+  {
+    std::vector<glm::vec3> points, tangents;
+    calculateInterpolatedPointsAndTangents(points, tangents);
+    fillVBO(points, tangents);
+    tessellated_revision_ = spline_.getRevision();
+    tessellated_tolerance_ = tolerance_;
+    tessellated_ = true;
+  }
+
   vbo_.bind();
 
   // Draw the points.
-  shader_.setAttribPointer("position", GL_FLOAT, 3, 0);
-  shader_.enableAttribArray("position");
-  shader_.setUniformMatrix4f("model_mat", glm::mat4(1));
-  shader_.setUniform3f("mat_diffuse", glm::vec3(0.5f, 1.0f, 0.f));
+  shader_.setAttribPointer(position_attrib_, GL_FLOAT, 3, 0);
+  shader_.enableAttribArray(position_attrib_);
+  shader_.setUniformMatrix4f(model_mat_uniform_, glm::mat4(1));
+  shader_.setUniform3f(mat_diffuse_uniform_, glm::vec3(0.5f, 1.0f, 0.f));
   glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(point_count_));
 
   // Draw the tangents.
-  shader_.setUniform3f("mat_diffuse", glm::vec3(0.2f, 0.f, 0.f));
+  shader_.setUniform3f(mat_diffuse_uniform_, glm::vec3(0.2f, 0.f, 0.f));
   glDrawArrays(GL_LINES, static_cast<GLint>(point_count_), static_cast<GLsizei>(tangent_count_));
+  GLState::countCall(2);
 
   vbo_.unbind();
 }
 
+void SplineDrawer::setTolerance(float tolerance)
+{
+  tolerance_ = tolerance;
+}
+
 void SplineDrawer::calculateInterpolatedPointsAndTangents(
     std::vector<glm::vec3>& out_points,
     std::vector<glm::vec3>& out_tangents)
 {
   out_points.clear();
   out_tangents.clear();
-  for (float spline_time = spline_.getStartTime();
-       spline_time < spline_.getEndTime(); spline_time += 0.5f)
+
+  CompiledSpline compiled(spline_);
+  const std::vector<SplinePoint>& points = spline_.getPoints();
+  if (compiled.getSegmentCount() > 0)
   {
-    SplineInterpolationResult interplation_result =
-        spline_.interpolate(spline_time);
-    out_points.push_back(interplation_result.getPosition());
+    // The outer points only shape the tangents, see Spline::interpolate.
+    glm::vec3 start = compiled.getPosition(points[1].getTime());
+    out_points.push_back(start);
+    for (size_t i = 1; i + 2 < points.size(); i++)
+    {
+      float start_time = points[i].getTime();
+      float end_time = points[i + 1].getTime();
+      glm::vec3 end = compiled.getPosition(end_time);
+      subdivide(compiled, start_time, start, end_time, end, 0, out_points);
+      start = end;
+    }
 
-    out_tangents.push_back(out_points.back());
-    out_tangents.push_back(out_points.back() +
-        interplation_result.getOrientation() * glm::vec3(0, 0, 1));
+    for (size_t i = 1; i + 1 < points.size(); i++)
+    {
+      SplineInterpolationResult interplation_result =
+          compiled.interpolate(points[i].getTime());
+      out_tangents.push_back(interplation_result.getPosition());
+      out_tangents.push_back(interplation_result.getPosition() +
+          interplation_result.getOrientation() * glm::vec3(0, 0, 1));
+    }
   }
   point_count_ = out_points.size();
   tangent_count_ = out_tangents.size();
+
+  std::cout << "Tessellated spline into " << point_count_
+            << " points (tolerance " << tolerance_ << ")." << std::endl;
+}
+
+void SplineDrawer::subdivide(const CompiledSpline& compiled,
+    float start_time,
+    const glm::vec3& start,
+    float end_time,
+    const glm::vec3& end,
+    unsigned depth,
+    std::vector<glm::vec3>& out_points) const
+{
+  float mid_time = 0.5f * (start_time + end_time);
+  glm::vec3 mid = compiled.getPosition(mid_time);
+  if (depth < MAX_DEPTH &&
+      (depth < MIN_DEPTH || distanceToSegment(mid, start, end) > tolerance_))
+  {
+    subdivide(compiled, start_time, start, mid_time, mid, depth + 1,
+        out_points);
+    subdivide(compiled, mid_time, mid, end_time, end, depth + 1, out_points);
+    return;
+  }
+  out_points.push_back(end);
 }
 
 void SplineDrawer::fillVBO(const std::vector<glm::vec3>& points,
     const std::vector<glm::vec3>& tangents)
 {
-  vbo_.create();
   vbo_.bind();
   size_t byte_count_points = points.size() * sizeof(glm::vec3);
   size_t byte_count_tangents = tangents.size() * sizeof(glm::vec3);
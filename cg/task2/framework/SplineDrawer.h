@@ -2,6 +2,7 @@
 #define SPLINEDRAWER_H
 
 #include "Spline.h"
+#include "CompiledSpline.h"
 #include "GLBuffer.h"
 #include "Shader.h"
 #include <glm/glm.hpp>
@@ -27,11 +28,20 @@ class SplineDrawer
   void init();
 
   /**
-   * Draws the spline.
+   * Draws the spline. Re-tessellates first if the spline or the tolerance
+   * changed since the last tessellation.
    * @return void Nothing. 
    */
   void draw();
 
+  /**
+   * Sets the largest allowed distance between the drawn line strip and the
+   * curve, in world units.
+   * @param tolerance The error bound.
+   * @return void Nothing.
+   */
+  void setTolerance(float tolerance);
+
  private:
   /**
    * Copy constructor.
@@ -40,15 +50,36 @@ class SplineDrawer
   SplineDrawer(const SplineDrawer& instance);
 
   /**
-   * Description
-   * @param out_points The interpolated points will be stored here.
-   * @param out_tangents The interpolated tangents will be stored here.
+   * Flattens the spline into a line strip within the tolerance, and places
+   * one tangent line on every spline point.
+   * @param out_points The line strip will be stored here.
+   * @param out_tangents The tangent line end points will be stored here.
    * @return void Nothing.
    */
   void calculateInterpolatedPointsAndTangents(
       std::vector<glm::vec3>& out_points,
       std::vector<glm::vec3>& out_tangents);
 
+  /**
+   * Recursively halves the time range until the curve midpoint is within
+   * the tolerance of the chord, then appends the end point.
+   * @param compiled The spline to evaluate.
+   * @param start_time The start of the time range.
+   * @param start The curve position at start_time.
+   * @param end_time The end of the time range.
+   * @param end The curve position at end_time.
+   * @param depth The recursion depth.
+   * @param out_points The line strip the points are appended to.
+   * @return void Nothing.
+   */
+  void subdivide(const CompiledSpline& compiled,
+      float start_time,
+      const glm::vec3& start,
+      float end_time,
+      const glm::vec3& end,
+      unsigned depth,
+      std::vector<glm::vec3>& out_points) const;
+
   /**
    * Fills the vbo with the necessary data to draw the points and the tangents.
    * @param points The points to draw.
@@ -74,6 +105,13 @@ class SplineDrawer
    */
   Shader& shader_;
 
+  /**
+   * Shader inputs, resolved once in init().
+   */
+  Shader::Attrib position_attrib_;
+  Shader::Uniform model_mat_uniform_;
+  Shader::Uniform mat_diffuse_uniform_;
+
   /**
    * The number of spline points that are to be drawn.
    */
@@ -83,6 +121,19 @@ class SplineDrawer
    * The number of spline tangents that are to be drawn.
    */
   size_t tangent_count_;
+
+  /**
+   * The largest allowed distance between line strip and curve.
+   */
+  float tolerance_;
+
+  /**
+   * Spline revision and tolerance of the current tessellation; the
+   * revision is only valid once tessellated_ is set.
+   */
+  unsigned tessellated_revision_;
+  float tessellated_tolerance_;
+  bool tessellated_;
 };
 
 #endif
@@ -0,0 +1,45 @@
+#include "VertexArray.h"
+#include "GLCapabilities.h"
+#include "GLState.h"
+#include <GL/gl3w.h>
+
+VertexArray::VertexArray() : handle_(0)
+{
+}
+
+VertexArray::~VertexArray()
+{
+  destroy();
+}
+
+bool VertexArray::isSupported()
+{
+  return (GLCapabilities::hasVersion(3, 0) ||
+             GLCapabilities::hasExtension("GL_ARB_vertex_array_object")) &&
+         glGenVertexArrays != 0;
+}
+
+void VertexArray::create()
+{
+  glGenVertexArrays(1, &handle_);
+}
+
+void VertexArray::bind()
+{
+  GLState::bindVertexArray(handle_);
+}
+
+void VertexArray::unbind()
+{
+  GLState::bindVertexArray(0);
+}
+
+void VertexArray::destroy()
+{
+  if (handle_)
+  {
+    GLState::forgetVertexArray(handle_);
+    glDeleteVertexArrays(1, &handle_);
+  }
+  handle_ = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef VERTEXARRAY_H
+#define VERTEXARRAY_H
+
+// Wraps a vertex array object. The attribute layout recorded while it is
+// bound is replayed by a single bind when drawing.
+class VertexArray
+{
+public:
+  VertexArray();
+  ~VertexArray();
+
+  static bool isSupported();
+
+  void create();
+  void bind();
+  void unbind();
+  void destroy();
+
+private:
+  unsigned int handle_;
+};
+
+#endif // VERTEXARRAY_H
@@ -0,0 +1,101 @@
+#include "VertexPacking.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Smallest half extent, keeps flat meshes (all z = 0) divisible.
+const float MIN_EXTENT = 1e-6f;
+
+float signNotZero(float value)
+{
+  return value >= 0.f ? 1.f : -1.f;
+}
+}
+
+void VertexPacking::calcBounds(const std::vector<glm::vec3>& positions,
+    glm::vec3& center,
+    glm::vec3& extent)
+{
+  if (positions.empty())
+  {
+    center = glm::vec3(0.f);
+    extent = glm::vec3(MIN_EXTENT);
+    return;
+  }
+
+  glm::vec3 min_corner = positions[0];
+  glm::vec3 max_corner = positions[0];
+  extendBounds(positions, min_corner, max_corner);
+  calcBounds(min_corner, max_corner, center, extent);
+}
+
+void VertexPacking::extendBounds(const std::vector<glm::vec3>& positions,
+    glm::vec3& min_corner,
+    glm::vec3& max_corner)
+{
+  for (const glm::vec3& position : positions)
+  {
+    min_corner = glm::min(min_corner, position);
+    max_corner = glm::max(max_corner, position);
+  }
+}
+
+void VertexPacking::calcBounds(const glm::vec3& min_corner,
+    const glm::vec3& max_corner,
+    glm::vec3& center,
+    glm::vec3& extent)
+{
+  center = 0.5f * (min_corner + max_corner);
+  extent = glm::max(0.5f * (max_corner - min_corner), glm::vec3(MIN_EXTENT));
+}
+
+PackedVertex VertexPacking::pack(const glm::vec3& position,
+    const glm::vec3& normal,
+    const glm::vec3& center,
+    const glm::vec3& inv_extent)
+{
+  glm::vec3 relative = (position - center) * inv_extent;
+  glm::vec2 encoded = encodeOctahedral(normal);
+
+  PackedVertex vertex;
+  vertex.position[0] = packSnorm16(relative.x);
+  vertex.position[1] = packSnorm16(relative.y);
+  vertex.position[2] = packSnorm16(relative.z);
+  vertex.position[3] = 0;
+  vertex.normal[0] = packSnorm16(encoded.x);
+  vertex.normal[1] = packSnorm16(encoded.y);
+  return vertex;
+}
+
+glm::vec2 VertexPacking::encodeOctahedral(const glm::vec3& normal)
+{
+  float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+  if (l1 == 0.f)
+    return glm::vec2(0.f);
+
+  glm::vec2 encoded(normal.x / l1, normal.y / l1);
+  if (normal.z < 0.f)
+    encoded = glm::vec2((1.f - std::abs(encoded.y)) * signNotZero(encoded.x),
+        (1.f - std::abs(encoded.x)) * signNotZero(encoded.y));
+  return encoded;
+}
+
+glm::vec3 VertexPacking::decodeOctahedral(const glm::vec2& encoded)
+{
+  glm::vec3 normal(
+      encoded.x, encoded.y, 1.f - std::abs(encoded.x) - std::abs(encoded.y));
+  if (normal.z < 0.f)
+  {
+    float x = normal.x;
+    normal.x = (1.f - std::abs(normal.y)) * signNotZero(x);
+    normal.y = (1.f - std::abs(x)) * signNotZero(normal.y);
+  }
+  return glm::normalize(normal);
+}
+
+short VertexPacking::packSnorm16(float value)
+{
+  value = std::min(std::max(value, -1.f), 1.f);
+  return static_cast<short>(std::floor(value * 32767.f + 0.5f));
+}
@@ -0,0 +1,52 @@
+#ifndef VERTEXPACKING_H
+#define VERTEXPACKING_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Interleaved mesh vertex as streamed to the GPU, 12 instead of 24 bytes.
+// The position is a normalized short relative to the bounds of the stream
+// (position = center + value * extent), the fourth short pads the normal to
+// 4 byte alignment. The unit normal is octahedral encoded into two
+// normalized shorts.
+struct PackedVertex
+{
+  short position[4];
+  short normal[2];
+};
+
+class VertexPacking
+{
+public:
+  // Center and half extent of the positions; the extent is never zero so
+  // it can be divided by.
+  static void calcBounds(const std::vector<glm::vec3>& positions,
+      glm::vec3& center,
+      glm::vec3& extent);
+  // The same for a box, e.g. one grown over several streams with
+  // extendBounds.
+  static void calcBounds(const glm::vec3& min_corner,
+      const glm::vec3& max_corner,
+      glm::vec3& center,
+      glm::vec3& extent);
+  static void extendBounds(const std::vector<glm::vec3>& positions,
+      glm::vec3& min_corner,
+      glm::vec3& max_corner);
+
+  static PackedVertex pack(const glm::vec3& position,
+      const glm::vec3& normal,
+      const glm::vec3& center,
+      const glm::vec3& inv_extent);
+
+  // Maps a unit vector onto the [-1, 1] square: the octahedron |x|+|y|+|z|=1
+  // is unfolded, the lower half folded over the diagonals.
+  static glm::vec2 encodeOctahedral(const glm::vec3& normal);
+  static glm::vec3 decodeOctahedral(const glm::vec2& encoded);
+
+  static short packSnorm16(float value);
+
+private:
+  VertexPacking();
+};
+
+#endif // VERTEXPACKING_H
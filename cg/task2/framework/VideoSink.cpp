@@ -0,0 +1,237 @@
+#include "VideoSink.h"
+#include "Profiler.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#ifndef _WIN32
+#include <csignal>
+#endif
+
+using std::cerr;
+using std::cout;
+using std::endl;
+
+namespace
+{
+const char Y4M_FRAME_HEADER[] = "FRAME\n";
+const size_t Y4M_FRAME_HEADER_SIZE = sizeof(Y4M_FRAME_HEADER) - 1;
+
+// BT.601 video range in 8 bit fixed point.
+inline unsigned char toY(int r, int g, int b)
+{
+  return static_cast<unsigned char>(
+      ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+
+inline unsigned char toCb(int r, int g, int b)
+{
+  return static_cast<unsigned char>(
+      ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+
+inline unsigned char toCr(int r, int g, int b)
+{
+  return static_cast<unsigned char>(
+      ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+bool endsWith(const std::string& s, const std::string& suffix)
+{
+  return s.size() >= suffix.size() &&
+         s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+}
+
+VideoSink::VideoSink(const std::string& target, unsigned frame_rate)
+    : target_(target)
+    , frame_rate_(frame_rate > 0 ? frame_rate : 1)
+    , format_(Format::RAW_RGB)
+    , is_pipe_(!target.empty() && target[0] == '|')
+    , file_(0)
+    , width_(0)
+    , height_(0)
+    , frame_cnt_(0)
+{
+  if (is_pipe_ || endsWith(target_, ".y4m"))
+    format_ = Format::Y4M;
+}
+
+VideoSink::~VideoSink()
+{
+  close();
+}
+
+bool VideoSink::writeFrame(const unsigned char* data,
+    int width,
+    int height,
+    bool flip_rows)
+{
+  PROFILE_ZONE("VideoSink::writeFrame");
+
+  // Opened with the first frame; after a failure or close() it stays shut.
+  if (!file_ && (frame_cnt_ > 0 || !error_.empty() || !open(width, height)))
+    return false;
+  if (width != width_ || height != height_)
+  {
+    std::stringstream ss;
+    ss << "frame of " << width << "x" << height << " in a " << width_ << "x"
+       << height_ << " video";
+    error_ = ss.str();
+    return false;
+  }
+
+  if (format_ == Format::Y4M)
+    convertToY4M(data, flip_rows);
+  else
+    convertToRGB(data, flip_rows);
+
+  if (fwrite(&frame_[0], 1, frame_.size(), file_) != frame_.size())
+  {
+    error_ = is_pipe_ ? "the encoder stopped reading" : "write failed";
+    return false;
+  }
+  frame_cnt_++;
+  return true;
+}
+
+bool VideoSink::close()
+{
+  if (!file_)
+    return error_.empty();
+
+  int status;
+#ifdef _WIN32
+  status = is_pipe_ ? _pclose(file_) : fclose(file_);
+#else
+  status = is_pipe_ ? pclose(file_) : fclose(file_);
+#endif
+  file_ = 0;
+  if (status != 0)
+  {
+    error_ = is_pipe_ ? "the encoder failed" : "could not close the file";
+    cerr << "Video " << target_ << ": " << error_ << "." << endl;
+    return false;
+  }
+  cout << "Wrote " << frame_cnt_ << " frames to " << target_ << "." << endl;
+  return true;
+}
+
+size_t VideoSink::getFrameCount() const
+{
+  return frame_cnt_;
+}
+
+const std::string& VideoSink::getError() const
+{
+  return error_;
+}
+
+bool VideoSink::open(int width, int height)
+{
+  width_ = width;
+  height_ = height;
+
+  if (is_pipe_)
+  {
+#ifdef _WIN32
+    file_ = _popen(target_.c_str() + 1, "wb");
+#else
+    // A crashed encoder must surface as a failed write, not kill us.
+    signal(SIGPIPE, SIG_IGN);
+    file_ = popen(target_.c_str() + 1, "w");
+#endif
+  }
+  else
+  {
+    file_ = fopen(target_.c_str(), "wb");
+  }
+  if (!file_)
+  {
+    error_ = is_pipe_ ? "could not start the encoder"
+                      : "could not create the file";
+    return false;
+  }
+
+  size_t pixel_cnt = static_cast<size_t>(width_) * height_;
+  if (format_ == Format::Y4M)
+  {
+    size_t chroma_cnt =
+        static_cast<size_t>((width_ + 1) / 2) * ((height_ + 1) / 2);
+    frame_.resize(Y4M_FRAME_HEADER_SIZE + pixel_cnt + 2 * chroma_cnt);
+    memcpy(&frame_[0], Y4M_FRAME_HEADER, Y4M_FRAME_HEADER_SIZE);
+
+    std::stringstream header;
+    header << "YUV4MPEG2 W" << width_ << " H" << height_ << " F"
+           << frame_rate_ << ":1 Ip A1:1 C420jpeg\n";
+    std::string header_str = header.str();
+    fwrite(header_str.data(), 1, header_str.size(), file_);
+    cout << "Streaming " << width_ << "x" << height_ << " Y4M at "
+         << frame_rate_ << " fps to " << target_ << "." << endl;
+  }
+  else
+  {
+    frame_.resize(pixel_cnt * 3);
+    cout << "Streaming raw RGB24 frames of " << width_ << "x" << height_
+         << " at " << frame_rate_ << " fps to " << target_ << "." << endl;
+  }
+  return true;
+}
+
+void VideoSink::convertToY4M(const unsigned char* data, bool flip_rows)
+{
+  const size_t row_size = static_cast<size_t>(width_) * 3;
+  const int chroma_width = (width_ + 1) / 2;
+  const int chroma_height = (height_ + 1) / 2;
+  unsigned char* y_plane = &frame_[Y4M_FRAME_HEADER_SIZE];
+  unsigned char* cb_plane = y_plane + static_cast<size_t>(width_) * height_;
+  unsigned char* cr_plane =
+      cb_plane + static_cast<size_t>(chroma_width) * chroma_height;
+
+  for (int cy = 0; cy < chroma_height; cy++)
+  {
+    // Two output rows per chroma row; the last one repeats on odd heights.
+    int y0 = 2 * cy;
+    int y1 = std::min(y0 + 1, height_ - 1);
+    const unsigned char* row0 =
+        data + (flip_rows ? height_ - 1 - y0 : y0) * row_size;
+    const unsigned char* row1 =
+        data + (flip_rows ? height_ - 1 - y1 : y1) * row_size;
+    unsigned char* luma0 = y_plane + static_cast<size_t>(y0) * width_;
+    unsigned char* luma1 = y_plane + static_cast<size_t>(y1) * width_;
+
+    for (int cx = 0; cx < chroma_width; cx++)
+    {
+      int x0 = 2 * cx;
+      int x1 = std::min(x0 + 1, width_ - 1);
+      const unsigned char* p[4] = {
+          row0 + 3 * x0, row0 + 3 * x1, row1 + 3 * x0, row1 + 3 * x1};
+      luma0[x0] = toY(p[0][0], p[0][1], p[0][2]);
+      luma0[x1] = toY(p[1][0], p[1][1], p[1][2]);
+      luma1[x0] = toY(p[2][0], p[2][1], p[2][2]);
+      luma1[x1] = toY(p[3][0], p[3][1], p[3][2]);
+
+      // Chroma of the averaged 2x2 block, sited at its center.
+      int r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+      int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+      int b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+      size_t chroma = static_cast<size_t>(cy) * chroma_width + cx;
+      cb_plane[chroma] = toCb(r, g, b);
+      cr_plane[chroma] = toCr(r, g, b);
+    }
+  }
+}
+
+void VideoSink::convertToRGB(const unsigned char* data, bool flip_rows)
+{
+  const size_t row_size = static_cast<size_t>(width_) * 3;
+  if (!flip_rows)
+  {
+    memcpy(&frame_[0], data, frame_.size());
+    return;
+  }
+  for (int y = 0; y < height_; y++)
+    memcpy(&frame_[y * row_size], data + (height_ - 1 - y) * row_size,
+        row_size);
+}
@@ -0,0 +1,62 @@
+#ifndef VIDEOSINK_H
+#define VIDEOSINK_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Streams a screenshot sequence into one video instead of a PNG per frame.
+// The target selects the output:
+//
+//   "|command"   Y4M piped into the standard input of an encoder process,
+//                e.g. "|ffmpeg -y -i - turntable.mp4"
+//   "*.y4m"      uncompressed Y4M (YCbCr 4:2:0, BT.601 video range)
+//   otherwise    raw RGB24, top-down rows, frame after frame
+//
+// The output is opened with the size of the first frame; every later frame
+// has to match it. Frames are converted from the caller's buffer (a mapped
+// readback) into one reused frame buffer, so writing allocates nothing.
+class VideoSink
+{
+public:
+  VideoSink(const std::string& target, unsigned frame_rate);
+  ~VideoSink();
+
+  // Appends one frame of RGB pixels, bottom-up rows when flip_rows is set.
+  bool writeFrame(const unsigned char* data,
+      int width,
+      int height,
+      bool flip_rows);
+  // Flushes the output and waits for the encoder to exit.
+  bool close();
+
+  size_t getFrameCount() const;
+  const std::string& getError() const;
+
+private:
+  enum class Format
+  {
+    Y4M,
+    RAW_RGB
+  };
+
+  std::string target_;
+  unsigned frame_rate_;
+  Format format_;
+  bool is_pipe_;
+  FILE* file_;
+  int width_;
+  int height_;
+  size_t frame_cnt_;
+  std::vector<unsigned char> frame_;
+  std::string error_;
+
+  bool open(int width, int height);
+  void convertToY4M(const unsigned char* data, bool flip_rows);
+  void convertToRGB(const unsigned char* data, bool flip_rows);
+
+  VideoSink(const VideoSink&);
+  VideoSink& operator=(const VideoSink&);
+};
+
+#endif // VIDEOSINK_H
@@ -1,4 +1,5 @@
 #include "Window.h"
+#include "Profiler.h"
 #include <GL/gl3w.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
@@ -94,6 +95,7 @@ int Window::enterMainLoop()
 
   while (!glfwWindowShouldClose(window_))
   {
+    PROFILE_ZONE("frame");
     float time_curr = static_cast<float>(glfwGetTime());
     float passedSecs = time_curr - time_prev;
     time_prev = time_curr;
@@ -104,12 +106,33 @@ int Window::enterMainLoop()
     if (drawCallback_)
       drawCallback_();
 
+    PROFILE_ZONE("swap");
     glfwSwapBuffers(window_);
     glfwPollEvents();
   }
   return EXIT_SUCCESS;
 }
 
+void Window::swapBuffers()
+{
+  glfwSwapBuffers(window_);
+}
+
+void Window::pollEvents()
+{
+  glfwPollEvents();
+}
+
+bool Window::shouldClose()
+{
+  return glfwWindowShouldClose(window_) != 0;
+}
+
+void Window::setSwapInterval(int interval)
+{
+  glfwSwapInterval(interval);
+}
+
 void Window::setDrawCallback(void(*drawCallback)())
 {
   drawCallback_ = drawCallback;
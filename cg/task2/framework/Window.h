@@ -15,8 +15,14 @@ public:
   static bool create(unsigned width, unsigned height, const std::string& title);
   static void makeCurrent();
   static int enterMainLoop();
+  // For loops driven by the caller instead of enterMainLoop.
+  static void swapBuffers();
+  static void pollEvents();
+  static bool shouldClose();
 
   static void setGLVersion(const unsigned major, const unsigned minor);
+  // Needs a current context; 0 disables vsync.
+  static void setSwapInterval(int interval);
   static void setBufferSizes(const unsigned red = 8, const unsigned green = 8,
     const unsigned blue = 8, const unsigned alpha = 8,
     const unsigned depth = 24, const unsigned stencil = 0);
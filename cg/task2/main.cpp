@@ -3,20 +3,39 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "Window.h"
 #include "Model.h"
-#include "IQMImporter.h"
+#include "AssetCache.h"
 #include "IModelDrawer.h"
 #include "ModelDrawer.h"
 #include "InFile.h"
 #include "Shader.h"
+#include "ImageEncoderPool.h"
+#include "ScreenshotCapture.h"
+#include "VideoSink.h"
+#include "SoftwareModelDrawer.h"
+#include "OffscreenContext.h"
+#include "JointTrack.h"
 #include "Camera.h"
 #include "Input.h"
 #include "PointLight.h"
 #include "Config.h"
 #include "Spline.h"
+#include "CompiledSpline.h"
 #include "SplineDrawer.h"
+#include "GLState.h"
+#include "FrameStats.h"
+#include "FrameBudget.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846f
@@ -35,13 +54,47 @@ void resizeCallback(int width, int height);
 void keyboardCallback(Key key, KeyAction action);
 void mousePositionCallback(float x, float y);
 void mouseButtonCallback(MouseButton button, MouseButtonAction action);
+void finishScreenshots();
+int renderHeadless();
+int renderOffscreen();
+int runBenchmark(const string& scene,
+    unsigned frame_count,
+    const string& json_file,
+    bool offscreen);
+void createWindow();
+Model* loadConfiguredModel();
+void writeProfile();
+void reportFrameAllocations();
+void updateFrameBudget();
+
+const int WINDOW_WIDTH = 800;
+const int WINDOW_HEIGHT = 600;
+const glm::vec3 CLEAR_COLOR(0.3f, 0.4f, 0.2f);
+const float BENCH_DT = 1.f / 60.f;
+const char* const SHADER_CACHE_DIRECTORY = "shader_cache";
+
+struct FrameUniforms
+{
+  Shader::Uniform proj_mat;
+  Shader::Uniform view_mat;
+  Shader::Uniform light_position;
+  Shader::Uniform light_diffuse;
+  Shader::Uniform light_enabled;
+};
 
 Config* config;
 Spline spline;
+CompiledSpline compiled_spline;
 SplineDrawer* spline_drawer;
+AssetCache asset_cache;
 Model* model;
 IModelDrawer* drawer;
 Shader* shader;
+FrameUniforms shader_uniforms;
+Shader* glyph_shader = 0;
+FrameUniforms glyph_shader_uniforms;
+Shader* mesh_shader = 0;
+FrameUniforms mesh_shader_uniforms;
 Camera* camera = new Camera();
 PointLight* light = new PointLight(glm::vec3(0), glm::vec4(1, 1, 1, 1));
 MouseButton mouse_button_pressed = MouseButton::UNKNOWN;
@@ -50,6 +103,14 @@ float animation_time = 0.f;
 float spline_time = 0.f;
 std::vector<float> screenshot_frames;
 bool generateScreenshots = false;
+ImageEncoderPool* encoder_pool = 0;
+ScreenshotCapture* screenshot_capture = 0;
+// Takes the screenshots instead of PNG files, see screenshot_video.
+VideoSink* video_sink = 0;
+// Trades animation quality for frame time, see --budget.
+FrameBudget* frame_budget = 0;
+std::chrono::steady_clock::time_point frame_work_start;
+string profile_file_name = "profile.json";
 
 int MODE_MESH = 1 << 0;
 int MODE_JOINTS = 1 << 1;
@@ -62,14 +123,44 @@ int main(int argc, char** argv)
 {
   if (argc < 2)
   {
-    cerr << "Usage: " << argv[0] << " config.xml [-screenshots]" << endl;
+    cerr << "Usage: " << argv[0]
+         << " config.xml [-screenshots|--headless|--offscreen]"
+            " [-bench N [--json file]] [--profile trace.json]"
+            " [--budget ms] [--no-shader-cache]" << endl;
     exit(1);
   }
-  if (argc == 3)
+  bool headless = false;
+  bool offscreen = false;
+  bool shader_cache = true;
+  unsigned bench_frames = 0;
+  string bench_json_file;
+  for (int i = 2; i < argc; i++)
   {
-    if (std::string(argv[2]).compare("-screenshots") == 0)
+    string arg(argv[i]);
+    if (arg.compare("-screenshots") == 0)
       generateScreenshots = true;
+    else if (arg.compare("--headless") == 0)
+      headless = true;
+    else if (arg.compare("--offscreen") == 0)
+      offscreen = true;
+    else if (arg.compare("-bench") == 0 && i + 1 < argc)
+      bench_frames = std::max(std::atoi(argv[++i]), 1);
+    else if (arg.compare("--json") == 0 && i + 1 < argc)
+      bench_json_file = argv[++i];
+    else if (arg.compare("--no-shader-cache") == 0)
+      shader_cache = false;
+    else if (arg.compare("--budget") == 0 && i + 1 < argc)
+      frame_budget = new FrameBudget(std::max(std::atof(argv[++i]), 1.0));
+    else if (arg.compare("--profile") == 0 && i + 1 < argc)
+    {
+      profile_file_name = argv[++i];
+      Profiler::setEnabled(true);
+    }
   }
+  if (shader_cache)
+    Shader::setCacheDirectory(SHADER_CACHE_DIRECTORY);
+  // Also covers the exit() at the end of the screenshot mode.
+  atexit(writeProfile);
   config = new Config();
   if (!config->load(argv[1]))
   {
@@ -80,17 +171,35 @@ int main(int argc, char** argv)
   if (config->hasSpline())
   {
     spline = config->getSpline();
+    compiled_spline = CompiledSpline(spline);
   }
   if (config->hasScreenshotFrames())
   {
     screenshot_frames = config->getScreenshotFrames();
   }
 
+  if (headless)
+    return renderHeadless();
+  if (bench_frames > 0)
+    return runBenchmark(argv[1], bench_frames, bench_json_file, offscreen);
+  if (offscreen)
+    return renderOffscreen();
+
+  createWindow();
+  model = loadConfiguredModel();
+  if (!model)
+    cerr << "Error loading model." << endl;
+
+  return Window::enterMainLoop();
+}
+
+void createWindow()
+{
   Window::setErrorCallback(errorCallback);
   Window::init();
   Window::setGLVersion(2, 1);
   Window::setBufferSizes(8, 8, 8, 8, 24, 0);
-  Window::create(800, 600, "CG2 Skeletal Animation");
+  Window::create(WINDOW_WIDTH, WINDOW_HEIGHT, "CG2 Skeletal Animation");
   Window::makeCurrent();
 
   Window::setDrawCallback(drawCallback);
@@ -101,15 +210,13 @@ int main(int argc, char** argv)
   Window::setMousePositionCallback(mousePositionCallback);
   Window::setMouseButtonCallback(mouseButtonCallback);
   Window::fireResizeEvent();
+}
 
-  IQMImporter importer;
-  model = importer.loadModel(config->getModelFileName(),
+Model* loadConfiguredModel()
+{
+  return asset_cache.loadModel(config->getModelFileName(),
       config->getAnimationFileNames(), config->getAnimationRepeatTime(),
       config->getAnimationRelativeFlags());
-  if (!model)
-    cerr << "Error loading model." << endl;
-
-  return Window::enterMainLoop();
 }
 
 void errorCallback(int error, const char* description)
@@ -117,47 +224,92 @@ void errorCallback(int error, const char* description)
   cerr << "GLFW Error: " << description << " (" << error << ")." << endl;
 }
 
+FrameUniforms resolveFrameUniforms(Shader* program)
+{
+  FrameUniforms uniforms;
+  uniforms.proj_mat = program->getUniform("proj_mat");
+  uniforms.view_mat = program->getUniform("view_mat");
+  uniforms.light_position = program->getUniform("light_position");
+  uniforms.light_diffuse = program->getUniform("light_diffuse");
+  uniforms.light_enabled = program->getUniform("light_enabled");
+  return uniforms;
+}
+
+void setFrameUniforms(Shader* program,
+    const FrameUniforms& uniforms,
+    bool light_enabled)
+{
+  program->setUniformMatrix4f(uniforms.proj_mat, camera->getProjMatrix());
+  program->setUniformMatrix4f(uniforms.view_mat, camera->getViewMatrix());
+  program->setUniform3f(uniforms.light_position, light->getPosition());
+  program->setUniform4f(uniforms.light_diffuse, light->getDiffuse());
+  program->setUniform1i(uniforms.light_enabled, light_enabled);
+}
+
+void updateFrameBudget()
+{
+  // The budget covers the frame's own work, update and draw up to the swap.
+  // The time between two draws would include the vsync wait in the swap and
+  // measure the refresh period instead. The quality applies from the next
+  // frame on.
+  double frame_ms = std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - frame_work_start).count();
+  frame_budget->addFrame(frame_ms);
+  drawer->setAnimationQuality(frame_budget->getQuality());
+}
+
 void drawCallback()
 {
+  GLState::beginFrame();
+  Profiler::beginFrame();
+  PROFILE_GPU_ZONE("drawCallback");
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   glEnable(GL_DEPTH_TEST);
+  GLState::countCall(2);
 
   if (config->hasSpline())
   {
     SplineInterpolationResult interplation_result =
-        spline.interpolate(spline_time);
+        compiled_spline.interpolate(spline_time);
     drawer->moveTo(interplation_result.getPosition());
     drawer->orientate(interplation_result.getOrientation());
   }
 
+  bool light_enabled = !(mode & MODE_WIREFRAME);
+  if (glyph_shader)
+  {
+    glyph_shader->bind();
+    setFrameUniforms(glyph_shader, glyph_shader_uniforms, light_enabled);
+  }
+  if (mesh_shader)
+  {
+    mesh_shader->bind();
+    setFrameUniforms(mesh_shader, mesh_shader_uniforms, light_enabled);
+  }
+
   shader->bind();
-  shader->setUniformMatrix4f("proj_mat", camera->getProjMatrix());
-  shader->setUniformMatrix4f("view_mat", camera->getViewMatrix());
-  shader->setUniform3f("light_position", light->getPosition());
-  shader->setUniform4f("light_diffuse", light->getDiffuse());
+  setFrameUniforms(shader, shader_uniforms, light_enabled);
 
   if (config->hasSpline() && mode & MODE_SPLINE)
   {
-    shader->setUniform1i("light_enabled", 0);
+    shader->setUniform1i(shader_uniforms.light_enabled, 0);
     spline_drawer->draw();
+    shader->setUniform1i(shader_uniforms.light_enabled, light_enabled);
   }
 
   if (mode & MODE_WIREFRAME)
-  {
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    shader->setUniform1i("light_enabled", 0);
-  }
   else
-  {
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    shader->setUniform1i("light_enabled", 1);
-  }
+  GLState::countCall();
 
-  if (mode & MODE_JOINTS)
+  bool draw_glyphs = drawer->getAnimationQuality().draw_glyphs;
+  if (mode & MODE_JOINTS && draw_glyphs)
     drawer->drawJoints();
 
-  if (mode & MODE_BONES)
+  if (mode & MODE_BONES && draw_glyphs)
     drawer->drawBones();
 
   if (mode & MODE_MESH)
@@ -165,33 +317,44 @@ void drawCallback()
 
   if (config->hasScreenshotFrames() && generateScreenshots)
   {
-    if (screenshot_frames.empty())
-    {
-      exit(0);
-    }
-
     static int screenshot_number = 0;
     screenshot_number++;
-    Image screenshot = drawer->makeScreenshot();
     std::stringstream ss;
     ss << config->getScreenshotsFolder() << "/" << screenshot_number << ".png";
-    screenshot.save(ss.str());
+    screenshot_capture->capture(ss.str());
 
     if (config->exportJointTransformations())
     {
-        ss.clear();
-        ss << config->getScreenshotsFolder() << "/" << config->getJointTransformationsFileName() << screenshot_number << ".png";
-        drawer->exportJointTransformations(ss.str());
+      drawer->exportJointTransformations(
+          config->getJointTransformationsFileName());
     }
   }
 
   shader->unbind();
+
+  if (frame_budget)
+    updateFrameBudget();
+
+#ifndef NDEBUG
+  reportFrameAllocations();
+#endif
 }
 
 void updateCallback(float t, float dt)
 {
+  PROFILE_ZONE("updateCallback");
+
+  if (frame_budget)
+    frame_work_start = std::chrono::steady_clock::now();
+
   if (config->hasScreenshotFrames() && generateScreenshots)
   {
+    if (screenshot_frames.empty())
+    {
+      finishScreenshots();
+      exit(0);
+    }
+
     t = screenshot_frames.front();
     screenshot_frames.erase(screenshot_frames.begin());
     animation_time = t;
@@ -210,7 +373,7 @@ void updateCallback(float t, float dt)
 
 void initCallback()
 {
-  glClearColor(0.3f, 0.4f, 0.2f, 1.f);
+  glClearColor(CLEAR_COLOR.r, CLEAR_COLOR.g, CLEAR_COLOR.b, 1.f);
   glClearDepth(1.f);
 
   string vsh_src = InFile("data/shaders/shader.vsh").toString();
@@ -221,16 +384,61 @@ void initCallback()
   shader->addShader(Shader::ShaderType::VERTEX_SHADER, vsh_src);
   shader->addShader(Shader::ShaderType::FRAGMENT_SHADER, fsh_src);
   shader->link();
+  shader_uniforms = resolveFrameUniforms(shader);
+
+  // Joint and bone glyphs are instanced when the glyph shader builds, the
+  // drawer falls back to CPU batches otherwise.
+  string glyph_vsh_src = InFile("data/shaders/glyph.vsh").toString();
+  glyph_shader = new Shader();
+  glyph_shader->create();
+  if (glyph_shader->addShader(
+          Shader::ShaderType::VERTEX_SHADER, glyph_vsh_src) &&
+      glyph_shader->addShader(
+          Shader::ShaderType::FRAGMENT_SHADER, fsh_src) &&
+      glyph_shader->link())
+  {
+    glyph_shader_uniforms = resolveFrameUniforms(glyph_shader);
+  }
+  else
+  {
+    cout << "Glyph shader unavailable." << endl;
+    delete glyph_shader;
+    glyph_shader = 0;
+  }
+
+  // The mesh streams packed vertices when the mesh shader builds, full
+  // floats through the default shader otherwise.
+  string mesh_vsh_src = InFile("data/shaders/mesh.vsh").toString();
+  mesh_shader = new Shader();
+  mesh_shader->create();
+  if (mesh_shader->addShader(
+          Shader::ShaderType::VERTEX_SHADER, mesh_vsh_src) &&
+      mesh_shader->addShader(
+          Shader::ShaderType::FRAGMENT_SHADER, fsh_src) &&
+      mesh_shader->link())
+  {
+    mesh_shader_uniforms = resolveFrameUniforms(mesh_shader);
+  }
+  else
+  {
+    cout << "Mesh shader unavailable." << endl;
+    delete mesh_shader;
+    mesh_shader = 0;
+  }
 
   camera->setPosition(config->getCameraPosition());
   camera->setOrientation(
       config->getCameraHorizontalAngle(), config->getCameraVerticalAngle());
 
   drawer = new ModelDrawer(model);
-  drawer->init();
   drawer->setConfig(config);
   drawer->setShader(shader);
+  drawer->setGlyphShader(glyph_shader);
+  drawer->setMeshShader(mesh_shader);
   drawer->setCamera(camera);
+  // Screenshots are taken at the configured times, not at a steady rate.
+  drawer->setPoseLodEnabled(!generateScreenshots);
+  drawer->init();
   drawer->setJointSize(config->getJointSize());
   drawer->setBoneSize(config->getBoneSize());
   if (!config->getAnimationFileNames().empty())
@@ -242,6 +450,19 @@ void initCallback()
     spline_drawer = new SplineDrawer(spline, *shader);
     spline_drawer->init();
   }
+
+  if (config->hasScreenshotFrames() && generateScreenshots)
+  {
+    encoder_pool = new ImageEncoderPool();
+    screenshot_capture = new ScreenshotCapture(*encoder_pool);
+    screenshot_capture->setEncoderProfile(config->getScreenshotCompression());
+    if (config->hasScreenshotVideo())
+    {
+      video_sink = new VideoSink(config->getScreenshotVideo(),
+          config->getScreenshotVideoFrameRate());
+      screenshot_capture->setVideoSink(video_sink);
+    }
+  }
 }
 
 void resizeCallback(int width, int height)
@@ -299,6 +520,23 @@ void keyboardCallback(Key key, KeyAction action)
     case Key::BACKSPACE:
       animation_time = 0.f;
       break;
+    case Key::P:
+      if (Profiler::isEnabled())
+      {
+        writeProfile();
+      }
+      else
+      {
+        cout << "Profiling, press P again to write " << profile_file_name
+             << "." << endl;
+        Profiler::setEnabled(true);
+      }
+      break;
+    case Key::G:
+      cout << "GL calls last frame: " << GLState::getCallCount() << " ("
+           << GLState::getSkippedCount() << " redundant calls skipped)."
+           << endl;
+      break;
     case Key::NINE:
       camera->setPosition(config->getCameraPosition());
       camera->resetOrientation();
@@ -350,3 +588,344 @@ void mouseButtonCallback(MouseButton button, MouseButtonAction action)
     break;
   }
 }
+
+void reportFrameAllocations()
+{
+  // The first frames still fill ring buffers and caches.
+  static const unsigned WARMUP_FRAMES = 3;
+  static unsigned frame = 0;
+  static size_t allocation_cnt_prev = 0;
+  static size_t allocated_bytes_prev = 0;
+  if (!AllocationCounter::isEnabled())
+    return;
+
+  size_t allocation_cnt = AllocationCounter::getAllocationCount();
+  size_t allocated_bytes = AllocationCounter::getAllocatedBytes();
+  if (frame++ >= WARMUP_FRAMES && allocation_cnt != allocation_cnt_prev)
+    cout << "Frame " << frame << ": "
+         << allocation_cnt - allocation_cnt_prev << " heap allocations ("
+         << allocated_bytes - allocated_bytes_prev << " bytes)." << endl;
+  // Leaves the report itself out of the next frame.
+  allocation_cnt_prev = AllocationCounter::getAllocationCount();
+  allocated_bytes_prev = AllocationCounter::getAllocatedBytes();
+}
+
+void writeProfile()
+{
+  if (Profiler::isEnabled() &&
+      !Profiler::writeChromeTrace(profile_file_name))
+    cerr << "Could not write " << profile_file_name << "." << endl;
+}
+
+void finishScreenshots()
+{
+  drawer->finishJointTransformationsExport();
+  screenshot_capture->flush();
+  cout << Image::getEncoderStatistics();
+  delete screenshot_capture;
+  delete encoder_pool;
+  delete video_sink;
+  screenshot_capture = 0;
+  encoder_pool = 0;
+  video_sink = 0;
+}
+
+int renderHeadless()
+{
+  if (!config->hasScreenshotFrames())
+  {
+    cerr << "Headless mode needs screenshot frames in the config." << endl;
+    return 1;
+  }
+
+  model = loadConfiguredModel();
+  if (!model)
+  {
+    cerr << "Error loading model." << endl;
+    return 1;
+  }
+
+  // Frames render in parallel, each worker with its own drawer and camera;
+  // cores left over go to the tiles of each frame. A video needs the frames
+  // in order, so one worker renders them all with every core.
+  unsigned hardware_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  unsigned worker_cnt = static_cast<unsigned>(
+      std::min<size_t>(hardware_threads, screenshot_frames.size()));
+  if (config->hasScreenshotVideo())
+  {
+    worker_cnt = 1;
+    video_sink = new VideoSink(config->getScreenshotVideo(),
+        config->getScreenshotVideoFrameRate());
+  }
+  unsigned tile_thread_cnt = std::max(hardware_threads / worker_cnt, 1u);
+  cout << "Rendering " << screenshot_frames.size() << " frames headless on "
+       << worker_cnt << " workers with " << tile_thread_cnt
+       << " tile threads each." << endl;
+
+  std::atomic<size_t> next_frame(0);
+  std::mutex track_mutex;
+  JointTrackWriter track_writer;
+  if (config->exportJointTransformations() && config->useTransformationsFile())
+    cerr << "Not exporting joint transformations over the replayed track."
+         << endl;
+  else if (config->exportJointTransformations() &&
+           !track_writer.open(config->getJointTransformationsFileName(),
+               model->getJointCount()))
+    cerr << "Could not export joint transformations: "
+         << track_writer.getError() << endl;
+
+  auto worker = [&]()
+  {
+    Camera worker_camera;
+    worker_camera.setPosition(config->getCameraPosition());
+    worker_camera.setOrientation(
+        config->getCameraHorizontalAngle(), config->getCameraVerticalAngle());
+    worker_camera.setProjection(config->getCameraFOV(),
+        static_cast<float>(WINDOW_WIDTH) / WINDOW_HEIGHT, 0.1f, 1000.f);
+    worker_camera.update(0.f);
+
+    SoftwareModelDrawer worker_drawer(model, WINDOW_WIDTH, WINDOW_HEIGHT);
+    worker_drawer.setConfig(config);
+    worker_drawer.setCamera(&worker_camera);
+    // Workers take the frames out of order.
+    worker_drawer.setPoseLodEnabled(false);
+    worker_drawer.setThreadCount(tile_thread_cnt);
+    worker_drawer.setLight(light->getPosition(), light->getDiffuse());
+    worker_drawer.setLightEnabled(!(mode & MODE_WIREFRAME));
+    worker_drawer.init();
+    worker_drawer.setJointSize(config->getJointSize());
+    worker_drawer.setBoneSize(config->getBoneSize());
+    if (!config->getAnimationFileNames().empty())
+      worker_drawer.startAction(0);
+
+    for (size_t frame = next_frame++; frame < screenshot_frames.size();
+         frame = next_frame++)
+    {
+      float t = screenshot_frames[frame];
+      if (config->hasSpline())
+      {
+        SplineInterpolationResult interpolation_result =
+            compiled_spline.interpolate(t);
+        worker_drawer.moveTo(interpolation_result.getPosition());
+        worker_drawer.orientate(interpolation_result.getOrientation());
+      }
+      worker_drawer.update(t);
+
+      worker_drawer.clear(CLEAR_COLOR);
+      if (mode & MODE_JOINTS)
+        worker_drawer.drawJoints();
+      if (mode & MODE_BONES)
+        worker_drawer.drawBones();
+      if (mode & MODE_MESH)
+        worker_drawer.draw();
+
+      Image screenshot = worker_drawer.makeScreenshot();
+      if (video_sink)
+      {
+        if (!video_sink->writeFrame(screenshot.getDataPointer(),
+                screenshot.getWidth(), screenshot.getHeight(), false))
+          cerr << "Could not write video frame: " << video_sink->getError()
+               << "." << endl;
+      }
+      else
+      {
+        screenshot.setEncoderProfile(config->getScreenshotCompression());
+        screenshot.setEncoderThreadCount(1);
+        std::stringstream ss;
+        ss << config->getScreenshotsFolder() << "/" << frame + 1 << ".png";
+        if (!screenshot.save(ss.str()))
+          cerr << "Could not save " << ss.str() << ": "
+               << screenshot.getError() << endl;
+      }
+
+      // The track index is sorted by time, so frames may land in any order.
+      if (track_writer.isOpen())
+      {
+        std::lock_guard<std::mutex> lock(track_mutex);
+        if (!track_writer.append(t, worker_drawer.getJointTransformations()))
+          cerr << "Could not export joint transformations: "
+               << track_writer.getError() << endl;
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 1; i < worker_cnt; i++)
+    workers.push_back(std::thread(worker));
+  worker();
+  for (std::thread& thread : workers)
+    thread.join();
+  if (track_writer.isOpen() && !track_writer.close())
+    cerr << "Could not export joint transformations: "
+         << track_writer.getError() << endl;
+
+  delete video_sink;
+  video_sink = 0;
+  cout << Image::getEncoderStatistics();
+  return 0;
+}
+
+int renderOffscreen()
+{
+  if (!config->hasScreenshotFrames())
+  {
+    cerr << "Offscreen mode needs screenshot frames in the config." << endl;
+    return 1;
+  }
+
+  OffscreenContext context;
+  if (!context.create(WINDOW_WIDTH, WINDOW_HEIGHT))
+  {
+    cerr << "Could not create the offscreen context: " << context.getError()
+         << "." << endl;
+    return 1;
+  }
+
+  model = loadConfiguredModel();
+  if (!model)
+  {
+    cerr << "Error loading model." << endl;
+    return 1;
+  }
+
+  // The same callbacks as the window, driven back to back: no swap, no vsync
+  // and no event polling between the frames.
+  generateScreenshots = true;
+  initCallback();
+  resizeCallback(context.getWidth(), context.getHeight());
+
+  size_t frame_cnt = screenshot_frames.size();
+  cout << "Rendering " << frame_cnt << " frames offscreen." << endl;
+  auto start = std::chrono::steady_clock::now();
+  while (!screenshot_frames.empty())
+  {
+    updateCallback(0.f, 0.f);
+    drawCallback();
+  }
+  glFinish();
+  auto rendered = std::chrono::steady_clock::now();
+  finishScreenshots();
+  auto finished = std::chrono::steady_clock::now();
+
+  double render_secs =
+      std::chrono::duration<double>(rendered - start).count();
+  double total_secs =
+      std::chrono::duration<double>(finished - start).count();
+  cout << "Rendered " << frame_cnt << " frames in " << render_secs << " s ("
+       << frame_cnt / render_secs << " fps), " << total_secs
+       << " s including encoding (" << frame_cnt / total_secs << " fps)."
+       << endl;
+  return 0;
+}
+
+int runBenchmark(const string& scene,
+    unsigned frame_count,
+    const string& json_file,
+    bool offscreen)
+{
+  // Screenshots would time the encoder rather than the frame.
+  generateScreenshots = false;
+
+  OffscreenContext context;
+  if (offscreen)
+  {
+    if (!context.create(WINDOW_WIDTH, WINDOW_HEIGHT))
+    {
+      cerr << "Could not create the offscreen context: "
+           << context.getError() << "." << endl;
+      return 1;
+    }
+  }
+  else
+  {
+    createWindow();
+  }
+
+  model = loadConfiguredModel();
+  if (!model)
+  {
+    cerr << "Error loading model." << endl;
+    return 1;
+  }
+
+  initCallback();
+  if (offscreen)
+    resizeCallback(context.getWidth(), context.getHeight());
+  else
+    Window::setSwapInterval(0);
+
+  enum Stage
+  {
+    STAGE_UPDATE,
+    STAGE_DRAW,
+    STAGE_FINISH,
+    STAGE_FRAME
+  };
+  FrameStats stats({"update", "draw", "finish", "frame"});
+  stats.reserve(frame_count);
+
+  // A fixed dt makes every run animate through the same poses, whatever the
+  // frame rate.
+  cout << "Benchmarking " << frame_count << " frames of " << scene
+       << " with dt " << BENCH_DT << " s." << endl;
+  typedef std::chrono::steady_clock Clock;
+  auto milliseconds = [](Clock::time_point from, Clock::time_point to)
+  {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+  };
+  unsigned run_count = 0;
+  for (unsigned frame = 0; frame < frame_count; frame++)
+  {
+    Clock::time_point start = Clock::now();
+    updateCallback(frame * BENCH_DT, BENCH_DT);
+    Clock::time_point updated = Clock::now();
+    drawCallback();
+    Clock::time_point drawn = Clock::now();
+    glFinish();
+    Clock::time_point finished = Clock::now();
+    if (!offscreen)
+    {
+      Window::swapBuffers();
+      Window::pollEvents();
+    }
+    Clock::time_point end = Clock::now();
+
+    stats.record(STAGE_UPDATE, milliseconds(start, updated));
+    stats.record(STAGE_DRAW, milliseconds(updated, drawn));
+    stats.record(STAGE_FINISH, milliseconds(drawn, finished));
+    stats.record(STAGE_FRAME, milliseconds(start, end));
+    run_count++;
+
+    // Closing the window ends the run with the frames measured so far.
+    if (!offscreen && Window::shouldClose())
+    {
+      cout << "Window closed after " << run_count << " of " << frame_count
+           << " frames." << endl;
+      break;
+    }
+  }
+
+  cout << stats.toString();
+
+  std::stringstream json;
+  json << "{\"scene\": \"" << scene << "\", \"context\": \""
+       << (offscreen ? "offscreen" : "window") << "\", \"frames\": "
+       << run_count << ", \"dt\": " << BENCH_DT
+       << ", \"stages\": " << stats.toJson() << "}";
+  if (json_file.empty())
+  {
+    cout << json.str() << endl;
+  }
+  else
+  {
+    std::ofstream out(json_file.c_str());
+    out << json.str() << endl;
+    if (!out)
+    {
+      cerr << "Could not write " << json_file << "." << endl;
+      return 1;
+    }
+    cout << "Wrote " << json_file << "." << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,393 @@
+// ============================================================================
+//
+//       Filename:  regress.cpp
+//
+//    Description:  Runs scene configs headless in one process and checks
+//                  their joint transformations against the reference dumps.
+//
+// ============================================================================
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Model.h"
+#include "AssetCache.h"
+#include "Camera.h"
+#include "Config.h"
+#include "CompiledSpline.h"
+#include "FrameStats.h"
+#include "JointTrack.h"
+#include "SoftwareModelDrawer.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+const int WIDTH = 800;
+const int HEIGHT = 600;
+const glm::vec3 CLEAR_COLOR(0.3f, 0.4f, 0.2f);
+const int MODE_MESH = 1 << 0;
+const int MODE_JOINTS = 1 << 1;
+const int MODE_BONES = 1 << 2;
+const int MODE_WIREFRAME = 1 << 3;
+
+struct Options
+{
+  std::vector<string> scenes;
+  string json_file;
+  float tolerance;
+  // Tile threads of the software rasterizer, 0 for all hardware threads.
+  unsigned threads;
+  // Writes the references instead of comparing against them.
+  bool record;
+};
+
+enum Status
+{
+  STATUS_PASS,
+  STATUS_FAIL,
+  STATUS_NO_REFERENCE,
+  STATUS_BAD_REFERENCE,
+  STATUS_RECORDED,
+  STATUS_ERROR
+};
+
+const char* STATUS_NAMES[] = {
+    "pass", "FAIL", "no reference", "bad reference", "recorded", "error"};
+
+enum Stage
+{
+  STAGE_LOAD,
+  STAGE_INIT,
+  STAGE_UPDATE,
+  STAGE_DRAW,
+  STAGE_FRAME
+};
+
+struct Result
+{
+  string scene;
+  Status status;
+  size_t frame_count;
+  size_t compared_count;
+  // Largest absolute difference of a matrix element to the reference.
+  float max_error;
+  FrameStats stats;
+
+  Result()
+      : status(STATUS_ERROR)
+      , frame_count(0)
+      , compared_count(0)
+      , max_error(0.f)
+      , stats({"load", "init", "update", "draw", "frame"})
+  {
+  }
+};
+
+double milliseconds(Clock::time_point from, Clock::time_point to)
+{
+  return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+string sceneName(const string& file_name)
+{
+  size_t begin = file_name.find_last_of("/\\");
+  begin = begin == string::npos ? 0 : begin + 1;
+  size_t end = file_name.find_last_of('.');
+  if (end == string::npos || end < begin)
+    end = file_name.size();
+  return file_name.substr(begin, end - begin);
+}
+
+float poseError(const std::vector<glm::mat4>& pose,
+    const glm::mat4* reference,
+    size_t joint_count)
+{
+  float error = 0.f;
+  for (size_t j = 0; j < joint_count; j++)
+    for (int c = 0; c < 4; c++)
+      for (int r = 0; r < 4; r++)
+        error = std::max(error, std::abs(pose[j][c][r] - reference[j][c][r]));
+  return error;
+}
+
+// Plays the screenshot frames of one config the way --headless does and
+// compares every frame with the config's joint_transformations_file, a
+// track recorded by --record (or the screenshot mode's export) that stamps
+// each pose with its time.
+void runScene(const Options& options,
+    const string& file_name,
+    AssetCache& asset_cache,
+    Result& result)
+{
+  result.scene = sceneName(file_name);
+
+  Clock::time_point load_start = Clock::now();
+  Config config;
+  if (!config.load(file_name))
+  {
+    cerr << "Loading of config file " << file_name << " failed." << endl;
+    return;
+  }
+  Model* model = asset_cache.loadModel(config.getModelFileName(),
+      config.getAnimationFileNames(), config.getAnimationRepeatTime(),
+      config.getAnimationRelativeFlags());
+  if (!model)
+  {
+    cerr << "Error loading model of " << file_name << "." << endl;
+    return;
+  }
+  CompiledSpline spline;
+  if (config.hasSpline())
+    spline = CompiledSpline(config.getSpline());
+  Clock::time_point loaded = Clock::now();
+  result.stats.record(STAGE_LOAD, milliseconds(load_start, loaded));
+
+  // Replaying the reference would only compare it with itself.
+  const string& reference_file = config.getJointTransformationsFileName();
+  JointTrack reference;
+  bool has_reference = !options.record && !config.useTransformationsFile() &&
+                       reference.open(reference_file);
+  string reference_error;
+  if (has_reference && reference.isLegacy())
+    reference_error = "is a single pose without a time";
+  else if (has_reference &&
+           reference.getJointCount() != model->getJointCount())
+    reference_error = "has a different joint count than the model";
+  if (!reference_error.empty())
+  {
+    cerr << "Reference " << reference_file << " " << reference_error
+         << ", record it again with --record." << endl;
+    result.status = STATUS_BAD_REFERENCE;
+    delete model;
+    return;
+  }
+  bool record = options.record && !config.useTransformationsFile();
+  JointTrackWriter recorder;
+  if (record && !recorder.open(reference_file, model->getJointCount()))
+  {
+    cerr << "Could not record " << reference_file << ": "
+         << recorder.getError() << endl;
+    delete model;
+    return;
+  }
+
+  {
+    Camera camera;
+    camera.setPosition(config.getCameraPosition());
+    camera.setOrientation(
+        config.getCameraHorizontalAngle(), config.getCameraVerticalAngle());
+    camera.setProjection(config.getCameraFOV(),
+        static_cast<float>(WIDTH) / HEIGHT, 0.1f, 1000.f);
+    camera.update(0.f);
+
+    int mode = config.getRenderMode();
+    SoftwareModelDrawer drawer(model, WIDTH, HEIGHT);
+    drawer.setConfig(&config);
+    drawer.setCamera(&camera);
+    drawer.setPoseLodEnabled(false);
+    drawer.setThreadCount(options.threads);
+    drawer.setLightEnabled(!(mode & MODE_WIREFRAME));
+    drawer.init();
+    drawer.setJointSize(config.getJointSize());
+    drawer.setBoneSize(config.getBoneSize());
+    if (!config.getAnimationFileNames().empty())
+      drawer.startAction(0);
+    result.stats.record(STAGE_INIT, milliseconds(loaded, Clock::now()));
+
+    const std::vector<float>& frames = config.getScreenshotFrames();
+    result.frame_count = frames.size();
+    for (size_t frame = 0; frame < frames.size(); frame++)
+    {
+      float t = frames[frame];
+      Clock::time_point start = Clock::now();
+      if (config.hasSpline())
+      {
+        SplineInterpolationResult interpolation_result = spline.interpolate(t);
+        drawer.moveTo(interpolation_result.getPosition());
+        drawer.orientate(interpolation_result.getOrientation());
+      }
+      drawer.update(t);
+      Clock::time_point updated = Clock::now();
+
+      drawer.clear(CLEAR_COLOR);
+      if (mode & MODE_JOINTS)
+        drawer.drawJoints();
+      if (mode & MODE_BONES)
+        drawer.drawBones();
+      if (mode & MODE_MESH)
+        drawer.draw();
+      Clock::time_point drawn = Clock::now();
+
+      result.stats.record(STAGE_UPDATE, milliseconds(start, updated));
+      result.stats.record(STAGE_DRAW, milliseconds(updated, drawn));
+      result.stats.record(STAGE_FRAME, milliseconds(start, drawn));
+
+      if (record)
+      {
+        if (!recorder.append(t, drawer.getJointTransformations()))
+          cerr << "Could not record " << reference_file << ": "
+               << recorder.getError() << endl;
+      }
+      else if (has_reference)
+      {
+        result.max_error = std::max(result.max_error,
+            poseError(drawer.getJointTransformations(), reference.sample(t),
+                reference.getJointCount()));
+        result.compared_count++;
+      }
+    }
+  }
+  delete model;
+
+  if (record)
+  {
+    bool closed = recorder.close();
+    if (!closed)
+      cerr << "Could not record " << reference_file << ": "
+           << recorder.getError() << endl;
+    // A failed append leaves its error behind as well.
+    result.status = closed && recorder.getError().empty() ? STATUS_RECORDED
+                                                          : STATUS_ERROR;
+  }
+  else if (!has_reference)
+    result.status = STATUS_NO_REFERENCE;
+  else if (result.max_error <= options.tolerance)
+    result.status = STATUS_PASS;
+  else
+    result.status = STATUS_FAIL;
+}
+
+void printResults(const Options& options, const std::vector<Result>& results)
+{
+  cout << endl << "Regression (tolerance " << options.tolerance << "):"
+       << endl;
+  cout << std::left << std::setw(24) << "scene" << std::setw(14) << "status"
+       << std::right << std::setw(8) << "frames" << std::setw(12)
+       << "max error" << std::setw(12) << "load ms" << std::setw(12)
+       << "update ms" << std::setw(12) << "draw ms" << endl;
+  for (const Result& result : results)
+  {
+    cout << std::left << std::setw(24) << result.scene << std::setw(14)
+         << STATUS_NAMES[result.status] << std::right << std::setw(8)
+         << result.frame_count << std::setw(12) << std::setprecision(3)
+         << result.max_error << std::fixed << std::setprecision(3);
+    for (size_t stage : {STAGE_LOAD, STAGE_UPDATE, STAGE_DRAW})
+    {
+      if (result.stats.getSampleCount(stage) > 0)
+        cout << std::setw(12) << result.stats.summarize(stage).mean;
+      else
+        cout << std::setw(12) << "-";
+    }
+    cout << endl;
+    cout.unsetf(std::ios::fixed);
+  }
+}
+
+// One scene per line, in the order given, so two baselines diff line by
+// line.
+bool writeJson(const Options& options,
+    const std::vector<Result>& results,
+    const AssetCache& asset_cache)
+{
+  std::ofstream out(options.json_file.c_str());
+  if (!out)
+    return false;
+
+  out << "{\n  \"tolerance\": " << options.tolerance
+      << ",\n  \"asset_cache\": {\"hits\": " << asset_cache.getHitCount()
+      << ", \"misses\": " << asset_cache.getMissCount()
+      << "},\n  \"scenes\": [";
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    const Result& result = results[i];
+    out << (i ? ",\n" : "\n") << "    {\"scene\": \"" << result.scene
+        << "\", \"status\": \"" << STATUS_NAMES[result.status]
+        << "\", \"frames\": " << result.frame_count
+        << ", \"compared\": " << result.compared_count
+        << ", \"max_error\": " << result.max_error
+        << ", \"stages\": " << result.stats.toJson() << "}";
+  }
+  out << "\n  ]\n}\n";
+  return static_cast<bool>(out);
+}
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  options.tolerance = 1e-4f;
+  options.threads = 0;
+  options.record = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    string arg = argv[i];
+    if (arg == "--json" && i + 1 < argc)
+      options.json_file = argv[++i];
+    else if (arg == "--tolerance" && i + 1 < argc)
+      options.tolerance = static_cast<float>(std::atof(argv[++i]));
+    else if (arg == "--threads" && i + 1 < argc)
+      options.threads = std::max(std::atoi(argv[++i]), 0);
+    else if (arg == "--record")
+      options.record = true;
+    else if (arg[0] != '-')
+      options.scenes.push_back(arg);
+    else
+    {
+      options.scenes.clear();
+      break;
+    }
+  }
+  if (options.scenes.empty())
+  {
+    cerr << "Usage: " << argv[0]
+         << " config.xml... [--tolerance max_error] [--threads N]"
+            " [--json file] [--record]" << endl;
+    return 1;
+  }
+
+  // Models and clips shared by several configs are imported once.
+  AssetCache asset_cache;
+  std::vector<Result> results(options.scenes.size());
+  for (size_t i = 0; i < options.scenes.size(); i++)
+  {
+    cout << "Running " << options.scenes[i] << "." << endl;
+    runScene(options, options.scenes[i], asset_cache, results[i]);
+  }
+
+  printResults(options, results);
+  cout << "Asset cache: " << asset_cache.getHitCount() << " hits, "
+       << asset_cache.getMissCount() << " misses." << endl;
+
+  if (!options.json_file.empty())
+  {
+    if (!writeJson(options, results, asset_cache))
+    {
+      cerr << "Could not write " << options.json_file << "." << endl;
+      return 1;
+    }
+    cout << "Wrote " << options.json_file << "." << endl;
+  }
+
+  size_t failed = 0;
+  for (const Result& result : results)
+    if (result.status == STATUS_FAIL || result.status == STATUS_BAD_REFERENCE ||
+        result.status == STATUS_ERROR)
+      failed++;
+  cout << failed << " of " << results.size() << " scenes failed." << endl;
+  return failed == 0 ? 0 : 1;
+}
@@ -63,30 +63,30 @@ void interpolateJoints(float time,
   glm::mat4 relative_trans;
   glm::mat4 relative_rotat;
 
-  // interpolate between those
-  Keyframe kf1;
-  Keyframe kf2;
+  // interpolate between those, by reference: a Keyframe copy allocates
+  const Keyframe* kf1 = &keyframes.front();
+  const Keyframe* kf2 = &keyframes.back();
 
   for (int i = 0; i < keyframes.size() - 1; i++)
   {
     if(keyframes[i].getTime() <= time && time <= keyframes[i + 1].getTime())
     {
-      kf1 = keyframes[i];
-      kf2 = keyframes[i + 1];
+      kf1 = &keyframes[i];
+      kf2 = &keyframes[i + 1];
     }
   }
 
-  float ratio_time = ((time - kf1.getTime()) / (kf2.getTime() - kf1.getTime()));
+  float ratio_time = ((time - kf1->getTime()) / (kf2->getTime() - kf1->getTime()));
 
   // iterate over sorted tree structure, define pose position
   for (int i = 0; i < joints.size(); i++)
   {
-    vec3 t1 = kf1.getTranslation(i);
-    // vec3 t2 = kf2.getTranslation(joints[i].getID());
-    vec3 t2 = kf2.getTranslation(i);
+    vec3 t1 = kf1->getTranslation(i);
+    // vec3 t2 = kf2->getTranslation(joints[i].getID());
+    vec3 t2 = kf2->getTranslation(i);
 
-    quat kf1_r1 = kf1.getRotation(i);
-    quat kf2_r2 = kf2.getRotation(i);
+    quat kf1_r1 = kf1->getRotation(i);
+    quat kf2_r2 = kf2->getRotation(i);
 
     vec3 translation_interpolation = t1 * (1 - ratio_time) + t2 * ratio_time;
     mat4 rotation_interpolation = mat4_cast(slerp(kf1_r1, kf2_r2, ratio_time));
@@ -131,8 +131,8 @@ void calculateVertices(const std::vector<glm::vec3>& bindpose_vertices,
 
   for (int vj_iter = 0; vj_iter < vertex_joints.size(); vj_iter++)
   {
-    std::vector<size_t> v_joints = vertex_joints[vj_iter];
-    std::vector<float> v_weight = vertex_weights[vj_iter];
+    const std::vector<size_t>& v_joints = vertex_joints[vj_iter];
+    const std::vector<float>& v_weight = vertex_weights[vj_iter];
 
     vec4 homogen_transformation(bindpose_vertices[vj_iter], 1); //(x,y,z,1)
 
@@ -169,6 +169,77 @@ void calculateNormals(const std::vector<glm::vec3>& vertices,
   }
 }
 
+void calculateInterleavedNormals(const std::vector<glm::vec3>& vertices,
+    const std::vector<glm::ivec3>& triangles,
+    const std::vector<size_t>& vertex_triangle_offsets,
+    const std::vector<size_t>& vertex_triangles,
+    std::vector<glm::vec3>& face_normals,
+    glm::vec3* interleaved_vertices,
+    bool update_face_normals)
+{
+  // Same smooth normals as calculateNormals, but gathered per vertex so that
+  // every position/normal pair is written exactly once and in order. This
+  // lets the output go straight into a (write-only) mapped vertex buffer.
+  // Without update_face_normals the face normals of an earlier call are
+  // gathered again.
+  for (size_t triangle_iter = 0;
+       update_face_normals && triangle_iter < triangles.size(); triangle_iter++)
+  {
+    const ivec3& triangle = triangles[triangle_iter];
+    const vec3& v1 = vertices[triangle[0]];
+    const vec3& v2 = vertices[triangle[1]];
+    const vec3& v3 = vertices[triangle[2]];
+    face_normals[triangle_iter] = normalize(cross(v2 - v1, v2 - v3));
+  }
+
+  for (size_t vertex_iter = 0; vertex_iter < vertices.size(); vertex_iter++)
+  {
+    vec3 normal(0);
+    for (size_t adj_iter = vertex_triangle_offsets[vertex_iter];
+         adj_iter < vertex_triangle_offsets[vertex_iter + 1]; adj_iter++)
+      normal += face_normals[vertex_triangles[adj_iter]];
+
+    interleaved_vertices[2 * vertex_iter] = vertices[vertex_iter];
+    interleaved_vertices[2 * vertex_iter + 1] = normal;
+  }
+}
+
+void calculatePackedNormals(const std::vector<glm::vec3>& vertices,
+    const std::vector<glm::ivec3>& triangles,
+    const std::vector<size_t>& vertex_triangle_offsets,
+    const std::vector<size_t>& vertex_triangles,
+    std::vector<glm::vec3>& face_normals,
+    const glm::vec3& bounds_center,
+    const glm::vec3& bounds_extent,
+    PackedVertex* packed_vertices,
+    bool update_face_normals)
+{
+  // Same gather as calculateInterleavedNormals, but the position/normal
+  // pair is quantized on the way into the mapped buffer. The octahedral
+  // encoding only keeps the direction, so the sum needs no normalization.
+  for (size_t triangle_iter = 0;
+       update_face_normals && triangle_iter < triangles.size(); triangle_iter++)
+  {
+    const ivec3& triangle = triangles[triangle_iter];
+    const vec3& v1 = vertices[triangle[0]];
+    const vec3& v2 = vertices[triangle[1]];
+    const vec3& v3 = vertices[triangle[2]];
+    face_normals[triangle_iter] = normalize(cross(v2 - v1, v2 - v3));
+  }
+
+  const vec3 inv_extent = 1.f / bounds_extent;
+  for (size_t vertex_iter = 0; vertex_iter < vertices.size(); vertex_iter++)
+  {
+    vec3 normal(0);
+    for (size_t adj_iter = vertex_triangle_offsets[vertex_iter];
+         adj_iter < vertex_triangle_offsets[vertex_iter + 1]; adj_iter++)
+      normal += face_normals[vertex_triangles[adj_iter]];
+
+    packed_vertices[vertex_iter] = VertexPacking::pack(
+        vertices[vertex_iter], normal, bounds_center, inv_extent);
+  }
+}
+
 void interpolateJointsForAnimationModulation(float time_1,
   float time_2,
   const std::vector<Joint>& joints,
@@ -191,54 +262,54 @@ void interpolateJointsForAnimationModulation(float time_1,
   glm::mat4 relative_trans;
   glm::mat4 relative_rotat;
 
-  // interpolate between those
-  Keyframe kf1;
-  Keyframe kf2;
+  // interpolate between those, by reference: a Keyframe copy allocates
+  const Keyframe* kf1 = &keyframes_1.front();
+  const Keyframe* kf2 = &keyframes_1.back();
 
   for (int i = 0; i < keyframes_1.size() - 1; i++)
   {
     if(keyframes_1[i].getTime() <= time_1 && time_1 <= keyframes_1[i + 1].getTime())
     {
-      kf1 = keyframes_1[i];
-      kf2 = keyframes_1[i + 1];
+      kf1 = &keyframes_1[i];
+      kf2 = &keyframes_1[i + 1];
     }
   }
 
-  float ratio_time = ((time_1 - kf1.getTime()) / (kf2.getTime() - kf1.getTime()));
+  float ratio_time = ((time_1 - kf1->getTime()) / (kf2->getTime() - kf1->getTime()));
 
   // 2 scenario
 
-  Keyframe kf1_2;
-  Keyframe kf2_2;
+  const Keyframe* kf1_2 = &keyframes_2.front();
+  const Keyframe* kf2_2 = &keyframes_2.back();
 
   for (int i = 0; i < keyframes_2.size() - 1; i++)
   {
     if(keyframes_2[i].getTime() <= time_2 && time_2 <= keyframes_2[i + 1].getTime())
     {
-      kf1_2 = keyframes_2[i];
-      kf2_2 = keyframes_2[i + 1];
+      kf1_2 = &keyframes_2[i];
+      kf2_2 = &keyframes_2[i + 1];
     }
   }
 
-  float ratio_time_2 = ((time_2 - kf1_2.getTime()) / (kf2_2.getTime() - kf1_2.getTime()));
+  float ratio_time_2 = ((time_2 - kf1_2->getTime()) / (kf2_2->getTime() - kf1_2->getTime()));
 
   // iterate over sorted tree structure, define pose position
   for (int i = 0; i < joints.size(); i++)
   {
     // scenario 1
-    vec3 t1 = kf1.getTranslation(i);
-    vec3 t2 = kf2.getTranslation(i);
+    vec3 t1 = kf1->getTranslation(i);
+    vec3 t2 = kf2->getTranslation(i);
 
-    quat kf1_r1 = kf1.getRotation(i);
-    quat kf2_r2 = kf2.getRotation(i);
+    quat kf1_r1 = kf1->getRotation(i);
+    quat kf2_r2 = kf2->getRotation(i);
 
 
     // scenario 2
-    vec3 t1_2 = kf1_2.getTranslation(i);
-    vec3 t2_2 = kf2_2.getTranslation(i);
+    vec3 t1_2 = kf1_2->getTranslation(i);
+    vec3 t2_2 = kf2_2->getTranslation(i);
 
-    quat kf1_r1_2 = kf1_2.getRotation(i);
-    quat kf2_r2_2 = kf2_2.getRotation(i);
+    quat kf1_r1_2 = kf1_2->getRotation(i);
+    quat kf2_r2_2 = kf2_2->getRotation(i);
 
     vec3 translation_interpolation = t1_2 * (1 - ratio_time_2) + t2_2 * ratio_time_2 + t1 * (1 - ratio_time) + t2 * ratio_time;
     mat4 rotation_interpolation = mat4_cast(slerp(kf1_r1, kf2_r2, ratio_time));
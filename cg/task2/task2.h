@@ -17,6 +17,7 @@
 #include "Joint.h"
 #include "Keyframe.h"
 #include "Spline.h"
+#include "VertexPacking.h"
 
 
 
@@ -36,6 +37,24 @@ void calculateNormals(const std::vector<glm::vec3>& vertices,
     const std::vector<glm::ivec3>& triangles,
     std::vector<glm::vec3>& out_normals);
 
+void calculateInterleavedNormals(const std::vector<glm::vec3>& vertices,
+    const std::vector<glm::ivec3>& triangles,
+    const std::vector<size_t>& vertex_triangle_offsets,
+    const std::vector<size_t>& vertex_triangles,
+    std::vector<glm::vec3>& face_normals,
+    glm::vec3* interleaved_vertices,
+    bool update_face_normals = true);
+
+void calculatePackedNormals(const std::vector<glm::vec3>& vertices,
+    const std::vector<glm::ivec3>& triangles,
+    const std::vector<size_t>& vertex_triangle_offsets,
+    const std::vector<size_t>& vertex_triangles,
+    std::vector<glm::vec3>& face_normals,
+    const glm::vec3& bounds_center,
+    const glm::vec3& bounds_extent,
+    PackedVertex* packed_vertices,
+    bool update_face_normals = true);
+
 void interpolateJointsForAnimationModulation(float time_1,
   float time_2,
   const std::vector<Joint>& joints,